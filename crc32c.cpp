@@ -0,0 +1,222 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#define CRC32C_ARM 1
+#endif
+
+namespace {
+// Reflected Castagnoli polynomial
+const uint32_t Polynomial = 0x82f63b78u;
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+const Tables& tables() {
+  static const Tables instance = [] {
+    Tables result;
+
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 1) ? (crc >> 1) ^ Polynomial : crc >> 1;
+      }
+      result[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (size_t slice = 1; slice < result.size(); ++slice) {
+        uint32_t previous = result[slice - 1][i];
+        result[slice][i] = (previous >> 8) ^ result[0][previous & 0xff];
+      }
+    }
+
+    return result;
+  }();
+
+  return instance;
+}
+
+// Raw functions work on CRC register, without initial and final inversion
+
+uint32_t rawTable(uint32_t crc, const unsigned char* data, size_t size) {
+  const Tables& t = tables();
+
+  while (size >= 8) {
+    uint32_t low;
+    uint32_t high;
+    std::memcpy(&low, data, sizeof(low));
+    std::memcpy(&high, data + 4, sizeof(high));
+    low ^= crc;
+
+    crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^
+          t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^ t[3][high & 0xff] ^
+          t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^
+          t[0][high >> 24];
+
+    data += 8;
+    size -= 8;
+  }
+
+  while (size--) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+  }
+
+  return crc;
+}
+
+#if defined(CRC32C_X86)
+__attribute__((target("sse4.2"))) uint32_t rawHardware(
+    uint32_t crc, const unsigned char* data, size_t size) {
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+
+  while (size--) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+
+  return crc;
+}
+
+bool hardwareSupported() { return __builtin_cpu_supports("sse4.2"); }
+
+const char* hardwareName = "sse4.2";
+#elif defined(CRC32C_ARM)
+__attribute__((target("+crc"))) uint32_t rawHardware(
+    uint32_t crc, const unsigned char* data, size_t size) {
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    size -= 8;
+  }
+
+  while (size--) {
+    crc = __crc32cb(crc, *data++);
+  }
+
+  return crc;
+}
+
+bool hardwareSupported() { return (::getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+
+const char* hardwareName = "armv8";
+#endif
+
+using RawFunction = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+RawFunction rawFunction() {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+  static const RawFunction function =
+      hardwareSupported() ? rawHardware : rawTable;
+  return function;
+#else
+  return rawTable;
+#endif
+}
+
+/**
+ * a * b modulo polynomial, both are reflected polynomials
+ */
+uint32_t multiplyModulo(uint32_t a, uint32_t b) {
+  uint32_t mask = 1u << 31;
+  uint32_t product = 0;
+
+  while (true) {
+    if (a & mask) {
+      product ^= b;
+      if ((a & (mask - 1)) == 0) {
+        break;
+      }
+    }
+    mask >>= 1;
+    b = (b & 1) ? (b >> 1) ^ Polynomial : b >> 1;
+  }
+
+  return product;
+}
+
+/**
+ * x^(8 * bytes) modulo polynomial, shifts CRC register over zero bytes
+ */
+uint32_t zeroBytesOperator(size_t bytes) {
+  // x^(2^k) for k = 0..63
+  static const std::array<uint32_t, 64> powers = [] {
+    std::array<uint32_t, 64> result;
+    result[0] = 1u << 30;  // x^1
+    for (size_t k = 1; k < result.size(); ++k) {
+      result[k] = multiplyModulo(result[k - 1], result[k - 1]);
+    }
+    return result;
+  }();
+
+  uint32_t result = 1u << 31;  // x^0
+  size_t k = 3;                // one byte is x^(2^3)
+
+  while (bytes) {
+    if (bytes & 1) {
+      result = multiplyModulo(powers[k & 63], result);
+    }
+    bytes >>= 1;
+    ++k;
+  }
+
+  return result;
+}
+}  // namespace
+
+uint32_t Crc32c::extend(uint32_t crc, const void* data, size_t size) {
+  return ~rawFunction()(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+uint32_t Crc32c::replace(uint32_t crc, const void* oldBytes,
+                         const void* newBytes, size_t size,
+                         size_t bytesAfter) {
+  // CRC of same length messages differs by raw CRC of their difference
+  const unsigned char* oldData = static_cast<const unsigned char*>(oldBytes);
+  const unsigned char* newData = static_cast<const unsigned char*>(newBytes);
+
+  uint32_t difference = 0;
+  unsigned char chunk[64];
+
+  while (size) {
+    size_t chunkSize = size < sizeof(chunk) ? size : sizeof(chunk);
+    for (size_t i = 0; i < chunkSize; ++i) {
+      chunk[i] = oldData[i] ^ newData[i];
+    }
+
+    difference = rawFunction()(difference, chunk, chunkSize);
+
+    oldData += chunkSize;
+    newData += chunkSize;
+    size -= chunkSize;
+  }
+
+  return crc ^ multiplyModulo(zeroBytesOperator(bytesAfter), difference);
+}
+
+const char* Crc32c::implementation() {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+  if (rawFunction() == rawHardware) {
+    return hardwareName;
+  }
+#endif
+  return "table";
+}
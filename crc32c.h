@@ -0,0 +1,33 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CRC-32C (Castagnoli). Uses SSE4.2 or ARMv8 CRC instructions when CPU has
+ * them, slicing-by-8 tables otherwise.
+ */
+class Crc32c {
+ public:
+  /**
+   * Checksum of bytes following those crc was computed for. Start with 0.
+   */
+  static uint32_t extend(uint32_t crc, const void* data, size_t size);
+
+  /**
+   * Checksum of message after size bytes were replaced. bytesAfter is number
+   * of message bytes following replaced ones. Cost does not depend on message
+   * length.
+   */
+  static uint32_t replace(uint32_t crc, const void* oldBytes,
+                          const void* newBytes, size_t size,
+                          size_t bytesAfter);
+
+  /**
+   * Name of implementation picked for this CPU
+   */
+  static const char* implementation();
+};
+
+#endif  // CRC32C_H
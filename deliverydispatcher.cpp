@@ -0,0 +1,283 @@
+#include "deliverydispatcher.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "logger.h"
+
+namespace {
+// Buffers kept for reuse, more are freed
+const size_t MaxFreeMessages = 256;
+}  // namespace
+
+constexpr std::chrono::milliseconds DeliveryDispatcher::RetryDelay;
+
+DeliveryDispatcher::DeliveryDispatcher(size_t workersCount) {
+  workersCount = std::max<size_t>(workersCount, 1);
+
+  for (size_t i = 0; i < workersCount; ++i) {
+    workers.emplace_back(&DeliveryDispatcher::runWorker, this);
+  }
+}
+
+DeliveryDispatcher::~DeliveryDispatcher() { stop(); }
+
+void DeliveryDispatcher::addConsumer(
+    const std::string& name, const Handler& handler,
+    const ConsumerOptions& options) noexcept(false) {
+  if (options.queueCapacity == 0) {
+    throw DeliveryDispatcherException("Queue of consumer `" + name +
+                                      "' has no room");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (consumers.count(name) != 0) {
+    throw DeliveryDispatcherDuplicateConsumerException(
+        "Consumer `" + name + "' is already added");
+  }
+
+  std::unique_ptr<Consumer> consumer(new Consumer());
+  consumer->name = name;
+  consumer->handler = handler;
+  consumer->options = options;
+  consumers[name] = std::move(consumer);
+}
+
+DeliveryDispatcher::MessagePointer DeliveryDispatcher::createMessage(
+    const TokenRingEngine::ReceivedMessage& receivedMessage) {
+  std::unique_ptr<Message> message;
+
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!freeMessages.empty()) {
+      message = std::move(freeMessages.back());
+      freeMessages.pop_back();
+    }
+  }
+
+  if (!message) {
+    message.reset(new Message());
+  }
+
+  message->senderName = receivedMessage.senderName;
+  message->receiverName = receivedMessage.receiverName;
+  message->messageId = receivedMessage.messageId;
+  message->ring = receivedMessage.ring;
+  // Capacity of reused buffer is kept
+  message->data.assign(receivedMessage.data,
+                       receivedMessage.data + receivedMessage.size);
+
+  return MessagePointer(message.release(), [this](const Message* message) {
+    releaseMessage(const_cast<Message*>(message));
+  });
+}
+
+void DeliveryDispatcher::releaseMessage(Message* message) {
+  std::unique_ptr<Message> owner(message);
+
+  std::lock_guard<std::mutex> lock(poolMutex);
+  if (freeMessages.size() < MaxFreeMessages) {
+    freeMessages.push_back(std::move(owner));
+  }
+}
+
+TokenRingEngine::MessageHandling DeliveryDispatcher::enqueue(
+    Consumer& consumer, const MessagePointer& message) {
+  if (consumer.queue.size() >= consumer.options.queueCapacity) {
+    switch (consumer.options.overflowPolicy) {
+      case OverflowPolicy::REJECT:
+        ++consumer.statistics.rejected;
+        return TokenRingEngine::MessageHandling::BUSY;
+      case OverflowPolicy::DROP_NEWEST:
+        ++consumer.statistics.dropped;
+        return TokenRingEngine::MessageHandling::REFUSED;
+    }
+  }
+
+  consumer.queue.push_back(message);
+  consumer.statistics.maxQueued =
+      std::max(consumer.statistics.maxQueued, consumer.queue.size());
+
+  if (!consumer.scheduled) {
+    consumer.scheduled = true;
+    readyConsumers.push_back(&consumer);
+    workAvailable.notify_one();
+  }
+
+  return TokenRingEngine::MessageHandling::TAKEN;
+}
+
+TokenRingEngine::MessageHandling DeliveryDispatcher::dispatch(
+    const TokenRingEngine::ReceivedMessage& receivedMessage) {
+  // Copied before lock, workers do not wait for it
+  MessagePointer message = createMessage(receivedMessage);
+  bool taken = false;
+  bool busy = false;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (auto& entry : consumers) {
+    Consumer& consumer = *entry.second;
+
+    if (!consumer.options.receiverName.empty() &&
+        consumer.options.receiverName != receivedMessage.receiverName) {
+      continue;
+    }
+
+    switch (enqueue(consumer, message)) {
+      case TokenRingEngine::MessageHandling::TAKEN:
+        taken = true;
+        break;
+      case TokenRingEngine::MessageHandling::BUSY:
+        busy = true;
+        break;
+      case TokenRingEngine::MessageHandling::REFUSED:
+        break;
+    }
+  }
+
+  if (taken) {
+    return TokenRingEngine::MessageHandling::TAKEN;
+  }
+  return busy ? TokenRingEngine::MessageHandling::BUSY
+              : TokenRingEngine::MessageHandling::REFUSED;
+}
+
+void DeliveryDispatcher::scheduleRetries(
+    std::chrono::steady_clock::time_point now) {
+  while (!retryingConsumers.empty() &&
+         retryingConsumers.front()->retryTime <= now) {
+    readyConsumers.push_back(retryingConsumers.front());
+    retryingConsumers.pop_front();
+  }
+}
+
+void DeliveryDispatcher::runWorker() {
+  std::vector<MessagePointer> batch;
+  batch.reserve(BatchSize);
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    if (!stopping) {
+      scheduleRetries(std::chrono::steady_clock::now());
+    }
+
+    if (readyConsumers.empty()) {
+      if (stopping) {
+        return;
+      }
+
+      // Some worker always wakes up for the earliest retry
+      if (retryingConsumers.empty()) {
+        workAvailable.wait(lock);
+      } else {
+        workAvailable.wait_until(lock, retryingConsumers.front()->retryTime);
+      }
+      continue;
+    }
+
+    // Consumer is handled by one worker at a time, so its messages keep order
+    Consumer* consumer = readyConsumers.front();
+    readyConsumers.pop_front();
+    ++busyWorkersCount;
+
+    while (!consumer->queue.empty() && batch.size() < BatchSize) {
+      batch.push_back(std::move(consumer->queue.front()));
+      consumer->queue.pop_front();
+    }
+
+    lock.unlock();
+
+    uint64_t handledCount = 0;
+    uint64_t failedCount = 0;
+    auto message = batch.begin();
+    for (; message != batch.end(); ++message) {
+      try {
+        if (!consumer->handler(**message)) {
+          break;
+        }
+        ++handledCount;
+      } catch (const std::exception& ex) {
+        Logger::getInstance().log("Consumer `" + consumer->name +
+                                  "` failed: " + ex.what());
+        ++failedCount;
+      }
+    }
+    bool retrying = message != batch.end();
+
+    lock.lock();
+
+    // Messages not taken go back in front of newer ones
+    consumer->queue.insert(consumer->queue.begin(),
+                           std::make_move_iterator(message),
+                           std::make_move_iterator(batch.end()));
+    batch.clear();
+
+    consumer->statistics.handled += handledCount;
+    consumer->statistics.failed += failedCount;
+    --busyWorkersCount;
+
+    if (retrying) {
+      ++consumer->statistics.retried;
+      // Retry delay is the same for all, so the deque stays ordered
+      consumer->retryTime = std::chrono::steady_clock::now() + RetryDelay;
+      retryingConsumers.push_back(consumer);
+    } else if (!consumer->queue.empty()) {
+      // Goes to the back, other consumers are not starved
+      readyConsumers.push_back(consumer);
+    } else {
+      consumer->scheduled = false;
+    }
+
+    if (readyConsumers.empty() && busyWorkersCount == 0) {
+      drained.notify_all();
+    }
+  }
+}
+
+DeliveryDispatcher::Statistics DeliveryDispatcher::getStatistics(
+    const std::string& name) const noexcept(false) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto consumer = consumers.find(name);
+  if (consumer == consumers.end()) {
+    throw DeliveryDispatcherUnknownConsumerException("Unknown consumer `" +
+                                                     name + "'");
+  }
+
+  Statistics statistics = consumer->second->statistics;
+  statistics.queued = consumer->second->queue.size();
+
+  return statistics;
+}
+
+std::vector<std::string> DeliveryDispatcher::getConsumerNames() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<std::string> names;
+  for (const auto& entry : consumers) {
+    names.push_back(entry.first);
+  }
+
+  return names;
+}
+
+void DeliveryDispatcher::stop() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this] {
+      return stopping ||
+             (readyConsumers.empty() && busyWorkersCount == 0);
+    });
+    stopping = true;
+  }
+  workAvailable.notify_all();
+
+  for (std::thread& worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#ifndef DELIVERYDISPATCHER_H
+#define DELIVERYDISPATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overflowpolicy.h"
+#include "tokenringengine.h"
+#include "tokenringpacket.h"
+
+using DeliveryDispatcherException = std::runtime_error;
+
+using DeliveryDispatcherUnknownConsumerException = DeliveryDispatcherException;
+
+using DeliveryDispatcherDuplicateConsumerException =
+    DeliveryDispatcherException;
+
+/**
+ * Takes delivered messages off the ring thread. Every consumer has bounded
+ * queue, worker threads call consumer handlers, one message of consumer at a
+ * time and in order. Slow consumer fills its own queue only, ring thread
+ * never waits for it. Sender of queued message is already told it was
+ * delivered, so it stays queued until consumer takes it.
+ */
+class DeliveryDispatcher {
+ public:
+  struct Message {
+    std::string senderName;
+    std::string receiverName;
+    TokenRingPacket::MessageId_t messageId;
+    // See TokenRingEngine::ReceivedMessage
+    uint8_t ring;
+    std::vector<unsigned char> data;
+  };
+
+  /**
+   * Called on worker thread. Returns false if message could not be taken
+   * yet, it is offered again after RetryDelay.
+   */
+  using Handler = std::function<bool(const Message&)>;
+
+  struct ConsumerOptions {
+    size_t queueCapacity{1024};
+    OverflowPolicy overflowPolicy{OverflowPolicy::REJECT};
+    // Empty name takes all messages delivered to host
+    std::string receiverName;
+  };
+
+  struct Statistics {
+    uint64_t handled{0};
+    // Handler threw, message is lost
+    uint64_t failed{0};
+    // Handler did not take message, it was offered again
+    uint64_t retried{0};
+    uint64_t dropped{0};
+    uint64_t rejected{0};
+    size_t queued{0};
+    size_t maxQueued{0};
+  };
+
+  // Messages handled by worker before it looks at other consumers
+  static const size_t BatchSize = 32;
+
+  static constexpr std::chrono::milliseconds RetryDelay{10};
+
+  // Private variables
+ private:
+  using MessagePointer = std::shared_ptr<const Message>;
+
+  struct Consumer {
+    std::string name;
+    Handler handler;
+    ConsumerOptions options;
+    std::deque<MessagePointer> queue;
+    // Waiting in readyConsumers or retryingConsumers or handled by worker
+    bool scheduled{false};
+    std::chrono::steady_clock::time_point retryTime;
+    Statistics statistics;
+  };
+
+  // Free message buffers, declared first so it outlives queued messages
+  std::mutex poolMutex;
+  std::vector<std::unique_ptr<Message>> freeMessages;
+
+  mutable std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable drained;
+  std::map<std::string, std::unique_ptr<Consumer>> consumers;
+  std::deque<Consumer*> readyConsumers;
+  // Handler did not take their first message, ordered by retryTime
+  std::deque<Consumer*> retryingConsumers;
+  size_t busyWorkersCount{0};
+  bool stopping{false};
+
+  std::vector<std::thread> workers;
+
+  // Private methods
+ private:
+  MessagePointer createMessage(
+      const TokenRingEngine::ReceivedMessage& receivedMessage);
+
+  void releaseMessage(Message* message);
+
+  TokenRingEngine::MessageHandling enqueue(Consumer& consumer,
+                                           const MessagePointer& message);
+
+  /**
+   * Moves consumers whose retry time came to readyConsumers
+   */
+  void scheduleRetries(std::chrono::steady_clock::time_point now);
+
+  void runWorker();
+
+ public:
+  explicit DeliveryDispatcher(size_t workersCount);
+
+  DeliveryDispatcher(const DeliveryDispatcher&) = delete;
+  DeliveryDispatcher& operator=(const DeliveryDispatcher&) = delete;
+
+  ~DeliveryDispatcher();
+
+  void addConsumer(const std::string& name, const Handler& handler,
+                   const ConsumerOptions& options) noexcept(false);
+
+  /**
+   * Called on ring thread, copies message into queues of matching consumers.
+   * It is TAKEN if any of them took it, BUSY if any has full queue that
+   * rejects, REFUSED otherwise.
+   */
+  TokenRingEngine::MessageHandling dispatch(
+      const TokenRingEngine::ReceivedMessage& receivedMessage);
+
+  Statistics getStatistics(const std::string& name) const noexcept(false);
+
+  std::vector<std::string> getConsumerNames() const;
+
+  /**
+   * Waits until queued messages are handled and stops workers. Messages
+   * waiting for retry are not waited for.
+   */
+  void stop();
+};
+
+#endif  // DELIVERYDISPATCHER_H
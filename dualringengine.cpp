@@ -0,0 +1,325 @@
+#include "dualringengine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#include "logger.h"
+#include "sharedtransport.h"
+
+const uint8_t DualRingEngine::PrimaryRing;
+const uint8_t DualRingEngine::SecondaryRing;
+
+DualRingEngine::DualRingEngine(const ProgramArguments& programArguments,
+                               Transport& transport,
+                               uint8_t firstRing) noexcept(false)
+    : primaryEngine(new TokenRingEngine(programArguments, transport)),
+      firstRing(firstRing) {
+  primaryEngine->setRing(firstRing);
+
+  if (!programArguments.useDualRing()) {
+    return;
+  }
+
+  if (!programArguments.hasTopology()) {
+    throw DualRingEngineMissingTopologyException(
+        "Dual ring needs topology");
+  }
+
+  createSecondaryRing(programArguments.getUserIdentifier(),
+                      programArguments.getTopology(), transport);
+
+  // Topology constructor does not read arguments, primary engine did. Order
+  // of secondary ring follows primary, see handlePrimaryRingOrder.
+  secondaryEngine->setGreetingCompression(programArguments.useCompression());
+  secondaryEngine->setDirectTransferThreshold(
+      programArguments.getDirectTransferThreshold());
+  secondaryEngine->setLane(programArguments.getLane(),
+                           programArguments.getLanesCount());
+}
+
+DualRingEngine::DualRingEngine(const std::string& hostId,
+                               const Topology& topology, Transport& transport,
+                               bool dualRing,
+                               uint8_t firstRing) noexcept(false)
+    : primaryEngine(new TokenRingEngine(hostId, topology, transport)),
+      firstRing(firstRing) {
+  primaryEngine->setRing(firstRing);
+
+  if (dualRing) {
+    createSecondaryRing(hostId, topology, transport);
+  }
+}
+
+DualRingEngine::~DualRingEngine() = default;
+
+void DualRingEngine::createSecondaryRing(const std::string& hostId,
+                                         const Topology& topology,
+                                         Transport& transport) {
+  secondaryTransport.reset(new SharedTransport(transport));
+  secondaryEngine.reset(
+      new TokenRingEngine(hostId, topology.reversed(), *secondaryTransport));
+  secondaryEngine->setRing(firstRing + SecondaryRing);
+
+  const std::vector<Topology::Host>& hosts = topology.getHosts();
+  for (size_t i = 0; i < hosts.size(); ++i) {
+    ringPositions[hosts[i].name] = i;
+  }
+
+  primaryEngine->setRingOrderHandler(
+      [this](const std::vector<std::string>& order) {
+        handlePrimaryRingOrder(order);
+      });
+
+  primaryEngine->setDeliveryReportHandler(
+      [this](const TokenRingEngine::DeliveryReport& report) {
+        handleDeliveryReport(PrimaryRing, report);
+      });
+  secondaryEngine->setDeliveryReportHandler(
+      [this](const TokenRingEngine::DeliveryReport& report) {
+        handleDeliveryReport(SecondaryRing, report);
+      });
+}
+
+void DualRingEngine::handlePrimaryRingOrder(
+    const std::vector<std::string>& order) {
+  ringPositions.clear();
+  for (size_t i = 0; i < order.size(); ++i) {
+    ringPositions[order[i]] = i;
+  }
+
+  // Secondary ring keeps running the other way round
+  if (secondaryEngine->isRingCoordinator()) {
+    secondaryRingOrder.assign(order.rbegin(), order.rend());
+    requestSecondaryRingOrder();
+  }
+}
+
+void DualRingEngine::requestSecondaryRingOrder() {
+  if (secondaryEngine->requestRingOrder(secondaryRingOrder)) {
+    secondaryRingOrder.clear();
+  }
+}
+
+bool DualRingEngine::isDualRing() const {
+  return secondaryEngine != nullptr;
+}
+
+uint8_t DualRingEngine::selectRing(const std::string& receiverName) const {
+  // Multicast reaches every member on either ring
+  if (TokenRingPacket::isMulticastReceiver(receiverName)) {
+    return PrimaryRing;
+  }
+
+  bool primaryReaches = primaryEngine->knowsHost(receiverName);
+  bool secondaryReaches = secondaryEngine->knowsHost(receiverName);
+  if (primaryReaches != secondaryReaches) {
+    return primaryReaches ? PrimaryRing : SecondaryRing;
+  }
+
+  auto sender = ringPositions.find(getHostId());
+  auto receiver = ringPositions.find(receiverName);
+  if (sender == ringPositions.end() || receiver == ringPositions.end()) {
+    return PrimaryRing;
+  }
+
+  size_t hostsCount = ringPositions.size();
+  size_t primaryHops =
+      (receiver->second + hostsCount - sender->second) % hostsCount;
+  size_t secondaryHops = (hostsCount - primaryHops) % hostsCount;
+
+  return secondaryHops < primaryHops ? SecondaryRing : PrimaryRing;
+}
+
+TokenRingEngine& DualRingEngine::getEngine(uint8_t ring) {
+  return ring == SecondaryRing ? *secondaryEngine : *primaryEngine;
+}
+
+void DualRingEngine::sendOnRing(uint8_t ring, const std::string& receiverName,
+                                PendingMessage message) noexcept(false) {
+  TokenRingPacket::MessageId_t engineMessageId =
+      getEngine(ring).sendMessage(receiverName, message.data,
+                                  message.compress);
+
+  pendingMessages[std::make_pair(ring, engineMessageId)] = std::move(message);
+}
+
+void DualRingEngine::handleDeliveryReport(
+    uint8_t ring, const TokenRingEngine::DeliveryReport& report) {
+  auto pending = pendingMessages.find(std::make_pair(ring, report.messageId));
+  if (pending == pendingMessages.end()) {
+    return;
+  }
+
+  PendingMessage message = std::move(pending->second);
+  pendingMessages.erase(pending);
+
+  // Ring could not reach receiver, the other one goes around the failure
+  if (!message.wrapped &&
+      (report.status == TokenRingEngine::DeliveryStatus::RECEIVER_NOT_FOUND ||
+       report.status == TokenRingEngine::DeliveryStatus::LOST)) {
+    uint8_t otherRing = ring == PrimaryRing ? SecondaryRing : PrimaryRing;
+
+    Logger::getInstance().log("[" + getHostId() + "] Wrapping message for `" +
+                              report.receiverName + "` onto ring " +
+                              std::to_string(otherRing) + ".");
+
+    message.wrapped = true;
+    try {
+      sendOnRing(otherRing, report.receiverName, std::move(message));
+      return;
+    } catch (const TokenRingPacketException& ex) {
+      Logger::getInstance().log("[" + getHostId() +
+                                "] Wrapping failed: " + ex.what());
+    }
+  }
+
+  if (deliveryReportHandler) {
+    TokenRingEngine::DeliveryReport dualRingReport = report;
+    dualRingReport.messageId = message.messageId;
+    deliveryReportHandler(dualRingReport);
+  }
+}
+
+void DualRingEngine::setTiming(const TokenRingEngine::Timing& timing) {
+  primaryEngine->setTiming(timing);
+  if (secondaryEngine) {
+    TokenRingEngine::Timing secondaryTiming = timing;
+    secondaryTiming.reorderInterval = std::chrono::milliseconds::zero();
+    secondaryEngine->setTiming(secondaryTiming);
+  }
+}
+
+void DualRingEngine::setDirectTransferThreshold(size_t threshold) {
+  primaryEngine->setDirectTransferThreshold(threshold);
+  if (secondaryEngine) {
+    secondaryEngine->setDirectTransferThreshold(threshold);
+  }
+}
+
+void DualRingEngine::setRoutedMessages(bool enabled) {
+  primaryEngine->setRoutedMessages(enabled);
+  if (secondaryEngine) {
+    secondaryEngine->setRoutedMessages(enabled);
+  }
+}
+
+void DualRingEngine::setLane(size_t lane, size_t lanesCount) {
+  primaryEngine->setLane(lane, lanesCount);
+  if (secondaryEngine) {
+    secondaryEngine->setLane(lane, lanesCount);
+  }
+}
+
+void DualRingEngine::setRandomSeed(uint32_t seed) {
+  primaryEngine->setRandomSeed(seed);
+  if (secondaryEngine) {
+    secondaryEngine->setRandomSeed(~seed);
+  }
+}
+
+TokenRingPacket::MessageId_t DualRingEngine::sendMessage(
+    const std::string& receiverName, const std::vector<unsigned char>& data,
+    bool compress) noexcept(false) {
+  if (!secondaryEngine) {
+    return primaryEngine->sendMessage(receiverName, data, compress);
+  }
+
+  PendingMessage message;
+  message.messageId = nextMessageId;
+  message.data = data;
+  message.compress = compress;
+  message.wrapped = false;
+
+  sendOnRing(selectRing(receiverName), receiverName, std::move(message));
+
+  return nextMessageId++;
+}
+
+void DualRingEngine::setDeliveryReportHandler(
+    const TokenRingEngine::DeliveryReportHandler& handler) {
+  if (!secondaryEngine) {
+    primaryEngine->setDeliveryReportHandler(handler);
+    return;
+  }
+
+  deliveryReportHandler = handler;
+}
+
+void DualRingEngine::setMessageHandler(
+    const TokenRingEngine::MessageHandler& handler) {
+  primaryEngine->setMessageHandler(handler);
+  if (secondaryEngine) {
+    secondaryEngine->setMessageHandler(handler);
+  }
+}
+
+void DualRingEngine::start(TimePoint now) {
+  primaryEngine->start(now);
+  if (secondaryEngine) {
+    secondaryEngine->start(now);
+  }
+}
+
+void DualRingEngine::handleFrame(const Serializable::container_type& frame,
+                                 TimePoint now, TimePoint receiveTime) {
+  uint8_t ring = firstRing;
+  if (frame.size() >= sizeof(TokenRingPacket::Header)) {
+    std::memcpy(&ring,
+                frame.data() + offsetof(TokenRingPacket::Header, ring),
+                sizeof(ring));
+  }
+  ring = (ring & ~TokenRingPacket::RingRoutedBit) - firstRing;
+
+  if (ring == PrimaryRing) {
+    primaryEngine->handleFrame(frame, now, receiveTime);
+  } else if (ring == SecondaryRing && secondaryEngine) {
+    secondaryEngine->handleFrame(frame, now, receiveTime);
+  } else {
+    Logger::getInstance().log("[" + getHostId() +
+                              "] Dropping frame of unknown ring " +
+                              std::to_string(ring + firstRing) + ".");
+  }
+}
+
+void DualRingEngine::handleTimeout(TimePoint now) {
+  primaryEngine->handleTimeout(now);
+  if (secondaryEngine) {
+    secondaryEngine->handleTimeout(now);
+    // Retried until membership changes of secondary ring settle
+    if (!secondaryRingOrder.empty()) {
+      requestSecondaryRingOrder();
+    }
+  }
+}
+
+DualRingEngine::TimePoint DualRingEngine::getNextTimeout() const {
+  TimePoint timeout = primaryEngine->getNextTimeout();
+  if (secondaryEngine) {
+    timeout = std::min(timeout, secondaryEngine->getNextTimeout());
+  }
+
+  return timeout;
+}
+
+void DualRingEngine::leave(TimePoint now) {
+  primaryEngine->leave(now);
+  if (secondaryEngine) {
+    secondaryEngine->leave(now);
+  }
+}
+
+bool DualRingEngine::hasLeft(TimePoint now) const {
+  return primaryEngine->hasLeft(now) &&
+         (!secondaryEngine || secondaryEngine->hasLeft(now));
+}
+
+const std::string& DualRingEngine::getHostId() const {
+  return primaryEngine->getHostId();
+}
+
+bool DualRingEngine::holdsToken() const {
+  return primaryEngine->holdsToken() ||
+         (secondaryEngine && secondaryEngine->holdsToken());
+}
@@ -0,0 +1,154 @@
+#ifndef DUALRINGENGINE_H
+#define DUALRINGENGINE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "programarguments.h"
+#include "tokenringengine.h"
+#include "tokenringpacket.h"
+#include "topology.h"
+#include "transport.h"
+
+using DualRingEngineException = std::runtime_error;
+
+using DualRingEngineMissingTopologyException = DualRingEngineException;
+
+/**
+ * Two counter-rotating rings over the same hosts, as in FDDI. Primary ring
+ * follows topology, secondary ring goes the other way with its own token.
+ * Both share transport, frames tell their ring in header.ring.
+ *
+ * Message takes ring with fewer hops to its receiver. Receiver that ring
+ * lost (it was bypassed after link failure) is reached over the other ring,
+ * message that came back not found or lost is wrapped onto it too.
+ *
+ * Without secondary ring it is plain token ring engine. Rings of another dual
+ * ring over the same transport are told apart by firstRing, see
+ * HierarchicalEngine.
+ */
+class DualRingEngine {
+ public:
+  using TimePoint = TokenRingEngine::TimePoint;
+
+  static const uint8_t PrimaryRing = 0;
+  static const uint8_t SecondaryRing = 1;
+
+  // Private variables
+ private:
+  std::unique_ptr<TokenRingEngine> primaryEngine;
+
+  // header.ring of primary ring frames, secondary ring uses the next one
+  uint8_t firstRing{PrimaryRing};
+
+  std::unique_ptr<Transport> secondaryTransport;
+  std::unique_ptr<TokenRingEngine> secondaryEngine;
+
+  // Positions of hosts on primary ring, updated when it is reordered
+  std::map<std::string, size_t> ringPositions;
+
+  // Order secondary ring coordinator waits to take, reverse of primary ring
+  std::vector<std::string> secondaryRingOrder;
+
+  TokenRingEngine::DeliveryReportHandler deliveryReportHandler;
+
+  // Sent messages waiting for report, by ring and id given by its engine
+  struct PendingMessage {
+    TokenRingPacket::MessageId_t messageId;
+    std::vector<unsigned char> data;
+    bool compress;
+    bool wrapped;
+  };
+  std::map<std::pair<uint8_t, TokenRingPacket::MessageId_t>, PendingMessage>
+      pendingMessages;
+  TokenRingPacket::MessageId_t nextMessageId{1};
+
+  // Private methods
+ private:
+  /**
+   * Follows committed order of primary ring
+   */
+  void handlePrimaryRingOrder(const std::vector<std::string>& order);
+
+  void requestSecondaryRingOrder();
+
+  void createSecondaryRing(const std::string& hostId,
+                           const Topology& topology, Transport& transport);
+
+  uint8_t selectRing(const std::string& receiverName) const;
+
+  TokenRingEngine& getEngine(uint8_t ring);
+
+  void sendOnRing(uint8_t ring, const std::string& receiverName,
+                  PendingMessage message) noexcept(false);
+
+  void handleDeliveryReport(uint8_t ring,
+                            const TokenRingEngine::DeliveryReport& report);
+
+ public:
+  /**
+   * Secondary ring is run with --dual-ring, it needs topology
+   */
+  DualRingEngine(const ProgramArguments& programArguments,
+                 Transport& transport,
+                 uint8_t firstRing = PrimaryRing) noexcept(false);
+
+  DualRingEngine(const std::string& hostId, const Topology& topology,
+                 Transport& transport, bool dualRing,
+                 uint8_t firstRing = PrimaryRing) noexcept(false);
+
+  ~DualRingEngine();
+
+  bool isDualRing() const;
+
+  void setTiming(const TokenRingEngine::Timing& timing);
+
+  void setDirectTransferThreshold(size_t threshold);
+
+  void setRoutedMessages(bool enabled);
+
+  void setLane(size_t lane, size_t lanesCount);
+
+  void setRandomSeed(uint32_t seed);
+
+  /**
+   * See TokenRingEngine::sendMessage(). Messages to one receiver keep order
+   * while they take the same ring.
+   */
+  TokenRingPacket::MessageId_t sendMessage(
+      const std::string& receiverName, const std::vector<unsigned char>& data,
+      bool compress = false) noexcept(false);
+
+  /**
+   * Message wrapped onto the other ring is reported once, with its final
+   * status. Greetings are not reported.
+   */
+  void setDeliveryReportHandler(
+      const TokenRingEngine::DeliveryReportHandler& handler);
+
+  void setMessageHandler(const TokenRingEngine::MessageHandler& handler);
+
+  void start(TimePoint now);
+
+  void handleFrame(const Serializable::container_type& frame, TimePoint now,
+                   TimePoint receiveTime = TimePoint());
+
+  void handleTimeout(TimePoint now);
+
+  TimePoint getNextTimeout() const;
+
+  void leave(TimePoint now);
+
+  bool hasLeft(TimePoint now) const;
+
+  const std::string& getHostId() const;
+
+  bool holdsToken() const;
+};
+
+#endif  // DUALRINGENGINE_H
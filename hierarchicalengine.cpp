@@ -0,0 +1,342 @@
+#include "hierarchicalengine.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#include "logger.h"
+#include "sharedtransport.h"
+#include "utility.h"
+
+const uint8_t HierarchicalEngine::BackboneFirstRing;
+const uint8_t HierarchicalEngine::RoutedRing;
+
+HierarchicalEngine::HierarchicalEngine(
+    const ProgramArguments& programArguments,
+    Transport& transport) noexcept(false) {
+  if (!programArguments.hasHierarchy()) {
+    localEngine.reset(new DualRingEngine(programArguments, transport));
+    return;
+  }
+
+  const std::string hostId = programArguments.getUserIdentifier();
+  const RingHierarchy& hierarchy = programArguments.getHierarchy();
+
+  // Topology of arguments is host's local ring
+  localEngine.reset(new DualRingEngine(
+      programArguments, transport, getLocalFirstRing(hostId, hierarchy)));
+
+  createBackbone(hostId, hierarchy, transport, programArguments.useDualRing());
+
+  if (backboneEngine) {
+    TokenRingEngine::Timing timing;
+    timing.reorderInterval =
+        std::chrono::milliseconds(programArguments.getReorderInterval());
+    backboneEngine->setTiming(timing);
+    backboneEngine->setDirectTransferThreshold(
+        programArguments.getDirectTransferThreshold());
+    backboneEngine->setLane(programArguments.getLane(),
+                            programArguments.getLanesCount());
+  }
+}
+
+HierarchicalEngine::HierarchicalEngine(const std::string& hostId,
+                                       const RingHierarchy& hierarchy,
+                                       Transport& transport,
+                                       bool dualRing) noexcept(false)
+    : localEngine(new DualRingEngine(
+          hostId, hierarchy.getRing(hierarchy.getLocalRingOf(hostId)),
+          transport, dualRing, getLocalFirstRing(hostId, hierarchy))) {
+  createBackbone(hostId, hierarchy, transport, dualRing);
+}
+
+HierarchicalEngine::~HierarchicalEngine() = default;
+
+uint8_t HierarchicalEngine::getLocalFirstRing(
+    const std::string& hostId, const RingHierarchy& hierarchy) {
+  if (hierarchy.getRings().size() > 1 &&
+      hierarchy.getLocalRingOf(hostId) == RingHierarchy::BackboneRingName) {
+    return BackboneFirstRing;
+  }
+
+  return DualRingEngine::PrimaryRing;
+}
+
+void HierarchicalEngine::createBackbone(const std::string& hostId,
+                                        const RingHierarchy& hierarchy,
+                                        Transport& transport,
+                                        bool dualRing) noexcept(false) {
+  if (hierarchy.getRings().size() <= 1) {
+    return;
+  }
+
+  routing = true;
+  routes = hierarchy.getRoutingTable(hostId);
+  localEngine->setRoutedMessages(true);
+
+  if (hierarchy.isOnBackbone(hostId) &&
+      hierarchy.getLocalRingOf(hostId) != RingHierarchy::BackboneRingName) {
+    backboneTransport.reset(new SharedTransport(transport));
+    backboneEngine.reset(new DualRingEngine(
+        hostId, hierarchy.getRing(RingHierarchy::BackboneRingName),
+        *backboneTransport, dualRing, BackboneFirstRing));
+    backboneEngine->setRoutedMessages(true);
+  }
+
+  localEngine->setMessageHandler(
+      [this](const TokenRingEngine::ReceivedMessage& message) {
+        return handleMessage(message);
+      });
+  localEngine->setDeliveryReportHandler(
+      [this](const TokenRingEngine::DeliveryReport& report) {
+        handleDeliveryReport(false, report);
+      });
+
+  if (backboneEngine) {
+    backboneEngine->setMessageHandler(
+        [this](const TokenRingEngine::ReceivedMessage& message) {
+          return handleMessage(message);
+        });
+    backboneEngine->setDeliveryReportHandler(
+        [this](const TokenRingEngine::DeliveryReport& report) {
+          handleDeliveryReport(true, report);
+        });
+  }
+}
+
+bool HierarchicalEngine::isBridge() const { return backboneEngine != nullptr; }
+
+DualRingEngine& HierarchicalEngine::getEngine(
+    const RingHierarchy::Route& route) {
+  if (backboneEngine && route.ringName == RingHierarchy::BackboneRingName) {
+    return *backboneEngine;
+  }
+
+  return *localEngine;
+}
+
+TokenRingEngine::MessageHandling HierarchicalEngine::handleMessage(
+    const TokenRingEngine::ReceivedMessage& message) {
+  // Greetings are sent by engines themselves, without envelope
+  if (!message.routed) {
+    return messageHandler ? messageHandler(message)
+                          : TokenRingEngine::MessageHandling::TAKEN;
+  }
+
+  Envelope envelope;
+  if (message.size < sizeof(envelope)) {
+    Logger::getInstance().log("[" + getHostId() + "] Refusing message from `" +
+                              message.senderName + "` without envelope.");
+    return TokenRingEngine::MessageHandling::REFUSED;
+  }
+  std::memcpy(&envelope, message.data, sizeof(envelope));
+
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      envelope.finalReceiverName, TokenRingPacket::NameMaxSize);
+
+  if (receiverName == getHostId() ||
+      TokenRingPacket::isMulticastReceiver(receiverName)) {
+    TokenRingEngine::ReceivedMessage delivered = message;
+    delivered.senderName = maybeNonterminatedCharArrayToString(
+        envelope.originalSenderName, TokenRingPacket::NameMaxSize);
+    delivered.receiverName = receiverName;
+    delivered.messageId = ntohl(envelope.messageId);
+    delivered.ring = RoutedRing;
+    delivered.data = message.data + sizeof(envelope);
+    delivered.size = message.size - sizeof(envelope);
+
+    return messageHandler ? messageHandler(delivered)
+                          : TokenRingEngine::MessageHandling::TAKEN;
+  }
+
+  auto route = routes.find(receiverName);
+  if (route == routes.end()) {
+    Logger::getInstance().log("[" + getHostId() + "] No route to `" +
+                              receiverName + "`.");
+    return TokenRingEngine::MessageHandling::REFUSED;
+  }
+
+  Logger::getInstance().log("[" + getHostId() + "] Routing message for `" +
+                            receiverName + "` to `" +
+                            route->second.nextHopName + "` on ring `" +
+                            route->second.ringName + "`.");
+
+  // Envelope goes on as it came
+  try {
+    getEngine(route->second)
+        .sendMessage(route->second.nextHopName,
+                     std::vector<unsigned char>(message.data,
+                                                message.data + message.size));
+  } catch (const TokenRingPacketException& ex) {
+    Logger::getInstance().log("[" + getHostId() +
+                              "] Routing failed: " + ex.what());
+    return TokenRingEngine::MessageHandling::REFUSED;
+  }
+
+  return TokenRingEngine::MessageHandling::TAKEN;
+}
+
+void HierarchicalEngine::handleDeliveryReport(
+    bool backbone, const TokenRingEngine::DeliveryReport& report) {
+  auto pending =
+      pendingMessages.find(std::make_pair(backbone, report.messageId));
+  if (pending == pendingMessages.end()) {
+    return;
+  }
+
+  TokenRingEngine::DeliveryReport hierarchyReport = report;
+  hierarchyReport.messageId = pending->second;
+  pendingMessages.erase(pending);
+
+  if (deliveryReportHandler) {
+    deliveryReportHandler(hierarchyReport);
+  }
+}
+
+void HierarchicalEngine::setTiming(const TokenRingEngine::Timing& timing) {
+  localEngine->setTiming(timing);
+  if (backboneEngine) {
+    backboneEngine->setTiming(timing);
+  }
+}
+
+void HierarchicalEngine::setDirectTransferThreshold(size_t threshold) {
+  localEngine->setDirectTransferThreshold(threshold);
+  if (backboneEngine) {
+    backboneEngine->setDirectTransferThreshold(threshold);
+  }
+}
+
+void HierarchicalEngine::setLane(size_t lane, size_t lanesCount) {
+  localEngine->setLane(lane, lanesCount);
+  if (backboneEngine) {
+    backboneEngine->setLane(lane, lanesCount);
+  }
+}
+
+void HierarchicalEngine::setRandomSeed(uint32_t seed) {
+  localEngine->setRandomSeed(seed);
+  if (backboneEngine) {
+    backboneEngine->setRandomSeed(seed ^ 0x5bd1e995u);
+  }
+}
+
+TokenRingPacket::MessageId_t HierarchicalEngine::sendMessage(
+    const std::string& receiverName, const std::vector<unsigned char>& data,
+    bool compress) noexcept(false) {
+  if (!routing) {
+    return localEngine->sendMessage(receiverName, data, compress);
+  }
+
+  Envelope envelope{};
+  envelope.messageId = htonl(nextMessageId);
+  insertStringToCharArrayWithLength(getHostId(), envelope.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(receiverName, envelope.finalReceiverName,
+                                    TokenRingPacket::NameMaxSize);
+
+  std::vector<unsigned char> envelopedData(sizeof(envelope) + data.size());
+  std::memcpy(envelopedData.data(), &envelope, sizeof(envelope));
+  std::copy(data.begin(), data.end(), envelopedData.begin() + sizeof(envelope));
+
+  // Multicast and unknown receivers are left to local ring
+  RingHierarchy::Route route;
+  route.nextHopName = receiverName;
+  auto found = routes.find(receiverName);
+  if (found != routes.end() &&
+      !TokenRingPacket::isMulticastReceiver(receiverName)) {
+    route = found->second;
+  }
+
+  DualRingEngine& engine = getEngine(route);
+  TokenRingPacket::MessageId_t engineMessageId =
+      engine.sendMessage(route.nextHopName, envelopedData, compress);
+  pendingMessages[std::make_pair(&engine == backboneEngine.get(),
+                                 engineMessageId)] = nextMessageId;
+
+  return nextMessageId++;
+}
+
+void HierarchicalEngine::setDeliveryReportHandler(
+    const TokenRingEngine::DeliveryReportHandler& handler) {
+  if (!routing) {
+    localEngine->setDeliveryReportHandler(handler);
+    return;
+  }
+
+  deliveryReportHandler = handler;
+}
+
+void HierarchicalEngine::setMessageHandler(
+    const TokenRingEngine::MessageHandler& handler) {
+  if (!routing) {
+    localEngine->setMessageHandler(handler);
+    return;
+  }
+
+  messageHandler = handler;
+}
+
+void HierarchicalEngine::start(TimePoint now) {
+  localEngine->start(now);
+  if (backboneEngine) {
+    backboneEngine->start(now);
+  }
+}
+
+void HierarchicalEngine::handleFrame(const Serializable::container_type& frame,
+                                     TimePoint now, TimePoint receiveTime) {
+  uint8_t ring = DualRingEngine::PrimaryRing;
+  if (frame.size() >= sizeof(TokenRingPacket::Header)) {
+    std::memcpy(&ring,
+                frame.data() + offsetof(TokenRingPacket::Header, ring),
+                sizeof(ring));
+  }
+  ring &= ~TokenRingPacket::RingRoutedBit;
+
+  if (backboneEngine && ring >= BackboneFirstRing) {
+    backboneEngine->handleFrame(frame, now, receiveTime);
+  } else {
+    localEngine->handleFrame(frame, now, receiveTime);
+  }
+}
+
+void HierarchicalEngine::handleTimeout(TimePoint now) {
+  localEngine->handleTimeout(now);
+  if (backboneEngine) {
+    backboneEngine->handleTimeout(now);
+  }
+}
+
+HierarchicalEngine::TimePoint HierarchicalEngine::getNextTimeout() const {
+  TimePoint timeout = localEngine->getNextTimeout();
+  if (backboneEngine) {
+    timeout = std::min(timeout, backboneEngine->getNextTimeout());
+  }
+
+  return timeout;
+}
+
+void HierarchicalEngine::leave(TimePoint now) {
+  localEngine->leave(now);
+  if (backboneEngine) {
+    backboneEngine->leave(now);
+  }
+}
+
+bool HierarchicalEngine::hasLeft(TimePoint now) const {
+  return localEngine->hasLeft(now) &&
+         (!backboneEngine || backboneEngine->hasLeft(now));
+}
+
+const std::string& HierarchicalEngine::getHostId() const {
+  return localEngine->getHostId();
+}
+
+bool HierarchicalEngine::holdsToken() const {
+  return localEngine->holdsToken() ||
+         (backboneEngine && backboneEngine->holdsToken());
+}
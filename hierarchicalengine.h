@@ -0,0 +1,155 @@
+#ifndef HIERARCHICALENGINE_H
+#define HIERARCHICALENGINE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dualringengine.h"
+#include "programarguments.h"
+#include "ringhierarchy.h"
+#include "tokenringengine.h"
+#include "tokenringpacket.h"
+#include "transport.h"
+
+/**
+ * Engine of host in ring of rings (see RingHierarchy). Host runs its local
+ * ring, bridge runs backbone ring too, over the same transport. Backbone
+ * frames carry header.ring from BackboneFirstRing on.
+ *
+ * Message for host of another ring goes to bridge of local ring, over
+ * backbone to bridge of receiver's ring and down to receiver. Each hop is
+ * reliable and keeps order, sender is told message reached the first hop.
+ * In hierarchy every message carries Envelope with its original sender and
+ * final receiver, its DATA frames are marked with RingRoutedBit. Greetings
+ * are not, they are delivered as they come. Message for receiver without
+ * route is refused, its sender is told it was not copied.
+ * Multicast stays on local ring.
+ *
+ * Without hierarchy it is dual ring engine of topology.
+ */
+class HierarchicalEngine {
+ public:
+  using TimePoint = TokenRingEngine::TimePoint;
+
+  static const uint8_t BackboneFirstRing = 2;
+
+  // ReceivedMessage::ring of enveloped messages, their ids are given by
+  // original sender's hierarchical engine
+  static const uint8_t RoutedRing = 255;
+
+#pragma pack(push, 1)
+  /**
+   * Precedes data of message in hierarchy, fields in network order
+   */
+  struct Envelope {
+    TokenRingPacket::MessageId_t messageId;
+    char originalSenderName[TokenRingPacket::NameMaxSize];
+    char finalReceiverName[TokenRingPacket::NameMaxSize];
+  };
+#pragma pack(pop)
+
+  // Private variables
+ private:
+  std::unique_ptr<DualRingEngine> localEngine;
+
+  std::unique_ptr<Transport> backboneTransport;
+  std::unique_ptr<DualRingEngine> backboneEngine;
+
+  // Set when hierarchy has more than one ring, messages are routed then
+  bool routing{false};
+  std::map<std::string, RingHierarchy::Route> routes;
+
+  TokenRingEngine::MessageHandler messageHandler;
+  TokenRingEngine::DeliveryReportHandler deliveryReportHandler;
+
+  // Ids of sent messages by engine (backbone or not) and its id
+  std::map<std::pair<bool, TokenRingPacket::MessageId_t>,
+           TokenRingPacket::MessageId_t>
+      pendingMessages;
+  TokenRingPacket::MessageId_t nextMessageId{1};
+
+  // Private methods
+ private:
+  /**
+   * header.ring of host's local ring frames, backbone-only host runs
+   * backbone as its local ring
+   */
+  static uint8_t getLocalFirstRing(const std::string& hostId,
+                                   const RingHierarchy& hierarchy);
+
+  void createBackbone(const std::string& hostId,
+                      const RingHierarchy& hierarchy, Transport& transport,
+                      bool dualRing) noexcept(false);
+
+  DualRingEngine& getEngine(const RingHierarchy::Route& route);
+
+  TokenRingEngine::MessageHandling handleMessage(
+      const TokenRingEngine::ReceivedMessage& message);
+
+  void handleDeliveryReport(bool backbone,
+                            const TokenRingEngine::DeliveryReport& report);
+
+ public:
+  /**
+   * Ring of rings is run with --hierarchy, plain ring with --topology or
+   * neighbor address
+   */
+  HierarchicalEngine(const ProgramArguments& programArguments,
+                     Transport& transport) noexcept(false);
+
+  HierarchicalEngine(const std::string& hostId,
+                     const RingHierarchy& hierarchy, Transport& transport,
+                     bool dualRing) noexcept(false);
+
+  ~HierarchicalEngine();
+
+  bool isBridge() const;
+
+  void setTiming(const TokenRingEngine::Timing& timing);
+
+  void setDirectTransferThreshold(size_t threshold);
+
+  void setLane(size_t lane, size_t lanesCount);
+
+  void setRandomSeed(uint32_t seed);
+
+  /**
+   * See TokenRingEngine::sendMessage(). In hierarchy Envelope takes part of
+   * data size limit.
+   */
+  TokenRingPacket::MessageId_t sendMessage(
+      const std::string& receiverName, const std::vector<unsigned char>& data,
+      bool compress = false) noexcept(false);
+
+  void setDeliveryReportHandler(
+      const TokenRingEngine::DeliveryReportHandler& handler);
+
+  /**
+   * Handler gets messages with their original sender, messages passing
+   * through bridge are not shown to it
+   */
+  void setMessageHandler(const TokenRingEngine::MessageHandler& handler);
+
+  void start(TimePoint now);
+
+  void handleFrame(const Serializable::container_type& frame, TimePoint now,
+                   TimePoint receiveTime = TimePoint());
+
+  void handleTimeout(TimePoint now);
+
+  TimePoint getNextTimeout() const;
+
+  void leave(TimePoint now);
+
+  bool hasLeft(TimePoint now) const;
+
+  const std::string& getHostId() const;
+
+  bool holdsToken() const;
+};
+
+#endif  // HIERARCHICALENGINE_H
@@ -1,5 +1,7 @@
 #include "ip4.h"
 
+#include <ifaddrs.h>
+
 #include <cstring>
 #include <string>
 
@@ -15,4 +17,31 @@ Ip4 Ip4_from_string(const std::string& str) {
   return address;
 }
 
+Ip4 Ip4_from_interface(const std::string& name) {
+  struct ifaddrs* interfaces = nullptr;
+
+  if (::getifaddrs(&interfaces) == -1) {
+    throw Ip4InvalidInputException("Failed to list network interfaces");
+  }
+
+  bool found = false;
+  Ip4 address{};
+  for (struct ifaddrs* it = interfaces; it; it = it->ifa_next) {
+    if (it->ifa_addr && it->ifa_addr->sa_family == AF_INET &&
+        name == it->ifa_name) {
+      address = reinterpret_cast<struct sockaddr_in*>(it->ifa_addr)->sin_addr;
+      found = true;
+      break;
+    }
+  }
+  ::freeifaddrs(interfaces);
+
+  if (!found) {
+    throw Ip4InvalidInputException(std::string("No IPv4 address on interface `") +
+                                   name + "'");
+  }
+
+  return address;
+}
+
 std::string to_string(const Ip4& ip4) { return std::string(inet_ntoa(ip4)); }
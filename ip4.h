@@ -15,6 +15,11 @@ using Ip4 = struct in_addr;
 
 Ip4 Ip4_from_string(const std::string& str);
 
+/**
+ * First IPv4 address of network interface (e.g. `eth0`)
+ */
+Ip4 Ip4_from_interface(const std::string& name);
+
 std::string to_string(const Ip4& ip4);
 
 #endif  // IP4_H
@@ -0,0 +1,70 @@
+#include "latencyreport.h"
+#include "utility.h"
+
+#include <cstring>
+
+LatencyReport::LatencyReport(
+    const Serializable::container_type &sourceBuffer) noexcept(false) {
+  fromBinary(sourceBuffer);
+}
+
+LatencyReport::Entry LatencyReport::createEntry(const std::string &hostName,
+                                                uint32_t roundTripTime) {
+  Entry entry{};
+  insertStringToCharArrayWithLength(hostName, entry.hostName,
+                                    TokenRingPacket::NameMaxSize);
+  entry.roundTripTime = roundTripTime;
+  return entry;
+}
+
+const std::vector<LatencyReport::Entry> &LatencyReport::getEntries() const {
+  return entries;
+}
+
+void LatencyReport::addEntry(const Entry &entry) noexcept(false) {
+  if (isFull()) {
+    throw LatencyReportTooManyEntriesException(
+        "Latency report can hold at most MaxEntries entries");
+  }
+  entries.push_back(entry);
+}
+
+bool LatencyReport::isFull() const { return entries.size() >= MaxEntries; }
+
+bool LatencyReport::empty() const { return entries.empty(); }
+
+Serializable::size_type LatencyReport::fromBinary(
+    const Serializable::container_type &buffer) noexcept(false) {
+  uint16_t entriesCount;
+
+  if (buffer.size() < sizeof(entriesCount)) {
+    throw LatencyReportInputBufferTooSmallException(
+        "Passed input buffer is too small");
+  }
+
+  std::memcpy(&entriesCount, buffer.data(), sizeof(entriesCount));
+
+  size_t entriesSize = entriesCount * sizeof(Entry);
+  if (buffer.size() - sizeof(entriesCount) < entriesSize) {
+    throw LatencyReportInputBufferTooSmallException(
+        "Passed input buffer contains less entries than declared");
+  }
+
+  entries.resize(entriesCount);
+  std::memcpy(entries.data(), buffer.data() + sizeof(entriesCount),
+              entriesSize);
+
+  return sizeof(entriesCount) + entriesSize;
+}
+
+Serializable::container_type LatencyReport::toBinary() const {
+  uint16_t entriesCount = static_cast<uint16_t>(entries.size());
+
+  Serializable::container_type buffer(sizeof(entriesCount) +
+                                      entries.size() * sizeof(Entry));
+  std::memcpy(buffer.data(), &entriesCount, sizeof(entriesCount));
+  std::memcpy(buffer.data() + sizeof(entriesCount), entries.data(),
+              entries.size() * sizeof(Entry));
+
+  return buffer;
+}
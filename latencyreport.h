@@ -0,0 +1,65 @@
+#ifndef LATENCYREPORT_H
+#define LATENCYREPORT_H
+
+#include <cstdint>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "serializable.h"
+#include "tokenringpacket.h"
+
+using LatencyReportException = std::runtime_error;
+
+using LatencyReportInputBufferTooSmallException = LatencyReportException;
+
+using LatencyReportTooManyEntriesException = LatencyReportException;
+
+/**
+ * Payload of LATENCY_REPORT packet. Round trip times from packet
+ * originalSenderName to other ring members, see RingOrdering.
+ */
+class LatencyReport : public Serializable {
+ public:
+#pragma pack(push, 1)
+  struct Entry {
+    char hostName[TokenRingPacket::NameMaxSize];
+
+    // Microseconds
+    uint32_t roundTripTime;
+  };
+#pragma pack(pop)
+
+  static const size_t MaxEntries =
+      (TokenRingPacket::DataMaxSize - sizeof(uint16_t)) / sizeof(Entry);
+
+ private:
+  std::vector<Entry> entries;
+
+ public:
+  LatencyReport() = default;
+
+  explicit LatencyReport(
+      const Serializable::container_type& sourceBuffer) noexcept(false);
+
+  virtual ~LatencyReport() = default;
+
+  static Entry createEntry(const std::string& hostName,
+                           uint32_t roundTripTime);
+
+  const std::vector<Entry>& getEntries() const;
+
+  void addEntry(const Entry& entry) noexcept(false);
+
+  bool isFull() const;
+
+  bool empty() const;
+
+  Serializable::size_type fromBinary(
+      const Serializable::container_type& buffer) noexcept(false);
+
+  Serializable::container_type toBinary() const;
+};
+
+#endif  // LATENCYREPORT_H
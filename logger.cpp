@@ -22,6 +22,10 @@ Logger &Logger::getInstance() {
 }
 
 void Logger::log(const std::string &msg) {
+  if (!enabled) {
+    return;
+  }
+
   {
     std::lock_guard<std::mutex> coutGuard(coutMutex);
     std::cout << msg << std::endl;
@@ -38,3 +42,5 @@ void Logger::log(const std::string &msg) {
     outputSocket->sendTo(buffer, multicastIp, multicastPort);
   }
 }
+
+void Logger::setEnabled(bool enabled) { this->enabled = enabled; }
@@ -4,6 +4,7 @@
 #include "ip4.h"
 #include "socket.h"
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -21,6 +22,7 @@ class Logger {
   std::unique_ptr<Socket> outputSocket;
   std::mutex socketMutex;
   std::mutex coutMutex;
+  std::atomic_bool enabled{true};
 
  private:
   Logger();
@@ -29,6 +31,11 @@ class Logger {
   static Logger& getInstance();
 
   void log(const std::string& msg);
+
+  /**
+   * Disabled logger drops messages, e.g. in simulations of large rings
+   */
+  void setEnabled(bool enabled);
 };
 
 #endif  // LOGGER_H
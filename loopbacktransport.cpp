@@ -0,0 +1,98 @@
+#include "loopbacktransport.h"
+
+bool LoopbackNetwork::deliver(Transport::Frame frame,
+                              const Socket::IpAndPortPair& destination) {
+  LoopbackTransport* transport = find(destination.first, destination.second);
+  if (!transport) {
+    return false;
+  }
+
+  transport->inbox.push_back(std::move(frame));
+  return true;
+}
+
+void LoopbackNetwork::attach(LoopbackTransport& transport) noexcept(false) {
+  EndpointKey key = std::make_pair(transport.getLocalIp().s_addr,
+                                   transport.getLocalPort());
+
+  if (!endpoints.emplace(key, &transport).second) {
+    throw LoopbackNetworkAddressInUseException(
+        "Address " + ::to_string(transport.getLocalIp()) + ":" +
+        std::to_string(transport.getLocalPort()) + " already in use");
+  }
+}
+
+void LoopbackNetwork::detach(LoopbackTransport& transport) {
+  auto it = endpoints.find(std::make_pair(transport.getLocalIp().s_addr,
+                                          transport.getLocalPort()));
+
+  if (it != endpoints.end() && it->second == &transport) {
+    endpoints.erase(it);
+  }
+}
+
+LoopbackTransport* LoopbackNetwork::find(const Ip4& ip,
+                                         unsigned short port) const {
+  auto it = endpoints.find(std::make_pair(ip.s_addr, port));
+  return it != endpoints.end() ? it->second : nullptr;
+}
+
+void LoopbackNetwork::transmit(const Transport::Frame& frame,
+                               const Socket::IpAndPortPair& source) {
+  Transport::Frame receivedFrame;
+  receivedFrame.address = source;
+  receivedFrame.data = frame.data;
+
+  deliver(std::move(receivedFrame), frame.address);
+}
+
+LoopbackTransport::LoopbackTransport(LoopbackNetwork& network, const Ip4& ip,
+                                     unsigned short port)
+    : network(network), localIp(ip), localPort(port) {}
+
+LoopbackTransport::~LoopbackTransport() { close(); }
+
+void LoopbackTransport::open() {
+  network.attach(*this);
+  attached = true;
+}
+
+void LoopbackTransport::close() {
+  if (attached) {
+    network.detach(*this);
+    attached = false;
+  }
+  inbox.clear();
+}
+
+Ip4 LoopbackTransport::getLocalIp() const { return localIp; }
+
+unsigned short LoopbackTransport::getLocalPort() const { return localPort; }
+
+void LoopbackTransport::send(const std::vector<Frame>& frames) noexcept(
+    false) {
+  Socket::IpAndPortPair source = std::make_pair(localIp, localPort);
+
+  for (const Frame& frame : frames) {
+    network.transmit(frame, source);
+  }
+}
+
+size_t LoopbackTransport::receive(std::vector<Frame>& output,
+                                  size_t maxFrames) noexcept(false) {
+  size_t receivedCount = 0;
+
+  while (receivedCount < maxFrames && !inbox.empty()) {
+    output.push_back(std::move(inbox.front()));
+    inbox.pop_front();
+    ++receivedCount;
+  }
+
+  return receivedCount;
+}
+
+int LoopbackTransport::getReadinessDescriptor() const { return -1; }
+
+bool LoopbackTransport::prepareToWait() { return inbox.empty(); }
+
+bool LoopbackTransport::hasPendingFrames() const { return !inbox.empty(); }
@@ -0,0 +1,99 @@
+#ifndef LOOPBACKTRANSPORT_H
+#define LOOPBACKTRANSPORT_H
+
+#include <deque>
+#include <map>
+#include <utility>
+
+#include "ip4.h"
+#include "socket.h"
+#include "transport.h"
+
+using LoopbackNetworkException = TransportException;
+
+using LoopbackNetworkAddressInUseException = LoopbackNetworkException;
+
+class LoopbackTransport;
+
+/**
+ * In-process network of loopback transports. Frames are delivered at once
+ * and in order, frames for unknown addresses are dropped like datagrams.
+ * Derive and override transmit() to model links (latency, loss, ...).
+ *
+ * Not thread safe, all transports have to be driven by one thread.
+ */
+class LoopbackNetwork {
+ private:
+  using EndpointKey = std::pair<in_addr_t, unsigned short>;
+
+  std::map<EndpointKey, LoopbackTransport*> endpoints;
+
+ protected:
+  /**
+   * Puts frame into inbox of transport listening on destination. Returns
+   * false if there is no such transport.
+   */
+  bool deliver(Transport::Frame frame,
+               const Socket::IpAndPortPair& destination);
+
+ public:
+  virtual ~LoopbackNetwork() = default;
+
+  void attach(LoopbackTransport& transport) noexcept(false);
+
+  void detach(LoopbackTransport& transport);
+
+  LoopbackTransport* find(const Ip4& ip, unsigned short port) const;
+
+  /**
+   * Frame address is its destination
+   */
+  virtual void transmit(const Transport::Frame& frame,
+                        const Socket::IpAndPortPair& source);
+};
+
+class LoopbackTransport : public Transport {
+  friend class LoopbackNetwork;
+
+  // Private variables
+ private:
+  LoopbackNetwork& network;
+  Ip4 localIp;
+  unsigned short localPort;
+  bool attached{false};
+
+  std::deque<Frame> inbox;
+
+ public:
+  LoopbackTransport(LoopbackNetwork& network, const Ip4& ip,
+                    unsigned short port);
+
+  LoopbackTransport(const LoopbackTransport&) = delete;
+  LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+  ~LoopbackTransport() override;
+
+  void open() noexcept(false) override;
+
+  /**
+   * Detaches from network, following frames for this address are dropped
+   */
+  void close();
+
+  Ip4 getLocalIp() const override;
+
+  unsigned short getLocalPort() const override;
+
+  void send(const std::vector<Frame>& frames) noexcept(false) override;
+
+  size_t receive(std::vector<Frame>& output,
+                 size_t maxFrames) noexcept(false) override;
+
+  int getReadinessDescriptor() const override;
+
+  bool prepareToWait() override;
+
+  bool hasPendingFrames() const;
+};
+
+#endif  // LOOPBACKTRANSPORT_H
@@ -0,0 +1,185 @@
+#include "lzcodec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+const unsigned HashBits = 12;
+const unsigned char LengthMask = 15;
+
+uint32_t read32(const unsigned char* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+void writeLength(std::vector<unsigned char>& output, size_t length) {
+  length -= LengthMask;
+  while (length >= 255) {
+    output.push_back(255);
+    length -= 255;
+  }
+  output.push_back(static_cast<unsigned char>(length));
+}
+
+size_t readLength(const unsigned char* input, size_t inputSize,
+                  size_t& position) {
+  size_t length = LengthMask;
+  unsigned char byte;
+
+  do {
+    if (position >= inputSize) {
+      throw LZCodecCorruptedInputException("Truncated length in LZ block");
+    }
+    byte = input[position++];
+    length += byte;
+  } while (byte == 255);
+
+  return length;
+}
+
+void writeSequence(std::vector<unsigned char>& output,
+                   const unsigned char* literals, size_t literalsLength,
+                   size_t offset, size_t matchLength) {
+  size_t matchCode = matchLength ? matchLength - LZCodec::MinMatchLength : 0;
+
+  unsigned char token = static_cast<unsigned char>(
+      (std::min<size_t>(literalsLength, LengthMask) << 4) |
+      std::min<size_t>(matchCode, LengthMask));
+  output.push_back(token);
+
+  if (literalsLength >= LengthMask) {
+    writeLength(output, literalsLength);
+  }
+  output.insert(output.end(), literals, literals + literalsLength);
+
+  if (matchLength == 0) {
+    return;
+  }
+
+  output.push_back(static_cast<unsigned char>(offset & 0xff));
+  output.push_back(static_cast<unsigned char>(offset >> 8));
+
+  if (matchCode >= LengthMask) {
+    writeLength(output, matchCode);
+  }
+}
+}  // namespace
+
+bool LZCodec::compress(const std::vector<unsigned char>& input,
+                       std::vector<unsigned char>& output,
+                       size_t maxOutputSize) {
+  const size_t limit = std::min(input.size(), maxOutputSize + 1);
+  const unsigned char* data = input.data();
+
+  std::array<int32_t, 1u << HashBits> positions;
+  positions.fill(-1);
+
+  output.clear();
+  output.reserve(limit);
+
+  size_t anchor = 0;
+  size_t position = 0;
+
+  while (position + MinMatchLength <= input.size()) {
+    uint32_t sequence = read32(data + position);
+    uint32_t slot = hash(sequence);
+    int32_t candidate = positions[slot];
+    positions[slot] = static_cast<int32_t>(position);
+
+    if (candidate < 0 || position - candidate > MaxMatchOffset ||
+        read32(data + candidate) != sequence) {
+      ++position;
+      continue;
+    }
+
+    size_t matchLength = MinMatchLength;
+    while (position + matchLength < input.size() &&
+           data[candidate + matchLength] == data[position + matchLength]) {
+      ++matchLength;
+    }
+
+    writeSequence(output, data + anchor, position - anchor,
+                  position - candidate, matchLength);
+
+    position += matchLength;
+    anchor = position;
+
+    if (output.size() >= limit) {
+      return false;
+    }
+  }
+
+  writeSequence(output, data + anchor, input.size() - anchor, 0, 0);
+
+  return output.size() < input.size() && output.size() <= maxOutputSize;
+}
+
+std::vector<unsigned char> LZCodec::decompress(
+    const std::vector<unsigned char>& input,
+    size_t maxOutputSize) noexcept(false) {
+  std::vector<unsigned char> output;
+  decompress(input.data(), input.size(), output, maxOutputSize);
+  return output;
+}
+
+void LZCodec::decompress(const unsigned char* input, size_t inputSize,
+                         std::vector<unsigned char>& output,
+                         size_t maxOutputSize) noexcept(false) {
+  output.clear();
+  size_t position = 0;
+
+  while (position < inputSize) {
+    unsigned char token = input[position++];
+
+    size_t literalsLength = token >> 4;
+    if (literalsLength == LengthMask) {
+      literalsLength = readLength(input, inputSize, position);
+    }
+
+    if (literalsLength > inputSize - position ||
+        literalsLength > maxOutputSize - output.size()) {
+      throw LZCodecCorruptedInputException("Literals run out of LZ block");
+    }
+    output.insert(output.end(), input + position,
+                  input + position + literalsLength);
+    position += literalsLength;
+
+    // Last sequence has no match
+    if (position == inputSize) {
+      break;
+    }
+
+    if (inputSize - position < 2) {
+      throw LZCodecCorruptedInputException("Truncated offset in LZ block");
+    }
+    size_t offset = input[position] | (input[position + 1] << 8);
+    position += 2;
+
+    if (offset == 0 || offset > output.size()) {
+      throw LZCodecCorruptedInputException("Invalid offset in LZ block");
+    }
+
+    size_t matchLength = token & LengthMask;
+    if (matchLength == LengthMask) {
+      matchLength = readLength(input, inputSize, position);
+    }
+    matchLength += MinMatchLength;
+
+    if (matchLength > maxOutputSize - output.size()) {
+      throw LZCodecCorruptedInputException("LZ block decompresses too big");
+    }
+
+    // Match may overlap bytes it produces, copied byte by byte
+    size_t source = output.size() - offset;
+    for (size_t i = 0; i < matchLength; ++i) {
+      unsigned char byte = output[source + i];
+      output.push_back(byte);
+    }
+  }
+}
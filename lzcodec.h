@@ -0,0 +1,51 @@
+#ifndef LZCODEC_H
+#define LZCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using LZCodecException = std::runtime_error;
+
+using LZCodecCorruptedInputException = LZCodecException;
+
+/**
+ * Small LZ77 compressor for frame payloads, LZ4 block like format.
+ *
+ * Block is a list of sequences. Sequence starts with token byte: high nibble
+ * is literals length, low nibble is match length - 4 (15 means more length
+ * bytes follow, each 255 adds up). Literals follow, then 2 byte little
+ * endian match offset. Last sequence has literals only.
+ */
+class LZCodec {
+ public:
+  static const size_t MinMatchLength = 4;
+  static const size_t MaxMatchOffset = 65535;
+
+  /**
+   * Compresses input into output. Returns false (output is undefined) when
+   * compressed block would not be smaller than input or than
+   * maxOutputSize.
+   */
+  static bool compress(const std::vector<unsigned char>& input,
+                       std::vector<unsigned char>& output,
+                       size_t maxOutputSize);
+
+  /**
+   * Throws when block is corrupted or decompresses to more than
+   * maxOutputSize bytes.
+   */
+  static std::vector<unsigned char> decompress(
+      const std::vector<unsigned char>& input,
+      size_t maxOutputSize) noexcept(false);
+
+  /**
+   * Decompresses into output, its capacity is reused
+   */
+  static void decompress(const unsigned char* input, size_t inputSize,
+                         std::vector<unsigned char>& output,
+                         size_t maxOutputSize) noexcept(false);
+};
+
+#endif  // LZCODEC_H
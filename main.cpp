@@ -4,12 +4,15 @@
 #include <csignal>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 #include "programarguments.h"
 #include "quitstatusobserver.h"
 #include "socket.h"
+#include "tcptransport.h"
 #include "tokenringpacket.h"
-#include "tokenringudpservice.h"
+#include "tokenringservice.h"
+#include "udptransport.h"
 
 using namespace std;
 
@@ -35,19 +38,57 @@ int main(int argc, char *argv[]) {
             << "NeighborIp: " << to_string(args.getNeighborIp()) << std::endl
             << "NeighborPort: " << args.getNeighborPort() << std::endl
             << "HasToken: " << std::boolalpha << args.getHasToken() << std::endl
-            << "Protocol: " << protocolString << std::endl;
+            << "Protocol: " << protocolString << std::endl
+            << "Topology hosts: " << args.getTopology().getHosts().size()
+            << std::endl
+            << "Lanes: " << args.getLanesCount() << std::endl;
 
   // Register quit handler
+  QuitStatusObserver::getInstance();
   std::signal(SIGINT, quitStatusObserverHandler);
 
   // Ignore SIGPIPE
   //  std::signal(SIGPIPE, SIG_IGN);
 
-  if (args.getProtocol() == Protocol::UDP) {
-    TokenRingUDPService dispatcher{args};
-    dispatcher.run();
-  } else {
-    std::cout << "UNSUPPORTED PROTOCOL" << std::endl;
+  // Every lane is separate ring with own token, ports and thread
+  std::vector<std::unique_ptr<TokenRingService>> lanes;
+  // Referenced by transports, reserved so they are not moved
+  std::vector<ProgramArguments> lanesArgs;
+  lanesArgs.reserve(args.getLanesCount());
+
+  try {
+    for (size_t lane = 0; lane < args.getLanesCount(); ++lane) {
+      lanesArgs.push_back(args.forLane(lane));
+      const ProgramArguments &laneArgs = lanesArgs.back();
+      std::unique_ptr<Transport> transport;
+
+      if (laneArgs.getProtocol() == Protocol::UDP) {
+        transport = std::make_unique<UDPTransport>(laneArgs);
+      } else if (laneArgs.getProtocol() == Protocol::TCP) {
+        transport = std::make_unique<TCPTransport>(laneArgs);
+      } else {
+        std::cout << "UNSUPPORTED PROTOCOL" << std::endl;
+        return 1;
+      }
+
+      lanes.push_back(
+          std::make_unique<TokenRingService>(laneArgs, std::move(transport)));
+    }
+  } catch (const ProgramArgumentsException &ex) {
+    std::cerr << "Program exception: " << ex.what() << std::endl
+              << "Terminating" << std::endl;
+    std::exit(1);
+  }
+
+  std::vector<std::thread> laneThreads;
+  for (size_t lane = 1; lane < lanes.size(); ++lane) {
+    laneThreads.emplace_back(&TokenRingService::run, lanes[lane].get());
+  }
+
+  lanes.front()->run();
+
+  for (std::thread &laneThread : laneThreads) {
+    laneThread.join();
   }
 
   return 0;
@@ -0,0 +1,81 @@
+#include "membershipupdate.h"
+#include "utility.h"
+
+#include <cstring>
+
+MembershipUpdate::MembershipUpdate(
+    const Serializable::container_type &sourceBuffer) noexcept(false) {
+  fromBinary(sourceBuffer);
+}
+
+MembershipUpdate::Entry MembershipUpdate::createEntry(
+    Action action, const std::string &hostName,
+    const std::string &repointHostName, const Ip4 &ip, unsigned short port) {
+  Entry entry{};
+  entry.action = action;
+  insertStringToCharArrayWithLength(hostName, entry.hostName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(repointHostName, entry.repointHostName,
+                                    TokenRingPacket::NameMaxSize);
+  entry.ip = ip;
+  entry.port = port;
+  return entry;
+}
+
+MembershipUpdate::Epoch_t MembershipUpdate::getEpoch() const { return epoch; }
+
+void MembershipUpdate::setEpoch(Epoch_t value) { epoch = value; }
+
+const std::vector<MembershipUpdate::Entry> &MembershipUpdate::getEntries()
+    const {
+  return entries;
+}
+
+void MembershipUpdate::addEntry(const Entry &entry) noexcept(false) {
+  if (isFull()) {
+    throw MembershipUpdateTooManyEntriesException(
+        "Membership update can hold at most MaxEntries entries");
+  }
+  entries.push_back(entry);
+}
+
+bool MembershipUpdate::isFull() const { return entries.size() >= MaxEntries; }
+
+Serializable::size_type MembershipUpdate::fromBinary(
+    const Serializable::container_type &buffer) noexcept(false) {
+  BatchHeader batchHeader;
+
+  if (buffer.size() < sizeof(batchHeader)) {
+    throw MembershipUpdateInputBufferTooSmallException(
+        "Passed input buffer is too small");
+  }
+
+  std::memcpy(&batchHeader, buffer.data(), sizeof(batchHeader));
+
+  size_t entriesSize = batchHeader.entriesCount * sizeof(Entry);
+  if (buffer.size() - sizeof(batchHeader) < entriesSize) {
+    throw MembershipUpdateInputBufferTooSmallException(
+        "Passed input buffer contains less entries than declared");
+  }
+
+  epoch = batchHeader.epoch;
+  entries.resize(batchHeader.entriesCount);
+  std::memcpy(entries.data(), buffer.data() + sizeof(batchHeader),
+              entriesSize);
+
+  return sizeof(batchHeader) + entriesSize;
+}
+
+Serializable::container_type MembershipUpdate::toBinary() const {
+  BatchHeader batchHeader;
+  batchHeader.epoch = epoch;
+  batchHeader.entriesCount = static_cast<uint16_t>(entries.size());
+
+  Serializable::container_type buffer(sizeof(batchHeader) +
+                                      entries.size() * sizeof(Entry));
+  std::memcpy(buffer.data(), &batchHeader, sizeof(batchHeader));
+  std::memcpy(buffer.data() + sizeof(batchHeader), entries.data(),
+              entries.size() * sizeof(Entry));
+
+  return buffer;
+}
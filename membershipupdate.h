@@ -0,0 +1,98 @@
+#ifndef MEMBERSHIPUPDATE_H
+#define MEMBERSHIPUPDATE_H
+
+#include <cstdint>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ip4.h"
+#include "serializable.h"
+#include "tokenringpacket.h"
+
+using MembershipUpdateException = std::runtime_error;
+
+using MembershipUpdateInputBufferTooSmallException = MembershipUpdateException;
+
+using MembershipUpdateTooManyEntriesException = MembershipUpdateException;
+
+/**
+ * Payload of REGISTER packet. Carries batch of ring membership changes made
+ * by one host (packet originalSenderName) stamped with membership epoch.
+ */
+class MembershipUpdate : public Serializable {
+ public:
+  enum class Action : uint8_t {
+    NONE = 0u,
+    ADD,     /// Host joined ring
+    REMOVE,  /// Host left ring or was bypassed
+    MOVE,    /// Host follows repointHostName in new ring order. Change is
+             /// staged until COMMIT
+    COMMIT,  /// Staged ring order is taken once this update is passed on
+
+    ACTION_NUM  /// Number of actions. DO NOT USE AS ACTION!!!
+  };
+
+#pragma pack(push, 1)
+  struct Entry {
+    Action action;
+
+    char hostName[TokenRingPacket::NameMaxSize];
+
+    // Host that has to connect to ip and port (set its next host)
+    char repointHostName[TokenRingPacket::NameMaxSize];
+
+    Ip4 ip;
+
+    unsigned short port;
+  };
+#pragma pack(pop)
+
+  using Epoch_t = uint32_t;
+
+ private:
+#pragma pack(push, 1)
+  struct BatchHeader {
+    Epoch_t epoch;
+    uint16_t entriesCount;
+  };
+#pragma pack(pop)
+
+ public:
+  static const size_t MaxEntries =
+      (TokenRingPacket::DataMaxSize - sizeof(BatchHeader)) / sizeof(Entry);
+
+ private:
+  Epoch_t epoch{0};
+  std::vector<Entry> entries;
+
+ public:
+  MembershipUpdate() = default;
+
+  explicit MembershipUpdate(
+      const Serializable::container_type& sourceBuffer) noexcept(false);
+
+  virtual ~MembershipUpdate() = default;
+
+  static Entry createEntry(Action action, const std::string& hostName,
+                           const std::string& repointHostName, const Ip4& ip,
+                           unsigned short port);
+
+  Epoch_t getEpoch() const;
+
+  void setEpoch(Epoch_t value);
+
+  const std::vector<Entry>& getEntries() const;
+
+  void addEntry(const Entry& entry) noexcept(false);
+
+  bool isFull() const;
+
+  Serializable::size_type fromBinary(
+      const Serializable::container_type& buffer) noexcept(false);
+
+  Serializable::container_type toBinary() const;
+};
+
+#endif  // MEMBERSHIPUPDATE_H
@@ -0,0 +1,85 @@
+#include "messagering.h"
+
+#include <cstring>
+
+#include "utility.h"
+
+namespace {
+std::string ringName(const std::string& name) {
+  return "sr_tokenring_messages_" + name;
+}
+}  // namespace
+
+MessageRing::MessageRing(std::unique_ptr<SharedMemoryRing> ring)
+    : ring(std::move(ring)) {}
+
+std::unique_ptr<MessageRing> MessageRing::create(
+    const std::string& name) noexcept(false) {
+  return std::unique_ptr<MessageRing>(
+      new MessageRing(SharedMemoryRing::create(ringName(name))));
+}
+
+std::unique_ptr<MessageRing> MessageRing::attach(const std::string& name) {
+  std::unique_ptr<SharedMemoryRing> ring =
+      SharedMemoryRing::attach(ringName(name));
+
+  if (!ring) {
+    return nullptr;
+  }
+
+  return std::unique_ptr<MessageRing>(new MessageRing(std::move(ring)));
+}
+
+bool MessageRing::push(const TokenRingEngine::ReceivedMessage& message) {
+  RecordHeader header{};
+  header.messageId = message.messageId;
+  insertStringToCharArrayWithLength(message.senderName, header.senderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(message.receiverName, header.receiverName,
+                                    TokenRingPacket::NameMaxSize);
+
+  return ring->push(&header, sizeof(header), message.data, message.size);
+}
+
+int MessageRing::getSpaceWakeupDescriptor() const {
+  return ring->getSpaceWakeupDescriptor();
+}
+
+bool MessageRing::prepareToWaitForSpace(
+    const TokenRingEngine::ReceivedMessage& message) {
+  return ring->prepareToWaitForSpace(sizeof(RecordHeader) + message.size);
+}
+
+void MessageRing::finishWaitForSpace() { ring->finishWaitForSpace(); }
+
+bool MessageRing::pop(Message& message) {
+  do {
+    if (!ring->pop(record)) {
+      return false;
+    }
+    // Records that are too short are not ours, skipped
+  } while (record.size() < sizeof(RecordHeader));
+
+  RecordHeader header;
+  std::memcpy(&header, record.data(), sizeof(header));
+
+  message.senderName = maybeNonterminatedCharArrayToString(
+      header.senderName, TokenRingPacket::NameMaxSize);
+  message.receiverName = maybeNonterminatedCharArrayToString(
+      header.receiverName, TokenRingPacket::NameMaxSize);
+  message.messageId = header.messageId;
+  message.data = record.data() + sizeof(header);
+  message.size = record.size() - sizeof(header);
+
+  return true;
+}
+
+int MessageRing::getWakeupDescriptor() const {
+  return ring->getWakeupDescriptor();
+}
+
+bool MessageRing::prepareToSleep() { return ring->prepareToSleep(); }
+
+void MessageRing::finishSleep() { ring->finishSleep(); }
+
+bool MessageRing::isClosed() const { return ring->isClosed(); }
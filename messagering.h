@@ -0,0 +1,96 @@
+#ifndef MESSAGERING_H
+#define MESSAGERING_H
+
+#include <memory>
+#include <string>
+
+#include "serializable.h"
+#include "sharedmemoryring.h"
+#include "tokenringengine.h"
+#include "tokenringpacket.h"
+
+/**
+ * Hands messages delivered to host over to application running in another
+ * process, through shared memory ring.
+ *
+ * Application creates ring with chosen name and host started with
+ * `--deliver-to <name>` attaches to it. Each message is copied once, from
+ * received frame into shared memory.
+ */
+class MessageRing {
+ public:
+  /**
+   * Message taken from ring. Data is valid until next pop().
+   */
+  struct Message {
+    std::string senderName;
+    std::string receiverName;
+    TokenRingPacket::MessageId_t messageId;
+    const unsigned char* data;
+    size_t size;
+  };
+
+ private:
+#pragma pack(push, 1)
+  struct RecordHeader {
+    TokenRingPacket::MessageId_t messageId;
+    char senderName[TokenRingPacket::NameMaxSize];
+    char receiverName[TokenRingPacket::NameMaxSize];
+  };
+#pragma pack(pop)
+
+  std::unique_ptr<SharedMemoryRing> ring;
+
+  // Reused by pop()
+  Serializable::container_type record;
+
+  explicit MessageRing(std::unique_ptr<SharedMemoryRing> ring);
+
+ public:
+  /**
+   * Application side. Creates (or replaces stale) ring.
+   */
+  static std::unique_ptr<MessageRing> create(const std::string& name) noexcept(
+      false);
+
+  /**
+   * Host side. Returns nullptr if there is no ring or it is already fed by
+   * another live host.
+   */
+  static std::unique_ptr<MessageRing> attach(const std::string& name);
+
+  /**
+   * Host side. Returns false if message does not fit.
+   */
+  bool push(const TokenRingEngine::ReceivedMessage& message);
+
+  /**
+   * Host side. Waiting until message fits is the same as on SharedMemoryRing.
+   */
+  int getSpaceWakeupDescriptor() const;
+
+  bool prepareToWaitForSpace(const TokenRingEngine::ReceivedMessage& message);
+
+  void finishWaitForSpace();
+
+  /**
+   * Application side. Returns false if ring is empty.
+   */
+  bool pop(Message& message);
+
+  /**
+   * Application side. Sleeping is the same as on SharedMemoryRing.
+   */
+  int getWakeupDescriptor() const;
+
+  bool prepareToSleep();
+
+  void finishSleep();
+
+  /**
+   * Host side. True if application went away.
+   */
+  bool isClosed() const;
+};
+
+#endif  // MESSAGERING_H
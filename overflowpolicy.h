@@ -0,0 +1,14 @@
+#ifndef OVERFLOWPOLICY_H
+#define OVERFLOWPOLICY_H
+
+/**
+ * What happens to message delivered to consumer whose queue is full. Queued
+ * messages were reported delivered to their senders, so none is dropped to
+ * make room.
+ */
+enum class OverflowPolicy : unsigned int {
+  REJECT = 0u,  /// Receiver is busy, sender sends message again
+  DROP_NEWEST,  /// Message is not copied, its sender gets NOT_COPIED
+};
+
+#endif  // OVERFLOWPOLICY_H
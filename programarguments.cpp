@@ -1,8 +1,29 @@
 #include "programarguments.h"
+#include "tokenringpacket.h"
 
 #include <algorithm>
 #include <limits>
 
+namespace {
+// Every lane runs its own thread
+const int MaxLanesCount = 16;
+
+bool parseBoolean(std::string input, bool &value) {
+  std::transform(input.begin(), input.end(), input.begin(), ::tolower);
+  if (input == "true" || input == "t" || input == "y" || input == "yes" ||
+      input == "on" || input == "1") {
+    value = true;
+  } else if (input == "false" || input == "f" || input == "n" ||
+             input == "no" || input == "off" || input == "0") {
+    value = false;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+}  // namespace
+
 ProgramArguments::ProgramArguments(std::vector<const char *> arguments,
                                    bool shouldParse) noexcept(false)
     : arguments(arguments) {
@@ -57,21 +78,9 @@ void ProgramArguments::parseNeighborPort(const std::string &input) {
 }
 
 void ProgramArguments::parseTokenStatus(const std::string &input) {
-  std::string tokenStatusStr = input;
-
-  std::transform(tokenStatusStr.begin(), tokenStatusStr.end(),
-                 tokenStatusStr.begin(), ::tolower);
-  if (tokenStatusStr == "true" || tokenStatusStr == "t" ||
-      tokenStatusStr == "y" || tokenStatusStr == "yes" ||
-      tokenStatusStr == "1") {
-    hasToken = true;
-  } else if (tokenStatusStr == "false" || tokenStatusStr == "f" ||
-             tokenStatusStr == "n" || tokenStatusStr == "no" ||
-             tokenStatusStr == "0") {
-    hasToken = false;
-  } else {
+  if (!parseBoolean(input, hasToken)) {
     throw ProgramArgumentsInvalidTokenStatusException(
-        "Invalid token status passed `" + tokenStatusStr + "\'");
+        "Invalid token status passed `" + input + "\'");
   }
 }
 
@@ -89,23 +98,270 @@ void ProgramArguments::parseProtocol(const std::string &input) {
   }
 }
 
+void ProgramArguments::parseOption(const std::string &name,
+                                   const std::string &value) {
+  if (name == "topology") {
+    topologyPath = value;
+  } else if (name == "hierarchy") {
+    hierarchyPath = value;
+  } else if (name == "shared-memory") {
+    if (!parseBoolean(value, sharedMemory)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "bind") {
+    parseBindAddress(value);
+  } else if (name == "advertise") {
+    try {
+      advertisedIp = Ip4_from_string(value);
+      advertisedIpSet = true;
+    } catch (const Ip4InvalidInputException &ex) {
+      throw ProgramArgumentsInvalidBindAddressException(ex.what());
+    }
+  } else if (name == "reuseport") {
+    if (!parseBoolean(value, reusePort)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "rcvbuf") {
+    socketOptions.receiveBufferSize =
+        parseNumericOption(name, value, std::numeric_limits<int>::max() / 2);
+  } else if (name == "sndbuf") {
+    socketOptions.sendBufferSize =
+        parseNumericOption(name, value, std::numeric_limits<int>::max() / 2);
+  } else if (name == "dscp") {
+    socketOptions.dscp = parseNumericOption(name, value, 63);
+  } else if (name == "busy-poll") {
+    socketOptions.busyPollTime =
+        parseNumericOption(name, value, std::numeric_limits<int>::max());
+  } else if (name == "rx-timestamps") {
+    if (!parseBoolean(value, socketOptions.receiveTimestamps)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "non-blocking") {
+    if (!parseBoolean(value, socketOptions.nonBlocking)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "dual-ring") {
+    if (!parseBoolean(value, dualRing)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "lanes") {
+    lanesCount =
+        static_cast<size_t>(parseNumericOption(name, value, MaxLanesCount));
+    if (lanesCount == 0) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "lane-port-step") {
+    lanePortStep = static_cast<unsigned short>(parseNumericOption(
+        name, value, std::numeric_limits<unsigned short>::max()));
+    if (lanePortStep == 0) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "reorder-ms") {
+    reorderInterval = static_cast<unsigned int>(
+        parseNumericOption(name, value, std::numeric_limits<int>::max()));
+  } else if (name == "compress") {
+    if (!parseBoolean(value, compression)) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "direct-threshold") {
+    // Smaller messages go with token, they have to fit into frame
+    directTransferThreshold = static_cast<size_t>(parseNumericOption(
+        name, value, static_cast<int>(TokenRingPacket::DataMaxSize)));
+  } else if (name == "deliver-to") {
+    messageRingName = value;
+  } else if (name == "delivery-workers") {
+    deliveryWorkersCount =
+        static_cast<size_t>(parseNumericOption(name, value, 256));
+  } else if (name == "delivery-queue") {
+    deliveryQueueCapacity = static_cast<size_t>(
+        parseNumericOption(name, value, std::numeric_limits<int>::max()));
+    if (deliveryQueueCapacity == 0) {
+      throw ProgramArgumentsInvalidOptionException(
+          "Invalid value of option `--" + name + "' passed `" + value + "'");
+    }
+  } else if (name == "delivery-overflow") {
+    parseOverflowPolicy(value);
+  } else {
+    throw ProgramArgumentsInvalidOptionException("Unknown option `--" + name +
+                                                 "'");
+  }
+}
+
+int ProgramArguments::parseNumericOption(const std::string &name,
+                                         const std::string &value,
+                                         int maxValue) {
+  long long number = -1;
+
+  try {
+    size_t parsed = 0;
+    number = std::stoll(value, &parsed);
+    if (parsed != value.size()) {
+      number = -1;
+    }
+  } catch (const std::logic_error &) {
+  }
+
+  if (number < 0 || number > maxValue) {
+    throw ProgramArgumentsInvalidOptionException(
+        "Invalid value of option `--" + name + "' passed `" + value + "'");
+  }
+
+  return static_cast<int>(number);
+}
+
+void ProgramArguments::parseBindAddress(const std::string &input) {
+  try {
+    bindIp = Ip4_from_string(input);
+  } catch (const Ip4InvalidInputException &) {
+    try {
+      bindIp = Ip4_from_interface(input);
+    } catch (const Ip4InvalidInputException &ex) {
+      throw ProgramArgumentsInvalidBindAddressException(
+          "Invalid bind address passed `" + input + "': " + ex.what());
+    }
+  }
+
+  bindIpSet = true;
+}
+
+void ProgramArguments::parseOverflowPolicy(const std::string &input) {
+  std::string policy = input;
+  std::transform(policy.begin(), policy.end(), policy.begin(), ::tolower);
+
+  if (policy == "reject") {
+    deliveryOverflowPolicy = OverflowPolicy::REJECT;
+  } else if (policy == "drop-newest") {
+    deliveryOverflowPolicy = OverflowPolicy::DROP_NEWEST;
+  } else {
+    throw ProgramArgumentsInvalidOptionException(
+        "Invalid value of option `--delivery-overflow' passed `" + input +
+        "'");
+  }
+}
+
+std::vector<const char *> ProgramArguments::parseOptions() {
+  std::vector<const char *> positionalArguments;
+
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    std::string argument = arguments[i];
+
+    if (argument.compare(0, 2, "--") != 0) {
+      positionalArguments.push_back(arguments[i]);
+      continue;
+    }
+
+    if (i + 1 >= arguments.size()) {
+      throw ProgramArgumentsInvalidOptionException("Option `" + argument +
+                                                   "' requires value");
+    }
+
+    parseOption(argument.substr(2), arguments[++i]);
+  }
+
+  return positionalArguments;
+}
+
+void ProgramArguments::parseTopology(const std::string &path) {
+  try {
+    topology = Topology::fromFile(path);
+  } catch (const TopologyException &ex) {
+    throw ProgramArgumentsInvalidTopologyException(ex.what());
+  }
+
+  useTopology(path);
+}
+
+void ProgramArguments::parseHierarchy(const std::string &path) {
+  try {
+    hierarchy = RingHierarchy::fromFile(path);
+  } catch (const TopologyException &ex) {
+    throw ProgramArgumentsInvalidTopologyException(ex.what());
+  }
+
+  if (!hierarchy.contains(userIdentifier)) {
+    throw ProgramArgumentsInvalidTopologyException(
+        "User `" + userIdentifier + "' is not part of hierarchy `" + path +
+        "'");
+  }
+
+  topology = hierarchy.getRing(hierarchy.getLocalRingOf(userIdentifier));
+
+  useTopology(path);
+}
+
+void ProgramArguments::useTopology(const std::string &path) {
+  if (!topology.contains(userIdentifier)) {
+    throw ProgramArgumentsInvalidTopologyException(
+        "User `" + userIdentifier + "' is not part of topology `" + path +
+        "'");
+  }
+
+  const Topology::Host &self = topology.getHost(userIdentifier);
+  const Topology::Host &next = topology.nextHostOf(userIdentifier);
+
+  port = self.port;
+  if (!bindIpSet) {
+    bindIp = self.ip;
+  }
+  neighborIp = next.ip;
+  neighborPort = next.port;
+  hasToken = topology.getHosts().front().name == userIdentifier;
+}
+
 void ProgramArguments::parse() {
-  if (arguments.size() < 6) {
+  std::vector<const char *> positionalArguments = parseOptions();
+
+  if (!topologyPath.empty() && !hierarchyPath.empty()) {
+    throw ProgramArgumentsInvalidTopologyException(
+        "Options `--topology' and `--hierarchy' exclude each other");
+  }
+
+  if (!topologyPath.empty() || !hierarchyPath.empty()) {
+    if (positionalArguments.size() < 2) {
+      throw ProgramArgumentsNotEnoughArgumentsException(
+          "Not enough arguments passed");
+    }
+
+    userIdentifier = positionalArguments[0];
+
+    parseProtocol(positionalArguments[1]);
+
+    if (!topologyPath.empty()) {
+      parseTopology(topologyPath);
+    } else {
+      parseHierarchy(hierarchyPath);
+    }
+
+    inputParsed = true;
+    return;
+  }
+
+  if (positionalArguments.size() < 6) {
     throw ProgramArgumentsNotEnoughArgumentsException(
         "Not enough arguments passed");
   }
 
-  userIdentifier = arguments[0];
+  userIdentifier = positionalArguments[0];
 
-  parseUserPort(arguments[1]);
+  parseUserPort(positionalArguments[1]);
 
-  parseNeighborIp(arguments[2]);
+  parseNeighborIp(positionalArguments[2]);
 
-  parseNeighborPort(arguments[3]);
+  parseNeighborPort(positionalArguments[3]);
 
-  parseTokenStatus(arguments[4]);
+  parseTokenStatus(positionalArguments[4]);
 
-  parseProtocol(arguments[5]);
+  parseProtocol(positionalArguments[5]);
+
+  inputParsed = true;
 }
 
 std::string ProgramArguments::getUserIdentifier() const {
@@ -124,6 +380,106 @@ bool ProgramArguments::getHasToken() const { return hasToken; }
 
 Protocol ProgramArguments::getProtocol() const { return protocol; }
 
+bool ProgramArguments::hasTopology() const { return !topology.empty(); }
+
+bool ProgramArguments::useSharedMemory() const { return sharedMemory; }
+
+Ip4 ProgramArguments::getBindIp() const {
+  if (bindIpSet || hasTopology()) {
+    return bindIp;
+  }
+
+  return Ip4_from_string("127.0.0.1");
+}
+
+bool ProgramArguments::hasAdvertisedIp() const { return advertisedIpSet; }
+
+Ip4 ProgramArguments::getAdvertisedIp() const { return advertisedIp; }
+
+bool ProgramArguments::useReusePort() const { return reusePort; }
+
+const SocketOptions &ProgramArguments::getSocketOptions() const {
+  return socketOptions;
+}
+
+bool ProgramArguments::useCompression() const { return compression; }
+
+bool ProgramArguments::useDualRing() const { return dualRing; }
+
+size_t ProgramArguments::getLanesCount() const { return lanesCount; }
+
+size_t ProgramArguments::getLane() const { return lane; }
+
+ProgramArguments ProgramArguments::forLane(size_t lane) const
+    noexcept(false) {
+  if (lane >= lanesCount) {
+    throw ProgramArgumentsInvalidOptionException(
+        "There is no lane " + std::to_string(lane));
+  }
+
+  ProgramArguments laneArguments = *this;
+  laneArguments.lane = lane;
+  if (lane == 0) {
+    return laneArguments;
+  }
+
+  size_t offset = lane * lanePortStep;
+  if (port > 65535u - offset || neighborPort > 65535u - offset) {
+    throw ProgramArgumentsInvalidPortNumberException(
+        "Port of lane " + std::to_string(lane) + " is out of range");
+  }
+  laneArguments.port = static_cast<unsigned short>(port + offset);
+  laneArguments.neighborPort =
+      static_cast<unsigned short>(neighborPort + offset);
+
+  try {
+    laneArguments.topology =
+        topology.withPortOffset(static_cast<unsigned short>(offset));
+    laneArguments.hierarchy =
+        hierarchy.withPortOffset(static_cast<unsigned short>(offset));
+  } catch (const TopologyException &ex) {
+    throw ProgramArgumentsInvalidPortNumberException(ex.what());
+  }
+
+  if (!messageRingName.empty()) {
+    laneArguments.messageRingName += "." + std::to_string(lane);
+  }
+
+  return laneArguments;
+}
+
+unsigned int ProgramArguments::getReorderInterval() const {
+  return reorderInterval;
+}
+
+size_t ProgramArguments::getDirectTransferThreshold() const {
+  return directTransferThreshold;
+}
+
+const std::string &ProgramArguments::getMessageRingName() const {
+  return messageRingName;
+}
+
+size_t ProgramArguments::getDeliveryWorkersCount() const {
+  return deliveryWorkersCount;
+}
+
+size_t ProgramArguments::getDeliveryQueueCapacity() const {
+  return deliveryQueueCapacity;
+}
+
+OverflowPolicy ProgramArguments::getDeliveryOverflowPolicy() const {
+  return deliveryOverflowPolicy;
+}
+
+const Topology &ProgramArguments::getTopology() const { return topology; }
+
+bool ProgramArguments::hasHierarchy() const { return !hierarchy.empty(); }
+
+const RingHierarchy &ProgramArguments::getHierarchy() const {
+  return hierarchy;
+}
+
 std::vector<const char *> ProgramArguments::getArguments() const {
   return arguments;
 }
@@ -6,7 +6,11 @@
 #include <vector>
 
 #include "ip4.h"
+#include "overflowpolicy.h"
 #include "protocol.h"
+#include "ringhierarchy.h"
+#include "socket.h"
+#include "topology.h"
 
 /* Exceptions */
 
@@ -23,8 +27,59 @@ using ProgramArgumentsInvalidTokenStatusException = ProgramArgumentsException;
 
 using ProgramArgumentsInvalidProtocolException = ProgramArgumentsException;
 
+using ProgramArgumentsInvalidOptionException = ProgramArgumentsException;
+
+using ProgramArgumentsInvalidTopologyException = ProgramArgumentsException;
+
+using ProgramArgumentsInvalidBindAddressException = ProgramArgumentsException;
+
 /* Class declaration */
 
+/**
+ * Usage:
+ *   <user id> <port> <neighbor ip> <neighbor port> <has token> <protocol>
+ *   <user id> <protocol> --topology <file>
+ *   <user id> <protocol> --hierarchy <file>
+ *
+ * Options (`--name value`) may be placed anywhere:
+ *   --topology <file>        static ring description
+ *   --hierarchy <file>       ring of rings description (see RingHierarchy),
+ *                            host runs its local ring, bridge backbone too
+ *   --shared-memory <on|off> shared memory path to co-located next host (UDP)
+ *   --dual-ring <on|off>     second, counter-rotating ring over topology
+ *   --lanes <n>              parallel rings with own tokens (default 1)
+ *   --lane-port-step <n>     lane n uses ports moved by n times step
+ *                            (default 100)
+ *   --reorder-ms <ms>        ring coordinator reorders ring by measured
+ *                            latencies this often, every host needs it
+ *                            (default 0, off)
+ *   --bind <ip|interface>    local address (default: topology address or
+ *                            127.0.0.1), 0.0.0.0 listens on all interfaces
+ *   --advertise <ip>         address other hosts send to (default: bind
+ *                            address or route source to neighbor)
+ *   --reuseport <on|off>     SO_REUSEPORT on listening socket
+ *   --rcvbuf <bytes>         SO_RCVBUF of receiving sockets
+ *   --sndbuf <bytes>         SO_SNDBUF of sending sockets
+ *   --dscp <0-63>            DiffServ code point of sent packets
+ *   --busy-poll <us>         SO_BUSY_POLL of receiving sockets
+ *   --rx-timestamps <on|off> kernel receive timestamps (UDP), taken as
+ *                            arrival time of probes
+ *   --non-blocking <on|off>  O_NONBLOCK on receiving sockets
+ *   --compress <on|off>      compress greeting payloads
+ *   --direct-threshold <bytes>
+ *                            larger messages are sent straight to receiver,
+ *                            only announced on ring (default 256, at
+ *                            most 512)
+ *   --deliver-to <name>      hand delivered messages to application over
+ *                            shared memory ring (see MessageRing), lane n
+ *                            above 0 delivers to `<name>.<n>`
+ *   --delivery-workers <n>   threads handing messages over (default 1), 0
+ *                            does it on ring thread
+ *   --delivery-queue <n>     messages waiting for application (default 1024)
+ *   --delivery-overflow <reject|drop-newest>
+ *                            when delivery queue is full, sender is told
+ *                            receiver is busy or message was not copied
+ */
 class ProgramArguments {
  private:
   std::string userIdentifier;
@@ -34,6 +89,40 @@ class ProgramArguments {
   bool hasToken = false;
   Protocol protocol = Protocol::NONE;
 
+  std::string topologyPath;
+  Topology topology;
+
+  std::string hierarchyPath;
+  RingHierarchy hierarchy;
+
+  bool sharedMemory = true;
+
+  bool dualRing = false;
+
+  size_t lanesCount = 1;
+  size_t lane = 0;
+  unsigned short lanePortStep = 100;
+
+  unsigned int reorderInterval = 0;
+
+  bool bindIpSet = false;
+  Ip4 bindIp{};
+  bool advertisedIpSet = false;
+  Ip4 advertisedIp{};
+  bool reusePort = false;
+
+  SocketOptions socketOptions;
+
+  bool compression = false;
+
+  size_t directTransferThreshold = 256;
+
+  // Shared memory ring of application taking delivered messages
+  std::string messageRingName;
+  size_t deliveryWorkersCount = 1;
+  size_t deliveryQueueCapacity = 1024;
+  OverflowPolicy deliveryOverflowPolicy = OverflowPolicy::REJECT;
+
   std::vector<const char *> arguments;
   bool inputParsed = false;
 
@@ -47,6 +136,23 @@ class ProgramArguments {
 
   void parseProtocol(const std::string &input);
 
+  void parseOption(const std::string &name, const std::string &value);
+
+  std::vector<const char *> parseOptions();
+
+  void parseTopology(const std::string &path);
+
+  void parseHierarchy(const std::string &path);
+
+  void useTopology(const std::string &path);
+
+  void parseBindAddress(const std::string &input);
+
+  void parseOverflowPolicy(const std::string &input);
+
+  int parseNumericOption(const std::string &name, const std::string &value,
+                         int maxValue);
+
  public:
   ProgramArguments() = delete;
 
@@ -67,6 +173,57 @@ class ProgramArguments {
 
   Protocol getProtocol() const;
 
+  bool hasTopology() const;
+
+  /**
+   * With hierarchy it is local ring of host
+   */
+  const Topology &getTopology() const;
+
+  bool hasHierarchy() const;
+
+  const RingHierarchy &getHierarchy() const;
+
+  bool useSharedMemory() const;
+
+  bool useDualRing() const;
+
+  size_t getLanesCount() const;
+
+  size_t getLane() const;
+
+  /**
+   * Arguments of given lane, its ports are moved by lane times port step
+   */
+  ProgramArguments forLane(size_t lane) const noexcept(false);
+
+  /**
+   * Milliseconds, 0 when ring is not reordered
+   */
+  unsigned int getReorderInterval() const;
+
+  Ip4 getBindIp() const;
+
+  bool hasAdvertisedIp() const;
+
+  Ip4 getAdvertisedIp() const;
+
+  bool useReusePort() const;
+
+  const SocketOptions &getSocketOptions() const;
+
+  bool useCompression() const;
+
+  size_t getDirectTransferThreshold() const;
+
+  const std::string &getMessageRingName() const;
+
+  size_t getDeliveryWorkersCount() const;
+
+  size_t getDeliveryQueueCapacity() const;
+
+  OverflowPolicy getDeliveryOverflowPolicy() const;
+
   std::vector<const char *> getArguments() const;
 
   bool isInputParsed() const;
@@ -1,6 +1,10 @@
 #include "quitstatusobserver.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <stdexcept>
 
 QuitStatusObserver *QuitStatusObserver::instance;
 
@@ -8,7 +12,11 @@ void quitStatusObserverHandler(int) {
   QuitStatusObserver::getInstance().quit();
 }
 
-QuitStatusObserver::QuitStatusObserver() {}
+QuitStatusObserver::QuitStatusObserver() {
+  if (::pipe2(wakeupPipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+    throw std::runtime_error("Failed to create quit wakeup pipe");
+  }
+}
 
 QuitStatusObserver &QuitStatusObserver::getInstance() {
   if (!instance) {
@@ -21,6 +29,10 @@ QuitStatusObserver &QuitStatusObserver::getInstance() {
 void QuitStatusObserver::quit() {
   shouldQuitStatus = true;
 
+  const char wakeupByte = 'q';
+  ssize_t ret = ::write(wakeupPipe[1], &wakeupByte, sizeof(wakeupByte));
+  (void)ret;
+
   std::lock_guard<std::recursive_mutex> g(quitHandlersMutex);
   for (auto fun : quitHandlers) {
     fun();
@@ -29,6 +41,8 @@ void QuitStatusObserver::quit() {
 
 bool QuitStatusObserver::shouldQuit() const { return shouldQuitStatus; }
 
+int QuitStatusObserver::getWakeupDescriptor() const { return wakeupPipe[0]; }
+
 void QuitStatusObserver::registerHandler(
     QuitStatusObserver::QuitFunctionHandler_t handler) {
   std::lock_guard<std::recursive_mutex> g(quitHandlersMutex);
@@ -17,6 +17,8 @@ class QuitStatusObserver {
   static QuitStatusObserver *instance;
   std::atomic_bool shouldQuitStatus{false};
 
+  int wakeupPipe[2];
+
   std::vector<QuitFunctionHandler_t> quitHandlers;
 
   std::recursive_mutex quitHandlersMutex;
@@ -34,6 +36,12 @@ class QuitStatusObserver {
 
   bool shouldQuit() const;
 
+  /**
+   * Descriptor that becomes readable when quit was requested. Poll it along
+   * with sockets to interrupt blocking I/O.
+   */
+  int getWakeupDescriptor() const;
+
   void registerHandler(QuitFunctionHandler_t handler);
 
   void unregister(QuitFunctionHandler_t handler);
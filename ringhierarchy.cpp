@@ -0,0 +1,266 @@
+#include "ringhierarchy.h"
+
+#include <fstream>
+#include <sstream>
+
+constexpr const char* RingHierarchy::BackboneRingName;
+
+RingHierarchy RingHierarchy::fromFile(const std::string& path) noexcept(false) {
+  std::ifstream input(path);
+
+  if (!input) {
+    throw TopologyFileOpenFailedException("Failed to open hierarchy file `" +
+                                          path + "\'");
+  }
+
+  return fromStream(input);
+}
+
+RingHierarchy RingHierarchy::fromStream(std::istream& input) noexcept(false) {
+  // Every ring gets all lines, those of other rings blanked, so topology
+  // errors tell line of file
+  std::map<std::string, std::string> ringLines;
+  std::string ringName;
+  std::string line;
+  size_t lineNumber = 0;
+
+  while (std::getline(input, line)) {
+    ++lineNumber;
+
+    std::istringstream lineStream(line.substr(0, line.find('#')));
+    std::string keyword;
+    std::string name;
+    std::string excess;
+
+    if ((lineStream >> keyword) && keyword == "ring") {
+      if (!(lineStream >> name) || (lineStream >> excess)) {
+        throw RingHierarchyInvalidException(
+            "Hierarchy line " + std::to_string(lineNumber) +
+            ": expected `ring <ring name>\'");
+      }
+
+      ringName = name;
+      if (ringLines.count(ringName) == 0) {
+        ringLines[ringName] = std::string(lineNumber, '\n');
+      }
+      line.clear();
+    } else if (!keyword.empty() && ringName.empty()) {
+      throw RingHierarchyInvalidException(
+          "Hierarchy line " + std::to_string(lineNumber) +
+          ": host is not in any ring");
+    }
+
+    for (auto& entry : ringLines) {
+      if (entry.first == ringName) {
+        entry.second += line;
+      }
+      entry.second += '\n';
+    }
+  }
+
+  RingHierarchy hierarchy;
+  for (const auto& entry : ringLines) {
+    std::istringstream ringInput(entry.second);
+    try {
+      hierarchy.addRing(entry.first, Topology::fromStream(ringInput));
+    } catch (const TopologyInvalidEntryException& ex) {
+      throw RingHierarchyInvalidException("Ring `" + entry.first +
+                                          "': " + ex.what());
+    }
+  }
+
+  hierarchy.validate();
+
+  return hierarchy;
+}
+
+void RingHierarchy::addRing(const std::string& name,
+                            const Topology& topology) noexcept(false) {
+  if (name.empty()) {
+    throw RingHierarchyInvalidException("Ring has no name");
+  }
+
+  if (rings.count(name) != 0) {
+    throw RingHierarchyInvalidException("Duplicated ring `" + name + "'");
+  }
+
+  if (topology.empty()) {
+    throw RingHierarchyInvalidException("Ring `" + name + "' has no hosts");
+  }
+
+  rings[name] = topology;
+}
+
+const Topology* RingHierarchy::findBackbone() const {
+  auto backbone = rings.find(BackboneRingName);
+  if (backbone == rings.end()) {
+    return nullptr;
+  }
+
+  return &backbone->second;
+}
+
+void RingHierarchy::validate() const noexcept(false) {
+  if (rings.empty()) {
+    throw RingHierarchyInvalidException("Hierarchy has no rings");
+  }
+
+  const Topology* backbone = findBackbone();
+  if (rings.size() > 1 && !backbone) {
+    throw RingHierarchyInvalidException(
+        std::string("Rings are not joined by `") + BackboneRingName +
+        "' ring");
+  }
+
+  // Local ring of every host seen so far
+  std::map<std::string, const Topology::Host*> localHosts;
+
+  for (const auto& ring : rings) {
+    if (&ring.second == backbone) {
+      continue;
+    }
+
+    bool bridged = false;
+
+    for (const Topology::Host& host : ring.second.getHosts()) {
+      if (localHosts.count(host.name) != 0) {
+        throw RingHierarchyInvalidException(
+            "Host `" + host.name + "' is in more than one local ring");
+      }
+      localHosts[host.name] = &host;
+
+      if (backbone && backbone->contains(host.name)) {
+        const Topology::Host& backboneHost = backbone->getHost(host.name);
+        if (backboneHost.ip.s_addr != host.ip.s_addr ||
+            backboneHost.port != host.port) {
+          throw RingHierarchyInvalidException(
+              "Bridge `" + host.name + "' has other address on backbone");
+        }
+        bridged = true;
+      }
+    }
+
+    if (rings.size() > 1 && !bridged) {
+      throw RingHierarchyInvalidException("Ring `" + ring.first +
+                                          "' has no bridge to backbone");
+    }
+  }
+}
+
+const std::map<std::string, Topology>& RingHierarchy::getRings() const {
+  return rings;
+}
+
+bool RingHierarchy::empty() const { return rings.empty(); }
+
+bool RingHierarchy::contains(const std::string& hostName) const {
+  for (const auto& ring : rings) {
+    if (ring.second.contains(hostName)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const Topology& RingHierarchy::getRing(const std::string& name) const
+    noexcept(false) {
+  auto ring = rings.find(name);
+  if (ring == rings.end()) {
+    throw RingHierarchyInvalidException("Unknown ring `" + name + "'");
+  }
+
+  return ring->second;
+}
+
+const std::string& RingHierarchy::getLocalRingOf(
+    const std::string& hostName) const noexcept(false) {
+  const std::string* backboneName = nullptr;
+
+  for (const auto& ring : rings) {
+    if (!ring.second.contains(hostName)) {
+      continue;
+    }
+
+    if (ring.first != BackboneRingName) {
+      return ring.first;
+    }
+    backboneName = &ring.first;
+  }
+
+  if (!backboneName) {
+    throw RingHierarchyUnknownHostException("Host `" + hostName +
+                                            "' is not in hierarchy");
+  }
+
+  return *backboneName;
+}
+
+bool RingHierarchy::isOnBackbone(const std::string& hostName) const {
+  const Topology* backbone = findBackbone();
+
+  return backbone && backbone->contains(hostName);
+}
+
+const std::string& RingHierarchy::getBridgeOf(
+    const std::string& ringName) const noexcept(false) {
+  for (const Topology::Host& host : getRing(ringName).getHosts()) {
+    if (isOnBackbone(host.name)) {
+      return host.name;
+    }
+  }
+
+  throw RingHierarchyInvalidException("Ring `" + ringName +
+                                      "' has no bridge to backbone");
+}
+
+std::map<std::string, RingHierarchy::Route> RingHierarchy::getRoutingTable(
+    const std::string& hostName) const noexcept(false) {
+  const std::string& localRing = getLocalRingOf(hostName);
+  bool onBackbone = isOnBackbone(hostName);
+
+  std::map<std::string, Route> routes;
+
+  for (const auto& ring : rings) {
+    for (const Topology::Host& host : ring.second.getHosts()) {
+      if (host.name == hostName || routes.count(host.name) != 0) {
+        continue;
+      }
+
+      Route route;
+      const std::string& receiverRing = getLocalRingOf(host.name);
+
+      if (getRing(localRing).contains(host.name)) {
+        // Receiver is on our ring
+        route.ringName = localRing;
+        route.nextHopName = host.name;
+      } else if (onBackbone && isOnBackbone(host.name)) {
+        route.ringName = BackboneRingName;
+        route.nextHopName = host.name;
+      } else if (onBackbone) {
+        // Bridge of receiver's ring takes it down from backbone
+        route.ringName = BackboneRingName;
+        route.nextHopName = getBridgeOf(receiverRing);
+      } else {
+        // Our bridge takes it up to backbone
+        route.ringName = localRing;
+        route.nextHopName = getBridgeOf(localRing);
+      }
+
+      routes[host.name] = route;
+    }
+  }
+
+  return routes;
+}
+
+RingHierarchy RingHierarchy::withPortOffset(unsigned short offset) const
+    noexcept(false) {
+  RingHierarchy hierarchy;
+
+  for (const auto& ring : rings) {
+    hierarchy.rings[ring.first] = ring.second.withPortOffset(offset);
+  }
+
+  return hierarchy;
+}
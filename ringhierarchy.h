@@ -0,0 +1,98 @@
+#ifndef RINGHIERARCHY_H
+#define RINGHIERARCHY_H
+
+#include <istream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "topology.h"
+
+using RingHierarchyException = std::runtime_error;
+
+using RingHierarchyInvalidException = RingHierarchyException;
+
+using RingHierarchyUnknownHostException = RingHierarchyException;
+
+/**
+ * Ring of rings. Local rings are joined by backbone ring, host that is member
+ * of both its local ring and backbone is bridge of its local ring. Bridge has
+ * the same address in both rings, frames of both come to one socket.
+ *
+ * File format, hosts as in topology file, each ring after its `ring` line:
+ *   ring <ring name>
+ *   <host id> <ip> <port>
+ *   ...
+ */
+class RingHierarchy {
+ public:
+  static constexpr const char* BackboneRingName = "backbone";
+
+  /**
+   * Where host sends message for given receiver: to next hop on ring
+   */
+  struct Route {
+    std::string ringName;
+    std::string nextHopName;
+  };
+
+ private:
+  std::map<std::string, Topology> rings;
+
+  const Topology* findBackbone() const;
+
+ public:
+  RingHierarchy() = default;
+
+  static RingHierarchy fromFile(const std::string& path) noexcept(false);
+
+  /**
+   * Returned hierarchy is validated
+   */
+  static RingHierarchy fromStream(std::istream& input) noexcept(false);
+
+  void addRing(const std::string& name,
+               const Topology& topology) noexcept(false);
+
+  /**
+   * Host is in at most local ring and backbone, with the same address in
+   * both. With more than one ring every local ring has bridge.
+   */
+  void validate() const noexcept(false);
+
+  const std::map<std::string, Topology>& getRings() const;
+
+  bool empty() const;
+
+  bool contains(const std::string& hostName) const;
+
+  const Topology& getRing(const std::string& name) const noexcept(false);
+
+  /**
+   * Ring other than backbone host is member of, backbone for host that is
+   * only there
+   */
+  const std::string& getLocalRingOf(const std::string& hostName) const
+      noexcept(false);
+
+  bool isOnBackbone(const std::string& hostName) const;
+
+  /**
+   * First host of ring that is on backbone
+   */
+  const std::string& getBridgeOf(const std::string& ringName) const
+      noexcept(false);
+
+  /**
+   * Routes of host to every other host of hierarchy
+   */
+  std::map<std::string, Route> getRoutingTable(
+      const std::string& hostName) const noexcept(false);
+
+  /**
+   * The same hierarchy on ports moved by offset, used by parallel lanes
+   */
+  RingHierarchy withPortOffset(unsigned short offset) const noexcept(false);
+};
+
+#endif  // RINGHIERARCHY_H
@@ -0,0 +1,212 @@
+#include "ringordering.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+// 2-opt passes over whole tour, each pass is quadratic in hosts count
+const size_t MaxImprovementPasses = 32;
+
+// Cost of unmeasured link when nothing was measured yet
+const int64_t DefaultUnknownLinkCost = 1000000;
+}  // namespace
+
+void RingOrdering::setRoundTripTime(const std::string& hostName,
+                                    const std::string& otherHostName,
+                                    Duration roundTripTime) {
+  roundTripTimes[hostName][otherHostName] = roundTripTime;
+}
+
+void RingOrdering::setNextHost(const std::string& hostName,
+                               const std::string& nextHostName) {
+  nextHosts[hostName] = nextHostName;
+}
+
+void RingOrdering::forgetHost(const std::string& hostName) {
+  roundTripTimes.erase(hostName);
+  nextHosts.erase(hostName);
+}
+
+std::vector<std::string> RingOrdering::getCurrentOrder(
+    const std::string& first, const std::set<std::string>& hosts) const {
+  std::vector<std::string> order;
+  std::set<std::string> visited;
+
+  std::string host = first;
+  do {
+    if (hosts.count(host) == 0 || !visited.insert(host).second) {
+      return {};
+    }
+    order.push_back(host);
+
+    auto next = nextHosts.find(host);
+    if (next == nextHosts.end()) {
+      return {};
+    }
+    host = next->second;
+  } while (host != first);
+
+  if (order.size() != hosts.size()) {
+    return {};
+  }
+
+  return order;
+}
+
+std::vector<std::vector<int64_t>> RingOrdering::getLinkCosts(
+    const std::vector<std::string>& order) const {
+  const int64_t unknown = -1;
+  std::vector<std::vector<int64_t>> costs(
+      order.size(), std::vector<int64_t>(order.size(), unknown));
+  int64_t maxCost = 0;
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    auto row = roundTripTimes.find(order[i]);
+
+    for (size_t j = 0; j < order.size(); ++j) {
+      if (i == j) {
+        costs[i][j] = 0;
+        continue;
+      }
+
+      if (row == roundTripTimes.end()) {
+        continue;
+      }
+      auto roundTripTime = row->second.find(order[j]);
+      if (roundTripTime == row->second.end()) {
+        continue;
+      }
+
+      int64_t cost = roundTripTime->second.count() / 2;
+      // Other direction was already measured too
+      if (costs[j][i] != unknown && j < i) {
+        cost = (cost + costs[j][i]) / 2;
+      }
+      costs[i][j] = cost;
+      costs[j][i] = cost;
+      maxCost = std::max(maxCost, cost);
+    }
+  }
+
+  int64_t unknownCost = maxCost > 0 ? 2 * maxCost : DefaultUnknownLinkCost;
+  for (std::vector<int64_t>& row : costs) {
+    std::replace(row.begin(), row.end(), unknown, unknownCost);
+  }
+
+  return costs;
+}
+
+int64_t RingOrdering::getTourCost(
+    const std::vector<size_t>& tour,
+    const std::vector<std::vector<int64_t>>& costs) {
+  int64_t cost = 0;
+  for (size_t i = 0; i < tour.size(); ++i) {
+    cost += costs[tour[i]][tour[(i + 1) % tour.size()]];
+  }
+
+  return cost;
+}
+
+std::vector<size_t> RingOrdering::findNearestNeighborTour(
+    const std::vector<std::vector<int64_t>>& costs) {
+  std::vector<size_t> tour{0};
+  std::vector<bool> visited(costs.size(), false);
+  visited[0] = true;
+
+  while (tour.size() < costs.size()) {
+    size_t last = tour.back();
+    size_t nearest = 0;
+    int64_t nearestCost = std::numeric_limits<int64_t>::max();
+
+    for (size_t i = 0; i < costs.size(); ++i) {
+      if (!visited[i] && costs[last][i] < nearestCost) {
+        nearest = i;
+        nearestCost = costs[last][i];
+      }
+    }
+
+    visited[nearest] = true;
+    tour.push_back(nearest);
+  }
+
+  return tour;
+}
+
+void RingOrdering::improveTour(
+    std::vector<size_t>& tour,
+    const std::vector<std::vector<int64_t>>& costs) {
+  size_t n = tour.size();
+  bool improved = true;
+
+  // Reversing tour[i + 1..j] replaces links (i, i + 1) and (j, j + 1) by
+  // (i, j) and (i + 1, j + 1). Costs are symmetric, so reversed part costs
+  // the same. tour[0] is never moved.
+  for (size_t pass = 0; improved && pass < MaxImprovementPasses; ++pass) {
+    improved = false;
+
+    for (size_t i = 0; i + 2 < n; ++i) {
+      for (size_t j = i + 2; j < n; ++j) {
+        size_t a = tour[i];
+        size_t b = tour[i + 1];
+        size_t c = tour[j];
+        size_t d = tour[(j + 1) % n];
+        if (d == a) {
+          continue;
+        }
+
+        if (costs[a][c] + costs[b][d] < costs[a][b] + costs[c][d]) {
+          std::reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+          improved = true;
+        }
+      }
+    }
+  }
+}
+
+RingOrdering::Duration RingOrdering::getRotationTime(
+    const std::vector<std::string>& order) const {
+  std::vector<size_t> tour(order.size());
+  for (size_t i = 0; i < tour.size(); ++i) {
+    tour[i] = i;
+  }
+
+  return Duration{getTourCost(tour, getLinkCosts(order))};
+}
+
+std::vector<std::string> RingOrdering::optimize(
+    const std::vector<std::string>& order) const {
+  if (order.size() < 4) {
+    // Every order of three hosts is the same ring
+    return order;
+  }
+
+  std::vector<std::vector<int64_t>> costs = getLinkCosts(order);
+
+  std::vector<size_t> currentTour(order.size());
+  for (size_t i = 0; i < currentTour.size(); ++i) {
+    currentTour[i] = i;
+  }
+  int64_t currentCost = getTourCost(currentTour, costs);
+
+  // Current order is improved too, it may already be close to optimum
+  std::vector<size_t> improvedTour = currentTour;
+  improveTour(improvedTour, costs);
+
+  std::vector<size_t> nearestNeighborTour = findNearestNeighborTour(costs);
+  improveTour(nearestNeighborTour, costs);
+
+  std::vector<size_t>& bestTour =
+      getTourCost(nearestNeighborTour, costs) < getTourCost(improvedTour, costs)
+          ? nearestNeighborTour
+          : improvedTour;
+  if (getTourCost(bestTour, costs) >= currentCost) {
+    return order;
+  }
+
+  std::vector<std::string> optimizedOrder;
+  for (size_t index : bestTour) {
+    optimizedOrder.push_back(order[index]);
+  }
+
+  return optimizedOrder;
+}
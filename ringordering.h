@@ -0,0 +1,78 @@
+#ifndef RINGORDERING_H
+#define RINGORDERING_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Latency map of ring kept by its coordinator. Hosts report round trip
+ * times they measured and their next hosts. Token rotation time is about
+ * the sum of one-way latencies of ring links, so ring order minimizing it
+ * is travelling salesman tour, found by nearest neighbor heuristic and
+ * 2-opt.
+ */
+class RingOrdering {
+ public:
+  using Duration = std::chrono::microseconds;
+
+  // Private variables
+ private:
+  // Round trip times measured by host to other hosts
+  std::map<std::string, std::map<std::string, Duration>> roundTripTimes;
+
+  std::map<std::string, std::string> nextHosts;
+
+  // Private methods
+ private:
+  /**
+   * One-way latencies between hosts of order, by their indexes. Both
+   * directions are averaged, links nobody measured cost more than any
+   * measured one.
+   */
+  std::vector<std::vector<int64_t>> getLinkCosts(
+      const std::vector<std::string>& order) const;
+
+  static int64_t getTourCost(const std::vector<size_t>& tour,
+                             const std::vector<std::vector<int64_t>>& costs);
+
+  static std::vector<size_t> findNearestNeighborTour(
+      const std::vector<std::vector<int64_t>>& costs);
+
+  static void improveTour(std::vector<size_t>& tour,
+                          const std::vector<std::vector<int64_t>>& costs);
+
+ public:
+  void setRoundTripTime(const std::string& hostName,
+                        const std::string& otherHostName,
+                        Duration roundTripTime);
+
+  void setNextHost(const std::string& hostName,
+                   const std::string& nextHostName);
+
+  void forgetHost(const std::string& hostName);
+
+  /**
+   * Ring as reported by its hosts, starting at first. Empty if reported
+   * next hosts do not make ring of exactly hosts.
+   */
+  std::vector<std::string> getCurrentOrder(
+      const std::string& first, const std::set<std::string>& hosts) const;
+
+  /**
+   * Estimated token rotation time of ring in order
+   */
+  Duration getRotationTime(const std::vector<std::string>& order) const;
+
+  /**
+   * Order of the same hosts with shorter rotation time, or order itself.
+   * First host stays first.
+   */
+  std::vector<std::string> optimize(
+      const std::vector<std::string>& order) const;
+};
+
+#endif  // RINGORDERING_H
@@ -2,6 +2,7 @@
 #define SERIALIZABLE_H
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 class Serializable {
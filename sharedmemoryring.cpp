@@ -0,0 +1,403 @@
+#include "sharedmemoryring.h"
+
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+
+namespace {
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory ring needs address-free atomics");
+static_assert((SharedMemoryRing::Capacity & (SharedMemoryRing::Capacity - 1)) ==
+                  0,
+              "Ring capacity has to be power of two");
+
+std::string ringName(const Ip4& ip, unsigned short port) {
+  return "sr_tokenring_" + to_string(ip) + "_" + std::to_string(port);
+}
+
+uint64_t alignedFrameSize(size_t frameSize) {
+  size_t size = sizeof(SharedMemoryRing::FrameLength_t) + frameSize;
+  return (size + 3u) & ~static_cast<size_t>(3u);
+}
+
+void drainDescriptor(int descriptor) {
+  char buffer[64];
+  while (::read(descriptor, buffer, sizeof(buffer)) > 0) {
+  }
+}
+
+void writeWakeupByte(int descriptor) {
+  const char wakeupByte = 1;
+  ssize_t ret = ::write(descriptor, &wakeupByte, sizeof(wakeupByte));
+  (void)ret;
+}
+}  // namespace
+
+SharedMemoryRing::~SharedMemoryRing() {
+  if (state) {
+    if (consumer) {
+      state->closed.store(1);
+      ::shm_unlink(shmName.c_str());
+    } else if (producerClaimed) {
+      pid_t self = ::getpid();
+      state->producerPid.compare_exchange_strong(self, 0);
+    }
+    ::munmap(state, sizeof(SharedState));
+  }
+
+  if (wakeupDescriptor != -1) {
+    ::close(wakeupDescriptor);
+    if (consumer) {
+      ::unlink(fifoPath.c_str());
+    }
+  }
+
+  if (spaceWakeupDescriptor != -1) {
+    ::close(spaceWakeupDescriptor);
+    if (consumer) {
+      ::unlink(spaceFifoPath.c_str());
+    }
+  }
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(
+    const Ip4& ip, unsigned short port) noexcept(false) {
+  return create(ringName(ip, port));
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(
+    const std::string& name) noexcept(false) {
+  if (name.empty() || name.find('/') != std::string::npos) {
+    throw SharedMemoryRingCreationFailedException(
+        "Invalid shared memory ring name `" + name + "'");
+  }
+
+  std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing());
+  ring->consumer = true;
+  ring->shmName = "/" + name;
+  ring->fifoPath = "/tmp/" + name + ".fifo";
+  ring->spaceFifoPath = "/tmp/" + name + ".space.fifo";
+
+  // FIFOs go first, producer attaching to new ring has to find them
+  for (const std::string* path : {&ring->fifoPath, &ring->spaceFifoPath}) {
+    ::unlink(path->c_str());
+    if (::mkfifo(path->c_str(), 0600) == -1) {
+      throw SharedMemoryRingCreationFailedException(
+          "Failed to create wakeup FIFO `" + *path + "\'");
+    }
+  }
+
+  // Opened for writing too, so FIFO never reports hang up
+  ring->wakeupDescriptor =
+      ::open(ring->fifoPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (ring->wakeupDescriptor == -1) {
+    throw SharedMemoryRingCreationFailedException(
+        "Failed to open wakeup FIFO `" + ring->fifoPath + "\'");
+  }
+
+  ring->spaceWakeupDescriptor =
+      ::open(ring->spaceFifoPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (ring->spaceWakeupDescriptor == -1) {
+    throw SharedMemoryRingCreationFailedException(
+        "Failed to open wakeup FIFO `" + ring->spaceFifoPath + "\'");
+  }
+
+  // Ring left by crashed host is replaced, its producer detects it by inode
+  ::shm_unlink(ring->shmName.c_str());
+  int descriptor =
+      ::shm_open(ring->shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (descriptor == -1) {
+    throw SharedMemoryRingCreationFailedException(
+        "Failed to create shared memory ring `" + ring->shmName + "\'");
+  }
+
+  if (::ftruncate(descriptor, sizeof(SharedState)) == -1) {
+    ::close(descriptor);
+    ::shm_unlink(ring->shmName.c_str());
+    throw SharedMemoryRingCreationFailedException(
+        "Failed to resize shared memory ring");
+  }
+
+  void* memory = ::mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, descriptor, 0);
+  ::close(descriptor);
+  if (memory == MAP_FAILED) {
+    ::shm_unlink(ring->shmName.c_str());
+    throw SharedMemoryRingCreationFailedException(
+        "Failed to map shared memory ring");
+  }
+  // New object is zero filled, which is valid empty ring. Producer may be
+  // already attached, so it must not be initialized again.
+  ring->state = static_cast<SharedState*>(memory);
+
+  return ring;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::attach(
+    const Ip4& ip, unsigned short port) {
+  return attach(ringName(ip, port));
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::attach(
+    const std::string& name) {
+  if (name.empty() || name.find('/') != std::string::npos) {
+    return nullptr;
+  }
+
+  std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing());
+  ring->shmName = "/" + name;
+  ring->fifoPath = "/tmp/" + name + ".fifo";
+  ring->spaceFifoPath = "/tmp/" + name + ".space.fifo";
+
+  int descriptor = ::shm_open(ring->shmName.c_str(), O_RDWR, 0);
+  if (descriptor == -1) {
+    return nullptr;
+  }
+
+  struct stat status;
+  if (::fstat(descriptor, &status) == -1 ||
+      status.st_size != static_cast<off_t>(sizeof(SharedState))) {
+    ::close(descriptor);
+    return nullptr;
+  }
+
+  void* memory = ::mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, descriptor, 0);
+  ::close(descriptor);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  ring->state = static_cast<SharedState*>(memory);
+  ring->inode = status.st_ino;
+
+  if (ring->state->closed.load()) {
+    return nullptr;
+  }
+
+  // Ring is single producer. Owner may be taken over only when it is dead.
+  pid_t self = ::getpid();
+  pid_t owner = 0;
+  if (!ring->state->producerPid.compare_exchange_strong(owner, self) &&
+      owner != self) {
+    if (::kill(owner, 0) == 0 || errno != ESRCH ||
+        !ring->state->producerPid.compare_exchange_strong(owner, self)) {
+      return nullptr;
+    }
+  }
+  ring->producerClaimed = true;
+
+  // Not write only, wakeup of crashed consumer must not raise SIGPIPE
+  ring->wakeupDescriptor =
+      ::open(ring->fifoPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (ring->wakeupDescriptor == -1) {
+    return nullptr;
+  }
+
+  ring->spaceWakeupDescriptor =
+      ::open(ring->spaceFifoPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (ring->spaceWakeupDescriptor == -1) {
+    return nullptr;
+  }
+
+  return ring;
+}
+
+bool SharedMemoryRing::isLocalAddress(const Ip4& ip) {
+  if ((ntohl(ip.s_addr) >> 24) == 127) {
+    return true;
+  }
+
+  static std::set<in_addr_t> localAddresses = [] {
+    std::set<in_addr_t> addresses;
+    struct ifaddrs* interfaces = nullptr;
+
+    if (::getifaddrs(&interfaces) == 0) {
+      for (struct ifaddrs* it = interfaces; it; it = it->ifa_next) {
+        if (it->ifa_addr && it->ifa_addr->sa_family == AF_INET) {
+          addresses.insert(
+              reinterpret_cast<struct sockaddr_in*>(it->ifa_addr)
+                  ->sin_addr.s_addr);
+        }
+      }
+      ::freeifaddrs(interfaces);
+    }
+
+    return addresses;
+  }();
+
+  return localAddresses.count(ip.s_addr) != 0;
+}
+
+void SharedMemoryRing::copyIn(uint64_t position, const void* source,
+                              size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  size_t offset = static_cast<size_t>(position & (Capacity - 1));
+  size_t firstPart = std::min(size, Capacity - offset);
+
+  std::memcpy(state->data + offset, source, firstPart);
+  std::memcpy(state->data, static_cast<const uint8_t*>(source) + firstPart,
+              size - firstPart);
+}
+
+void SharedMemoryRing::copyOut(uint64_t position, void* destination,
+                               size_t size) const {
+  size_t offset = static_cast<size_t>(position & (Capacity - 1));
+  size_t firstPart = std::min(size, Capacity - offset);
+
+  std::memcpy(destination, state->data + offset, firstPart);
+  std::memcpy(static_cast<uint8_t*>(destination) + firstPart, state->data,
+              size - firstPart);
+}
+
+bool SharedMemoryRing::push(const Serializable::container_type& frame) {
+  return push(frame.data(), frame.size(), nullptr, 0);
+}
+
+bool SharedMemoryRing::push(const void* prefix, size_t prefixSize,
+                            const void* data, size_t dataSize) {
+  uint64_t needed = alignedFrameSize(prefixSize + dataSize);
+  uint64_t head = state->head.load(std::memory_order_relaxed);
+  uint64_t tail = state->tail.load(std::memory_order_acquire);
+
+  if (Capacity - (head - tail) < needed) {
+    return false;
+  }
+
+  FrameLength_t frameLength = static_cast<FrameLength_t>(prefixSize + dataSize);
+  copyIn(head, &frameLength, sizeof(frameLength));
+  copyIn(head + sizeof(frameLength), prefix, prefixSize);
+  copyIn(head + sizeof(frameLength) + prefixSize, data, dataSize);
+
+  state->head.store(head + needed, std::memory_order_release);
+
+  // Pairs with fence in prepareToSleep(), one of us sees the other
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (state->consumerWaiting.load(std::memory_order_relaxed)) {
+    writeWakeupByte(wakeupDescriptor);
+  }
+
+  return true;
+}
+
+bool SharedMemoryRing::pop(Serializable::container_type& frame) {
+  uint64_t tail = state->tail.load(std::memory_order_relaxed);
+  uint64_t head = state->head.load(std::memory_order_acquire);
+
+  if (head == tail) {
+    return false;
+  }
+
+  FrameLength_t frameLength;
+  copyOut(tail, &frameLength, sizeof(frameLength));
+
+  if (alignedFrameSize(frameLength) > head - tail) {
+    // Corrupted ring, drop everything that is in it
+    state->tail.store(head, std::memory_order_release);
+    return false;
+  }
+
+  frame.resize(frameLength);
+  copyOut(tail + sizeof(frameLength), frame.data(), frameLength);
+
+  state->tail.store(tail + alignedFrameSize(frameLength),
+                    std::memory_order_release);
+
+  // Pairs with fence in prepareToWaitForSpace(), one of us sees the other
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (state->producerWaiting.load(std::memory_order_relaxed)) {
+    writeWakeupByte(spaceWakeupDescriptor);
+  }
+
+  return true;
+}
+
+bool SharedMemoryRing::empty() const {
+  return state->head.load(std::memory_order_acquire) ==
+         state->tail.load(std::memory_order_relaxed);
+}
+
+bool SharedMemoryRing::spinUntilNotEmpty(
+    const std::chrono::microseconds& spinTime) const {
+  auto deadline = std::chrono::steady_clock::now() + spinTime;
+
+  do {
+    for (int i = 0; i < 64; ++i) {
+      if (!empty()) {
+        return true;
+      }
+    }
+  } while (std::chrono::steady_clock::now() < deadline);
+
+  return false;
+}
+
+bool SharedMemoryRing::prepareToSleep() {
+  state->consumerWaiting.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (!empty()) {
+    state->consumerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+
+  return true;
+}
+
+void SharedMemoryRing::finishSleep() {
+  state->consumerWaiting.store(0, std::memory_order_relaxed);
+  drainDescriptor(wakeupDescriptor);
+}
+
+int SharedMemoryRing::getWakeupDescriptor() const { return wakeupDescriptor; }
+
+bool SharedMemoryRing::prepareToWaitForSpace(size_t frameSize) {
+  state->producerWaiting.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  uint64_t used = state->head.load(std::memory_order_relaxed) -
+                  state->tail.load(std::memory_order_acquire);
+  if (Capacity - used >= alignedFrameSize(frameSize)) {
+    state->producerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+
+  return true;
+}
+
+void SharedMemoryRing::finishWaitForSpace() {
+  state->producerWaiting.store(0, std::memory_order_relaxed);
+  drainDescriptor(spaceWakeupDescriptor);
+}
+
+int SharedMemoryRing::getSpaceWakeupDescriptor() const {
+  return spaceWakeupDescriptor;
+}
+
+bool SharedMemoryRing::isClosed() const {
+  if (state->closed.load(std::memory_order_relaxed)) {
+    return true;
+  }
+
+  // Ring recreated by restarted consumer is another shared memory object
+  int descriptor = ::shm_open(shmName.c_str(), O_RDONLY, 0);
+  if (descriptor == -1) {
+    return true;
+  }
+
+  struct stat status;
+  bool replaced = ::fstat(descriptor, &status) == -1 || status.st_ino != inode;
+  ::close(descriptor);
+
+  return replaced;
+}
@@ -0,0 +1,153 @@
+#ifndef SHAREDMEMORYRING_H
+#define SHAREDMEMORYRING_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "ip4.h"
+#include "serializable.h"
+
+using SharedMemoryRingException = std::runtime_error;
+
+using SharedMemoryRingCreationFailedException = SharedMemoryRingException;
+
+/**
+ * Single producer, single consumer frame queue in POSIX shared memory.
+ *
+ * Consumer (receiving host) creates the ring named after its ip and port.
+ * Producer (previous host on the same machine) attaches to it and owns it
+ * exclusively until it detaches or dies. Sleeping consumer is woken up through
+ * a named FIFO, so it can poll the ring together with its sockets. Producer
+ * waiting for space in full ring is woken up through another one.
+ */
+class SharedMemoryRing {
+ public:
+  static const size_t Capacity = 1024 * 1024;
+
+  using FrameLength_t = uint32_t;
+
+ private:
+  struct SharedState {
+    std::atomic<uint32_t> closed;
+    std::atomic<pid_t> producerPid;
+    std::atomic<uint32_t> consumerWaiting;
+    std::atomic<uint32_t> producerWaiting;
+
+    alignas(64) std::atomic<uint64_t> head;  // written by producer
+    alignas(64) std::atomic<uint64_t> tail;  // written by consumer
+
+    alignas(64) uint8_t data[Capacity];
+  };
+
+  SharedState* state{nullptr};
+  bool consumer{false};
+  bool producerClaimed{false};
+  int wakeupDescriptor{-1};
+  int spaceWakeupDescriptor{-1};
+  ino_t inode{0};
+  std::string shmName;
+  std::string fifoPath;
+  std::string spaceFifoPath;
+
+  SharedMemoryRing() = default;
+
+  void copyIn(uint64_t position, const void* source, size_t size);
+
+  void copyOut(uint64_t position, void* destination, size_t size) const;
+
+ public:
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+  ~SharedMemoryRing();
+
+  /**
+   * Creates (or replaces stale) ring of host listening on ip and port
+   */
+  static std::unique_ptr<SharedMemoryRing> create(
+      const Ip4& ip, unsigned short port) noexcept(false);
+
+  /**
+   * Attaches to ring of host listening on ip and port. Returns nullptr if
+   * host has no ring or it is already fed by another live producer.
+   */
+  static std::unique_ptr<SharedMemoryRing> attach(const Ip4& ip,
+                                                  unsigned short port);
+
+  /**
+   * Ring with given name (without `/'), for consumers that are not hosts
+   */
+  static std::unique_ptr<SharedMemoryRing> create(
+      const std::string& name) noexcept(false);
+
+  static std::unique_ptr<SharedMemoryRing> attach(const std::string& name);
+
+  static bool isLocalAddress(const Ip4& ip);
+
+  /**
+   * Producer side. Returns false if frame does not fit, caller has to use
+   * other way of delivery.
+   */
+  bool push(const Serializable::container_type& frame);
+
+  /**
+   * Producer side. Pushes one frame made of prefix followed by data, without
+   * joining them first.
+   */
+  bool push(const void* prefix, size_t prefixSize, const void* data,
+            size_t dataSize);
+
+  /**
+   * Consumer side. Returns false if ring is empty.
+   */
+  bool pop(Serializable::container_type& frame);
+
+  bool empty() const;
+
+  /**
+   * Consumer side. Busy waits up to spinTime for frame, cheaper than sleeping
+   * when frames follow each other closely.
+   */
+  bool spinUntilNotEmpty(const std::chrono::microseconds& spinTime) const;
+
+  /**
+   * Consumer side. Announces that consumer is going to sleep on wakeup
+   * descriptor. Returns false (and cancels sleep) if ring is not empty.
+   */
+  bool prepareToSleep();
+
+  /**
+   * Consumer side. Clears sleep announcement and drains wakeup descriptor.
+   */
+  void finishSleep();
+
+  int getWakeupDescriptor() const;
+
+  /**
+   * Producer side. Announces that producer is going to sleep on space wakeup
+   * descriptor until frame of frameSize fits. Returns false (and cancels
+   * sleep) if it fits already.
+   */
+  bool prepareToWaitForSpace(size_t frameSize);
+
+  /**
+   * Producer side. Clears sleep announcement and drains space wakeup
+   * descriptor.
+   */
+  void finishWaitForSpace();
+
+  int getSpaceWakeupDescriptor() const;
+
+  /**
+   * Producer side. True if consumer went away or replaced ring with new one.
+   */
+  bool isClosed() const;
+};
+
+#endif  // SHAREDMEMORYRING_H
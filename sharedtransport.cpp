@@ -0,0 +1,25 @@
+#include "sharedtransport.h"
+
+SharedTransport::SharedTransport(Transport& transport)
+    : transport(transport) {}
+
+void SharedTransport::open() noexcept(false) {}
+
+Ip4 SharedTransport::getLocalIp() const { return transport.getLocalIp(); }
+
+unsigned short SharedTransport::getLocalPort() const {
+  return transport.getLocalPort();
+}
+
+void SharedTransport::send(const std::vector<Frame>& frames) noexcept(false) {
+  transport.send(frames);
+}
+
+size_t SharedTransport::receive(std::vector<Frame>& output,
+                                size_t maxFrames) noexcept(false) {
+  return transport.receive(output, maxFrames);
+}
+
+int SharedTransport::getReadinessDescriptor() const {
+  return transport.getReadinessDescriptor();
+}
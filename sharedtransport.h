@@ -0,0 +1,35 @@
+#ifndef SHAREDTRANSPORT_H
+#define SHAREDTRANSPORT_H
+
+#include <vector>
+
+#include "ip4.h"
+#include "transport.h"
+
+/**
+ * Transport of another ring run over transport owned by someone else. Frames
+ * of both rings go through the same socket, fast path of owner's transport is
+ * kept for owner's next host. Opening it does nothing.
+ */
+class SharedTransport : public Transport {
+ private:
+  Transport& transport;
+
+ public:
+  explicit SharedTransport(Transport& transport);
+
+  void open() noexcept(false) override;
+
+  Ip4 getLocalIp() const override;
+
+  unsigned short getLocalPort() const override;
+
+  void send(const std::vector<Frame>& frames) noexcept(false) override;
+
+  size_t receive(std::vector<Frame>& output,
+                 size_t maxFrames) noexcept(false) override;
+
+  int getReadinessDescriptor() const override;
+};
+
+#endif  // SHAREDTRANSPORT_H
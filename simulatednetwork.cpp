@@ -0,0 +1,108 @@
+#include "simulatednetwork.h"
+
+#include "utility.h"
+
+bool SimulatedNetwork::Delivery::operator>(const Delivery& other) const {
+  return time != other.time ? time > other.time : sequence > other.sequence;
+}
+
+SimulatedNetwork::SimulatedNetwork(const LinkModel& defaultLinkModel,
+                                   uint64_t seed)
+    : defaultLinkModel(defaultLinkModel), randomGenerator(seed) {}
+
+const SimulatedNetwork::LinkModel& SimulatedNetwork::getLinkModel(
+    const Socket::IpAndPortPair& source,
+    const Socket::IpAndPortPair& destination) const {
+  if (linkModels.empty()) {
+    return defaultLinkModel;
+  }
+
+  auto it = linkModels.find(
+      std::make_pair(std::make_pair(source.first.s_addr, source.second),
+                     std::make_pair(destination.first.s_addr,
+                                    destination.second)));
+
+  return it != linkModels.end() ? it->second : defaultLinkModel;
+}
+
+void SimulatedNetwork::setLinkModel(const Socket::IpAndPortPair& source,
+                                    const Socket::IpAndPortPair& destination,
+                                    const LinkModel& linkModel) {
+  linkModels[std::make_pair(
+      std::make_pair(source.first.s_addr, source.second),
+      std::make_pair(destination.first.s_addr, destination.second))] =
+      linkModel;
+}
+
+void SimulatedNetwork::transmit(const Transport::Frame& frame,
+                                const Socket::IpAndPortPair& source) {
+  const LinkModel& linkModel = getLinkModel(source, frame.address);
+
+  ++framesTransmitted;
+  bytesTransmitted += frame.data.size();
+
+  if (linkModel.lossProbability > 0.0 &&
+      random(0.0, 1.0, randomGenerator) < linkModel.lossProbability) {
+    ++framesLost;
+    return;
+  }
+
+  std::chrono::microseconds delay = linkModel.latency;
+
+  if (linkModel.jitter.count() > 0) {
+    delay += std::chrono::microseconds{random<std::chrono::microseconds::rep>(
+        0, linkModel.jitter.count(), randomGenerator)};
+  }
+
+  if (linkModel.reorderProbability > 0.0 &&
+      random(0.0, 1.0, randomGenerator) < linkModel.reorderProbability) {
+    delay += linkModel.reorderDelay;
+  }
+
+  Delivery delivery;
+  delivery.time = now + delay;
+  delivery.sequence = nextSequence++;
+  delivery.destination = frame.address;
+  delivery.frame.address = source;
+  delivery.frame.data = frame.data;
+
+  deliveries.push(std::move(delivery));
+}
+
+void SimulatedNetwork::setTime(TimePoint now) { this->now = now; }
+
+SimulatedNetwork::TimePoint SimulatedNetwork::getTime() const { return now; }
+
+bool SimulatedNetwork::hasPendingDeliveries() const {
+  return !deliveries.empty();
+}
+
+SimulatedNetwork::TimePoint SimulatedNetwork::getNextDeliveryTime() const {
+  return deliveries.top().time;
+}
+
+LoopbackTransport* SimulatedNetwork::deliverNext() {
+  // Frame is moved out, priority_queue gives only const access
+  Delivery delivery = std::move(const_cast<Delivery&>(deliveries.top()));
+  deliveries.pop();
+
+  LoopbackTransport* transport =
+      find(delivery.destination.first, delivery.destination.second);
+
+  if (!deliver(std::move(delivery.frame), delivery.destination)) {
+    ++framesLost;
+    return nullptr;
+  }
+
+  return transport;
+}
+
+uint64_t SimulatedNetwork::getFramesTransmitted() const {
+  return framesTransmitted;
+}
+
+uint64_t SimulatedNetwork::getBytesTransmitted() const {
+  return bytesTransmitted;
+}
+
+uint64_t SimulatedNetwork::getFramesLost() const { return framesLost; }
@@ -0,0 +1,104 @@
+#ifndef SIMULATEDNETWORK_H
+#define SIMULATEDNETWORK_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "loopbacktransport.h"
+#include "tokenringengine.h"
+
+/**
+ * Loopback network with virtual clock. Every link delays frames by its
+ * latency and may lose or reorder them. Runs with the same seed are
+ * identical.
+ */
+class SimulatedNetwork : public LoopbackNetwork {
+ public:
+  using TimePoint = TokenRingEngine::TimePoint;
+
+  struct LinkModel {
+    std::chrono::microseconds latency{100};
+    // Uniformly distributed extra delay, reorders frames too
+    std::chrono::microseconds jitter{0};
+    double lossProbability{0.0};
+    // Reordered frame is delayed by reorderDelay, so later frames pass it
+    double reorderProbability{0.0};
+    std::chrono::microseconds reorderDelay{1000};
+  };
+
+  // Private variables
+ private:
+  struct Delivery {
+    TimePoint time;
+    // Breaks ties, frames sent first are delivered first
+    uint64_t sequence;
+    Socket::IpAndPortPair destination;
+    Transport::Frame frame;
+
+    bool operator>(const Delivery& other) const;
+  };
+
+  using LinkKey = std::pair<std::pair<in_addr_t, unsigned short>,
+                            std::pair<in_addr_t, unsigned short>>;
+
+  LinkModel defaultLinkModel;
+  std::map<LinkKey, LinkModel> linkModels;
+
+  std::mt19937_64 randomGenerator;
+
+  TimePoint now;
+
+  uint64_t nextSequence{0};
+  std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>>
+      deliveries;
+
+  uint64_t framesTransmitted{0};
+  uint64_t bytesTransmitted{0};
+  uint64_t framesLost{0};
+
+  // Private methods
+ private:
+  const LinkModel& getLinkModel(const Socket::IpAndPortPair& source,
+                                const Socket::IpAndPortPair& destination) const;
+
+ public:
+  SimulatedNetwork(const LinkModel& defaultLinkModel, uint64_t seed);
+
+  /**
+   * Overrides model of one direction of link
+   */
+  void setLinkModel(const Socket::IpAndPortPair& source,
+                    const Socket::IpAndPortPair& destination,
+                    const LinkModel& linkModel);
+
+  void transmit(const Transport::Frame& frame,
+                const Socket::IpAndPortPair& source) override;
+
+  void setTime(TimePoint now);
+
+  TimePoint getTime() const;
+
+  bool hasPendingDeliveries() const;
+
+  TimePoint getNextDeliveryTime() const;
+
+  /**
+   * Delivers earliest frame and returns transport which got it. Returns
+   * nullptr when nobody listens on destination anymore.
+   */
+  LoopbackTransport* deliverNext();
+
+  uint64_t getFramesTransmitted() const;
+
+  uint64_t getBytesTransmitted() const;
+
+  uint64_t getFramesLost() const;
+};
+
+#endif  // SIMULATEDNETWORK_H
@@ -0,0 +1,606 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "logger.h"
+#include "programarguments.h"
+#include "tokenringpacket.h"
+#include "utility.h"
+
+namespace {
+const size_t ReceiveBatchSize = 64;
+}  // namespace
+
+bool Simulation::Timer::operator>(const Timer& other) const {
+  if (time != other.time) {
+    return time > other.time;
+  }
+  return nodeIndex > other.nodeIndex;
+}
+
+Simulation::Simulation(const Configuration& configuration) noexcept(false)
+    : configuration(configuration),
+      network(configuration.linkModel, configuration.seed),
+      randomGenerator(configuration.seed) {
+  if (configuration.nodesCount < 2) {
+    throw SimulationInvalidConfigurationException(
+        "Simulation needs at least two nodes");
+  }
+
+  if (configuration.lanesCount == 0) {
+    throw SimulationInvalidConfigurationException(
+        "Simulation needs at least one lane");
+  }
+
+  if (configuration.nodesCount + configuration.joiningNodesCount >
+      (65535u - BasePort) / configuration.lanesCount) {
+    throw SimulationInvalidConfigurationException(
+        "Too many nodes, they do not fit into port range");
+  }
+
+  if (configuration.directTransferThreshold > TokenRingPacket::DataMaxSize) {
+    throw SimulationInvalidConfigurationException(
+        "Direct transfer threshold is larger than frame");
+  }
+
+  size_t messageMaxSize = TokenRingPacket::DataMaxSize;
+  if (configuration.messageSize > configuration.directTransferThreshold) {
+    messageMaxSize = TokenRingPacket::DirectDataMaxSize;
+  }
+
+  if (configuration.messageSize > messageMaxSize) {
+    throw SimulationInvalidConfigurationException(
+        "Message does not fit into frame");
+  }
+
+  if (configuration.ringsCount == 0 ||
+      configuration.nodesCount < 2 * configuration.ringsCount) {
+    throw SimulationInvalidConfigurationException(
+        "Every ring needs at least two nodes");
+  }
+
+  if (configuration.racksCount == 0) {
+    throw SimulationInvalidConfigurationException(
+        "Simulation needs at least one rack");
+  }
+
+  if (configuration.crashedNodesCount + configuration.leavingNodesCount >=
+      configuration.nodesCount) {
+    throw SimulationInvalidConfigurationException(
+        "At least one node has to survive");
+  }
+
+  if (configuration.joiningNodesCount > 0 &&
+      (configuration.lanesCount > 1 || configuration.ringsCount > 1 ||
+       configuration.racksCount > 1 || configuration.dualRing)) {
+    throw SimulationInvalidConfigurationException(
+        "Nodes join plain ring of one lane in one rack only");
+  }
+
+  createNodes();
+  placeIntoRacks();
+}
+
+void Simulation::createNodes() {
+  Ip4 localhost = Ip4_from_string("127.0.0.1");
+
+  // Nodes are split into local rings in order, first node of each is bridge
+  std::vector<Topology> rings(configuration.ringsCount);
+  Topology backbone;
+
+  for (size_t i = 0; i < configuration.nodesCount; ++i) {
+    size_t ring = i * configuration.ringsCount / configuration.nodesCount;
+
+    Topology::Host host;
+    host.name = "N" + std::to_string(i);
+    host.ip = localhost;
+    host.port = static_cast<unsigned short>(BasePort + i);
+
+    if (rings[ring].empty() && configuration.ringsCount > 1) {
+      backbone.addHost(host);
+    }
+    rings[ring].addHost(host);
+    nodeIndexes[host.name] = i;
+  }
+
+  for (size_t ring = 0; ring < rings.size(); ++ring) {
+    hierarchy.addRing("R" + std::to_string(ring), rings[ring]);
+  }
+  if (configuration.ringsCount > 1) {
+    hierarchy.addRing(RingHierarchy::BackboneRingName, backbone);
+  }
+  hierarchy.validate();
+
+  nodes.resize(configuration.nodesCount * configuration.lanesCount);
+
+  RingHierarchy laneHierarchy;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    size_t lane = i / configuration.nodesCount;
+    if (i % configuration.nodesCount == 0) {
+      laneHierarchy = hierarchy.withPortOffset(
+          static_cast<unsigned short>(lane * configuration.nodesCount));
+    }
+
+    std::string name = "N" + std::to_string(i % configuration.nodesCount);
+    const Topology::Host& host =
+        laneHierarchy.getRing(laneHierarchy.getLocalRingOf(name))
+            .getHost(name);
+    Node& node = nodes[i];
+
+    node.transport.reset(new LoopbackTransport(network, host.ip, host.port));
+    node.engine.reset(new HierarchicalEngine(host.name, laneHierarchy,
+                                             *node.transport,
+                                             configuration.dualRing));
+    node.engine->setLane(lane, configuration.lanesCount);
+    node.engine->setTiming(configuration.timing);
+    node.engine->setDirectTransferThreshold(
+        configuration.directTransferThreshold);
+    node.engine->setRandomSeed(
+        static_cast<uint32_t>(configuration.seed + i));
+    setHandlers(i);
+  }
+
+  // Joining nodes get their engines once they join
+  for (size_t i = 0; i < configuration.joiningNodesCount; ++i) {
+    std::string name = "N" + std::to_string(configuration.nodesCount + i);
+    nodeIndexes[name] = nodes.size();
+
+    Node node;
+    node.transport.reset(new LoopbackTransport(
+        network, localhost,
+        static_cast<unsigned short>(BasePort + nodes.size())));
+    node.alive = false;
+    nodes.push_back(std::move(node));
+  }
+}
+
+void Simulation::setHandlers(size_t nodeIndex) {
+  Node& node = nodes[nodeIndex];
+
+  node.engine->setMessageHandler(
+      [this, nodeIndex](const TokenRingEngine::ReceivedMessage& message) {
+        auto sender = nodeIndexes.find(message.senderName);
+        if (sender != nodeIndexes.end()) {
+          ++nodes[sender->second].messagesDelivered;
+        }
+        ++report.messagesDelivered;
+
+        // Ids of sender grow on each ring, so they grow for every receiver
+        Node& receiver = nodes[nodeIndex];
+        auto stream = std::make_pair(message.senderName, message.ring);
+        auto lastId = receiver.lastDeliveredIds.find(stream);
+        if (lastId != receiver.lastDeliveredIds.end() &&
+            lastId->second >= message.messageId) {
+          ++report.messagesOutOfOrder;
+        }
+        receiver.lastDeliveredIds[stream] = message.messageId;
+
+        return TokenRingEngine::MessageHandling::TAKEN;
+      });
+  node.engine->setDeliveryReportHandler(
+      [this](const TokenRingEngine::DeliveryReport& deliveryReport) {
+        if (deliveryReport.status !=
+            TokenRingEngine::DeliveryStatus::DELIVERED) {
+          ++report.messagesNotDelivered;
+        }
+      });
+}
+
+bool Simulation::isOnFirstLane(size_t nodeIndex) const {
+  // Joining nodes come after all lanes, there is only one then
+  return nodeIndex < configuration.nodesCount ||
+         nodeIndex >= configuration.nodesCount * configuration.lanesCount;
+}
+
+void Simulation::placeIntoRacks() {
+  if (configuration.racksCount < 2) {
+    return;
+  }
+
+  std::vector<size_t> racks(configuration.nodesCount);
+  for (size_t& rack : racks) {
+    rack = random<size_t>(0, configuration.racksCount - 1, randomGenerator);
+  }
+
+  SimulatedNetwork::LinkModel interRackLinkModel = configuration.linkModel;
+  interRackLinkModel.latency = configuration.interRackLatency;
+
+  // Lanes of node are in its rack too
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    size_t lane = i / configuration.nodesCount;
+    Socket::IpAndPortPair source(nodes[i].transport->getLocalIp(),
+                                 nodes[i].transport->getLocalPort());
+
+    for (size_t j = 0; j < configuration.nodesCount; ++j) {
+      if (racks[i % configuration.nodesCount] == racks[j]) {
+        continue;
+      }
+
+      const Node& destination = nodes[lane * configuration.nodesCount + j];
+      network.setLinkModel(
+          source,
+          Socket::IpAndPortPair(destination.transport->getLocalIp(),
+                                destination.transport->getLocalPort()),
+          interRackLinkModel);
+    }
+  }
+}
+
+void Simulation::scheduleTimeout(size_t nodeIndex) {
+  Node& node = nodes[nodeIndex];
+
+  if (!node.alive) {
+    return;
+  }
+
+  TimePoint timeout = std::max(node.engine->getNextTimeout(), now);
+
+  if (timeout != node.scheduledTimeout) {
+    // Old entry stays in heap, it is skipped when popped
+    node.scheduledTimeout = timeout;
+    timers.push(Timer{timeout, nodeIndex});
+  }
+}
+
+void Simulation::recordFrame(const Transport::Frame& frame,
+                             size_t nodeIndex) {
+  using trppt = TokenRingPacket::PacketType;
+
+  if (!isOnFirstLane(nodeIndex) ||
+      frame.data.size() < sizeof(TokenRingPacket::Header)) {
+    return;
+  }
+
+  TokenRingPacket::Header header;
+  std::memcpy(&header, frame.data.data(), sizeof(header));
+
+  if (!header.tokenStatus || (header.ring & ~TokenRingPacket::RingRoutedBit) !=
+          DualRingEngine::PrimaryRing ||
+      header.type == trppt::JOIN ||
+      header.type == trppt::HEARTBEAT || header.type == trppt::HEARTBEAT_ACK ||
+      (header.flags & TokenRingPacket::FLAG_HANDED_OVER)) {
+    return;
+  }
+
+  Node& node = nodes[nodeIndex];
+
+  ++report.tokenPasses;
+
+  if (node.tokenSeen) {
+    auto rotationTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - node.lastTokenArrival);
+    rotationTimeSum += rotationTime;
+    ++rotationSamples;
+    report.maxRotationTime = std::max(report.maxRotationTime, rotationTime);
+  }
+  node.tokenSeen = true;
+  node.lastTokenArrival = now;
+
+  if (tokenSeen) {
+    report.maxTokenGap = std::max(
+        report.maxTokenGap,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - lastTokenArrival));
+  }
+  tokenSeen = true;
+  lastTokenArrival = now;
+}
+
+void Simulation::deliverFrame() {
+  LoopbackTransport* transport = network.deliverNext();
+
+  if (!transport) {
+    return;
+  }
+
+  size_t nodeIndex = transport->getLocalPort() - BasePort;
+
+  Node& node = nodes[nodeIndex];
+
+  receivedFrames.clear();
+  transport->receive(receivedFrames, ReceiveBatchSize);
+
+  for (const Transport::Frame& frame : receivedFrames) {
+    recordFrame(frame, nodeIndex);
+
+    // Messages are counted by handlers of nodes
+    uint64_t messagesDelivered = report.messagesDelivered;
+    node.engine->handleFrame(frame.data, now);
+    if (report.messagesDelivered != messagesDelivered) {
+      ++report.dataFramesDelivered;
+    }
+  }
+
+  checkLeft(nodeIndex);
+  scheduleTimeout(nodeIndex);
+}
+
+void Simulation::fireTimer() {
+  Timer timer = timers.top();
+  timers.pop();
+
+  Node& node = nodes[timer.nodeIndex];
+
+  if (!node.alive || timer.time != node.scheduledTimeout) {
+    return;
+  }
+
+  node.scheduledTimeout = TimePoint::max();
+  node.engine->handleTimeout(now);
+
+  checkLeft(timer.nodeIndex);
+  scheduleTimeout(timer.nodeIndex);
+}
+
+void Simulation::sendMessage() {
+  Timer timer = messageTimers.top();
+  messageTimers.pop();
+
+  Node& node = nodes[timer.nodeIndex];
+
+  if (!node.alive || node.leaving) {
+    return;
+  }
+
+  size_t receiverIndex =
+      random<size_t>(0, configuration.nodesCount - 2, randomGenerator);
+  if (receiverIndex >= timer.nodeIndex) {
+    ++receiverIndex;
+  }
+
+  const std::string& receiverName = nodes[receiverIndex].engine->getHostId();
+  size_t lane =
+      TokenRingEngine::getLaneOf(receiverName, configuration.lanesCount);
+
+  std::vector<unsigned char> data(configuration.messageSize, 'm');
+  nodes[lane * configuration.nodesCount + timer.nodeIndex].engine->sendMessage(
+      receiverName, data);
+  ++report.messagesSent;
+
+  messageTimers.push(Timer{now + configuration.messageInterval,
+                           timer.nodeIndex});
+}
+
+std::vector<size_t> Simulation::pickNodes(size_t count) {
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < configuration.nodesCount; ++i) {
+    if (nodes[i].alive && !nodes[i].leaving) {
+      candidates.push_back(i);
+    }
+  }
+
+  count = std::min(count, candidates.size());
+  for (size_t i = 0; i < count; ++i) {
+    size_t j = random<size_t>(i, candidates.size() - 1, randomGenerator);
+    std::swap(candidates[i], candidates[j]);
+  }
+  candidates.resize(count);
+
+  return candidates;
+}
+
+void Simulation::crashNodes() {
+  for (size_t index : pickNodes(configuration.crashedNodesCount)) {
+    Logger::getInstance().log("Simulation: crashing " +
+                              nodes[index].engine->getHostId());
+
+    // Node goes down on every lane
+    for (size_t lane = 0; lane < configuration.lanesCount; ++lane) {
+      Node& node = nodes[lane * configuration.nodesCount + index];
+      node.alive = false;
+      node.transport->close();
+    }
+  }
+}
+
+void Simulation::leaveNodes() {
+  for (size_t index : pickNodes(configuration.leavingNodesCount)) {
+    Logger::getInstance().log("Simulation: " +
+                              nodes[index].engine->getHostId() + " leaves");
+
+    // Node leaves every lane, it goes down once it has left
+    for (size_t lane = 0; lane < configuration.lanesCount; ++lane) {
+      size_t nodeIndex = lane * configuration.nodesCount + index;
+      nodes[nodeIndex].leaving = true;
+      nodes[nodeIndex].engine->leave(now);
+      scheduleTimeout(nodeIndex);
+    }
+  }
+}
+
+void Simulation::joinNodes() {
+  Ip4 localhost = Ip4_from_string("127.0.0.1");
+
+  for (size_t i = configuration.nodesCount; i < nodes.size(); ++i) {
+    std::vector<size_t> neighbors = pickNodes(1);
+    if (neighbors.empty()) {
+      return;
+    }
+
+    Node& node = nodes[i];
+    std::string name = "N" + std::to_string(i);
+    std::string port = std::to_string(node.transport->getLocalPort());
+    std::string neighborIp = ::to_string(localhost);
+    std::string neighborPort =
+        std::to_string(nodes[neighbors.front()].transport->getLocalPort());
+
+    // Joining node is run like one started with neighbor address
+    ProgramArguments programArguments({name.c_str(), port.c_str(),
+                                       neighborIp.c_str(),
+                                       neighborPort.c_str(), "0", "udp"},
+                                      true);
+
+    node.engine.reset(new HierarchicalEngine(programArguments,
+                                             *node.transport));
+    node.engine->setTiming(configuration.timing);
+    node.engine->setDirectTransferThreshold(
+        configuration.directTransferThreshold);
+    node.engine->setRandomSeed(static_cast<uint32_t>(configuration.seed + i));
+    setHandlers(i);
+
+    Logger::getInstance().log("Simulation: " + name + " joins at " +
+                              nodes[neighbors.front()].engine->getHostId());
+
+    node.alive = true;
+    node.transport->open();
+    node.engine->start(now);
+    scheduleTimeout(i);
+  }
+}
+
+void Simulation::checkLeft(size_t nodeIndex) {
+  Node& node = nodes[nodeIndex];
+
+  if (node.alive && node.leaving && node.engine->hasLeft(now)) {
+    node.alive = false;
+    node.transport->close();
+  }
+}
+
+void Simulation::finishReport() {
+  report.nodesCount =
+      configuration.nodesCount + configuration.joiningNodesCount;
+  report.duration = configuration.duration;
+  report.framesTransmitted = network.getFramesTransmitted();
+  report.bytesTransmitted = network.getBytesTransmitted();
+  report.framesLost = network.getFramesLost();
+
+  // Token lost for good counts too
+  if (tokenSeen) {
+    report.maxTokenGap = std::max(
+        report.maxTokenGap,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - lastTokenArrival));
+  }
+
+  if (rotationSamples) {
+    report.averageRotationTime = rotationTimeSum / rotationSamples;
+  }
+
+  double seconds =
+      std::chrono::duration<double>(configuration.duration).count();
+  if (seconds > 0.0) {
+    report.messagesPerSecond =
+        static_cast<double>(report.messagesDelivered) / seconds;
+  }
+
+  for (size_t i = configuration.nodesCount * configuration.lanesCount;
+       i < nodes.size(); ++i) {
+    if (nodes[i].tokenSeen) {
+      ++report.joinedNodesCount;
+    }
+  }
+
+  double sum = 0.0;
+  double squaresSum = 0.0;
+  // Deliveries are counted on lane 0 node of sender
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const Node& node = nodes[i];
+    if (node.alive && isOnFirstLane(i)) {
+      ++report.aliveNodesCount;
+
+      double delivered = static_cast<double>(node.messagesDelivered);
+      sum += delivered;
+      squaresSum += delivered * delivered;
+    }
+  }
+
+  if (squaresSum > 0.0) {
+    report.fairness = (sum * sum) / (report.aliveNodesCount * squaresSum);
+  }
+}
+
+Simulation::Report Simulation::run() {
+  now = TimePoint{};
+  network.setTime(now);
+
+  // Joining nodes are started by joinNodes()
+  size_t startedNodesCount =
+      configuration.nodesCount * configuration.lanesCount;
+
+  for (size_t i = 0; i < startedNodesCount; ++i) {
+    nodes[i].transport->open();
+  }
+
+  for (size_t i = 0; i < startedNodesCount; ++i) {
+    nodes[i].engine->start(now);
+    scheduleTimeout(i);
+  }
+
+  if (configuration.messageInterval.count() > 0) {
+    // Spread over first interval, so nodes do not send at the same time
+    for (size_t i = 0; i < configuration.nodesCount; ++i) {
+      auto offset = std::chrono::microseconds{random<int64_t>(
+          0, configuration.messageInterval.count() - 1, randomGenerator)};
+      messageTimers.push(Timer{now + offset, i});
+    }
+  }
+
+  TimePoint endTime = now + configuration.duration;
+  TimePoint crashTime = now + configuration.crashTime;
+  bool crashed = configuration.crashedNodesCount == 0;
+  TimePoint leaveTime = now + configuration.leaveTime;
+  bool left = configuration.leavingNodesCount == 0;
+  TimePoint joinTime = now + configuration.joinTime;
+  bool joined = configuration.joiningNodesCount == 0;
+
+  while (true) {
+    TimePoint nextTime = TimePoint::max();
+    if (network.hasPendingDeliveries()) {
+      nextTime = network.getNextDeliveryTime();
+    }
+    if (!timers.empty()) {
+      nextTime = std::min(nextTime, timers.top().time);
+    }
+    if (!messageTimers.empty()) {
+      nextTime = std::min(nextTime, messageTimers.top().time);
+    }
+
+    if (!crashed && crashTime <= nextTime) {
+      now = crashTime;
+      network.setTime(now);
+      crashNodes();
+      crashed = true;
+      continue;
+    }
+
+    if (!left && leaveTime <= nextTime) {
+      now = leaveTime;
+      network.setTime(now);
+      leaveNodes();
+      left = true;
+      continue;
+    }
+
+    if (!joined && joinTime <= nextTime) {
+      now = joinTime;
+      network.setTime(now);
+      joinNodes();
+      joined = true;
+      continue;
+    }
+
+    if (nextTime > endTime) {
+      break;
+    }
+
+    now = nextTime;
+    network.setTime(now);
+    ++report.eventsCount;
+
+    if (network.hasPendingDeliveries() &&
+        network.getNextDeliveryTime() == now) {
+      deliverFrame();
+    } else if (!timers.empty() && timers.top().time == now) {
+      fireTimer();
+    } else {
+      sendMessage();
+    }
+  }
+
+  now = endTime;
+  finishReport();
+
+  return report;
+}
@@ -0,0 +1,211 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "dualringengine.h"
+#include "hierarchicalengine.h"
+#include "loopbacktransport.h"
+#include "ringhierarchy.h"
+#include "simulatednetwork.h"
+#include "tokenringengine.h"
+#include "topology.h"
+
+using SimulationException = std::runtime_error;
+
+using SimulationInvalidConfigurationException = SimulationException;
+
+/**
+ * Discrete event simulation of ring of token ring engines connected by
+ * simulated network. Everything runs in one thread on virtual clock, so run
+ * is deterministic for given configuration.
+ */
+class Simulation {
+ public:
+  using TimePoint = TokenRingEngine::TimePoint;
+
+  struct Configuration {
+    size_t nodesCount{1000};
+    uint64_t seed{1};
+    std::chrono::milliseconds duration{60000};
+
+    SimulatedNetwork::LinkModel linkModel;
+    TokenRingEngine::Timing timing;
+
+    // Nodes crashed at crashTime, ring is expected to recover
+    size_t crashedNodesCount{0};
+    std::chrono::milliseconds crashTime{10000};
+
+    // Nodes leaving ring at leaveTime, they tell their neighbors
+    size_t leavingNodesCount{0};
+    std::chrono::milliseconds leaveTime{10000};
+
+    // Nodes joining ring at joinTime, each sends JOIN to random node. Only
+    // plain ring of one lane is joined this way.
+    size_t joiningNodesCount{0};
+    std::chrono::milliseconds joinTime{10000};
+
+    // Every node sends message to random node this often, besides greetings
+    std::chrono::microseconds messageInterval{0};
+    size_t messageSize{32};
+    size_t directTransferThreshold{
+        TokenRingEngine::DefaultDirectTransferThreshold};
+
+    // Second token goes the other way, token statistics are of primary ring
+    bool dualRing{false};
+
+    // Parallel rings over the same nodes, messages take lane of receiver.
+    // Token statistics are of lane 0.
+    size_t lanesCount{1};
+
+    // Nodes split into local rings joined by backbone of their first nodes.
+    // Token statistics are of local rings.
+    size_t ringsCount{1};
+
+    // Nodes are put into racks at random, links between racks have
+    // interRackLatency instead of link model latency
+    size_t racksCount{1};
+    std::chrono::microseconds interRackLatency{1000};
+  };
+
+  struct Report {
+    size_t nodesCount{0};
+    size_t aliveNodesCount{0};
+    // Joining nodes the token came to
+    size_t joinedNodesCount{0};
+    std::chrono::milliseconds duration{0};
+    uint64_t eventsCount{0};
+
+    uint64_t framesTransmitted{0};
+    uint64_t bytesTransmitted{0};
+    uint64_t framesLost{0};
+
+    uint64_t tokenPasses{0};
+    std::chrono::microseconds averageRotationTime{0};
+    std::chrono::microseconds maxRotationTime{0};
+    // Longest time nobody received token, shows recovery after crash
+    std::chrono::microseconds maxTokenGap{0};
+
+    uint64_t messagesSent{0};
+    uint64_t messagesDelivered{0};
+    // Reported back to sender as not delivered
+    uint64_t messagesNotDelivered{0};
+    // Delivered twice or after later message of the same sender
+    uint64_t messagesOutOfOrder{0};
+    // DATA frames that delivered at least one message
+    uint64_t dataFramesDelivered{0};
+    double messagesPerSecond{0.0};
+    // Jain's index of messages delivered per sender, 1.0 is perfectly fair
+    double fairness{0.0};
+  };
+
+  static const unsigned short BasePort = 10000;
+
+  // Private variables
+ private:
+  // Engine of one node on one lane, nodes of lane n follow those of lane n-1
+  struct Node {
+    std::unique_ptr<LoopbackTransport> transport;
+    std::unique_ptr<HierarchicalEngine> engine;
+    bool alive{true};
+    bool leaving{false};
+
+    TimePoint scheduledTimeout{TimePoint::max()};
+
+    bool tokenSeen{false};
+    TimePoint lastTokenArrival;
+
+    uint64_t messagesDelivered{0};
+    std::map<std::pair<std::string, uint8_t>, TokenRingPacket::MessageId_t>
+        lastDeliveredIds;
+  };
+
+  struct Timer {
+    TimePoint time;
+    size_t nodeIndex;
+
+    bool operator>(const Timer& other) const;
+  };
+
+  Configuration configuration;
+  SimulatedNetwork network;
+  RingHierarchy hierarchy;
+  std::vector<Node> nodes;
+  std::map<std::string, size_t> nodeIndexes;
+
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>>
+      messageTimers;
+
+  std::mt19937_64 randomGenerator;
+
+  TimePoint now;
+
+  bool tokenSeen{false};
+  TimePoint lastTokenArrival;
+  std::chrono::microseconds rotationTimeSum{0};
+  uint64_t rotationSamples{0};
+
+  Report report;
+
+  std::vector<Transport::Frame> receivedFrames;
+
+  // Private methods
+ private:
+  void createNodes();
+
+  void placeIntoRacks();
+
+  void scheduleTimeout(size_t nodeIndex);
+
+  void deliverFrame();
+
+  void fireTimer();
+
+  void sendMessage();
+
+  /**
+   * Picks count random nodes that are alive and not leaving, by their index
+   * on lane 0
+   */
+  std::vector<size_t> pickNodes(size_t count);
+
+  void crashNodes();
+
+  void leaveNodes();
+
+  void joinNodes();
+
+  /**
+   * Counts messages delivered to node and sender's reports
+   */
+  void setHandlers(size_t nodeIndex);
+
+  /**
+   * Nodes of other lanes are left out of token statistics
+   */
+  bool isOnFirstLane(size_t nodeIndex) const;
+
+  /**
+   * Node that has left goes down
+   */
+  void checkLeft(size_t nodeIndex);
+
+  void recordFrame(const Transport::Frame& frame, size_t nodeIndex);
+
+  void finishReport();
+
+ public:
+  explicit Simulation(const Configuration& configuration) noexcept(false);
+
+  Report run();
+};
+
+#endif  // SIMULATION_H
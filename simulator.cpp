@@ -0,0 +1,247 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "logger.h"
+#include "simulation.h"
+
+namespace {
+void printUsage(const char *programName) {
+  std::cerr
+      << "Usage: " << programName << " [options]" << std::endl
+      << "  --nodes <count>            ring size (default 1000)" << std::endl
+      << "  --duration-ms <ms>         virtual time to simulate (default 60000)"
+      << std::endl
+      << "  --seed <number>            random seed (default 1)" << std::endl
+      << "  --latency-us <us>          link latency (default 100)" << std::endl
+      << "  --jitter-us <us>           uniform extra link delay (default 0)"
+      << std::endl
+      << "  --loss <probability>       frame loss probability (default 0)"
+      << std::endl
+      << "  --reorder <probability>    frame reorder probability (default 0)"
+      << std::endl
+      << "  --reorder-delay-us <us>    delay of reordered frame (default 1000)"
+      << std::endl
+      << "  --greeting-ms <ms>         pause after greeting (default 0)"
+      << std::endl
+      << "  --retransmit-ms <ms>       DATA not back by then is sent again"
+      << std::endl
+      << "                             (default 500)" << std::endl
+      << "  --crash <count>            nodes crashed during run (default 0)"
+      << std::endl
+      << "  --crash-at-ms <ms>         time of crash (default 10000)"
+      << std::endl
+      << "  --leave <count>            nodes leaving during run (default 0)"
+      << std::endl
+      << "  --leave-at-ms <ms>         time of leave (default 10000)"
+      << std::endl
+      << "  --join <count>             nodes joining during run (default 0)"
+      << std::endl
+      << "  --join-at-ms <ms>          time of join (default 10000)"
+      << std::endl
+      << "  --message-interval-us <us> every node sends message this often"
+      << std::endl
+      << "                             (default 0, greetings only)"
+      << std::endl
+      << "  --message-size <bytes>     size of sent messages (default 32)"
+      << std::endl
+      << "  --direct-threshold <bytes> larger messages go straight to receiver"
+      << std::endl
+      << "                             (default 256)" << std::endl
+      << "  --dual-ring <on|off>       second, counter-rotating ring"
+      << " (default off)" << std::endl
+      << "  --lanes <count>            parallel rings, messages go to lane of"
+      << std::endl
+      << "                             receiver (default 1)" << std::endl
+      << "  --rings <count>            local rings joined by backbone ring"
+      << std::endl
+      << "                             (default 1)" << std::endl
+      << "  --racks <count>            nodes put into racks at random"
+      << " (default 1)" << std::endl
+      << "  --inter-rack-latency-us <us>" << std::endl
+      << "                             latency between racks (default 1000)"
+      << std::endl
+      << "  --reorder-ms <ms>          reorder ring by measured latencies this"
+      << std::endl
+      << "                             often (default 0, off)" << std::endl
+      << "  --verbose <on|off>         log protocol events (default off)"
+      << std::endl;
+}
+
+long long parseNumber(const std::string &name, const std::string &value) {
+  try {
+    size_t parsed = 0;
+    long long number = std::stoll(value, &parsed);
+    if (parsed == value.size() && number >= 0) {
+      return number;
+    }
+  } catch (const std::logic_error &) {
+  }
+
+  throw std::invalid_argument("Invalid value `" + value + "\' of " + name);
+}
+
+double parseProbability(const std::string &name, const std::string &value) {
+  try {
+    size_t parsed = 0;
+    double probability = std::stod(value, &parsed);
+    if (parsed == value.size() && probability >= 0.0 && probability <= 1.0) {
+      return probability;
+    }
+  } catch (const std::logic_error &) {
+  }
+
+  throw std::invalid_argument("Invalid probability `" + value + "\' of " +
+                              name);
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  using std::chrono::microseconds;
+  using std::chrono::milliseconds;
+
+  Simulation::Configuration configuration;
+  configuration.timing.greetingInterval = milliseconds{0};
+  // Rotation of simulated ring is much shorter than of real one
+  configuration.timing.retransmissionTimeout = milliseconds{500};
+  bool verbose = false;
+
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      std::string name = argv[i];
+      if (name == "-h" || name == "--help") {
+        printUsage(argv[0]);
+        return 0;
+      }
+
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value of " + name);
+      }
+      std::string value = argv[i + 1];
+
+      if (name == "--nodes") {
+        configuration.nodesCount = parseNumber(name, value);
+      } else if (name == "--duration-ms") {
+        configuration.duration = milliseconds{parseNumber(name, value)};
+      } else if (name == "--seed") {
+        configuration.seed = parseNumber(name, value);
+      } else if (name == "--latency-us") {
+        configuration.linkModel.latency = microseconds{parseNumber(name, value)};
+      } else if (name == "--jitter-us") {
+        configuration.linkModel.jitter = microseconds{parseNumber(name, value)};
+      } else if (name == "--loss") {
+        configuration.linkModel.lossProbability = parseProbability(name, value);
+      } else if (name == "--reorder") {
+        configuration.linkModel.reorderProbability =
+            parseProbability(name, value);
+      } else if (name == "--reorder-delay-us") {
+        configuration.linkModel.reorderDelay =
+            microseconds{parseNumber(name, value)};
+      } else if (name == "--greeting-ms") {
+        configuration.timing.greetingInterval =
+            milliseconds{parseNumber(name, value)};
+      } else if (name == "--retransmit-ms") {
+        configuration.timing.retransmissionTimeout =
+            milliseconds{parseNumber(name, value)};
+      } else if (name == "--crash") {
+        configuration.crashedNodesCount = parseNumber(name, value);
+      } else if (name == "--crash-at-ms") {
+        configuration.crashTime = milliseconds{parseNumber(name, value)};
+      } else if (name == "--leave") {
+        configuration.leavingNodesCount = parseNumber(name, value);
+      } else if (name == "--leave-at-ms") {
+        configuration.leaveTime = milliseconds{parseNumber(name, value)};
+      } else if (name == "--join") {
+        configuration.joiningNodesCount = parseNumber(name, value);
+      } else if (name == "--join-at-ms") {
+        configuration.joinTime = milliseconds{parseNumber(name, value)};
+      } else if (name == "--message-interval-us") {
+        configuration.messageInterval = microseconds{parseNumber(name, value)};
+      } else if (name == "--message-size") {
+        configuration.messageSize = parseNumber(name, value);
+      } else if (name == "--direct-threshold") {
+        configuration.directTransferThreshold = parseNumber(name, value);
+      } else if (name == "--dual-ring") {
+        configuration.dualRing =
+            value == "on" || value == "true" || value == "1";
+      } else if (name == "--lanes") {
+        configuration.lanesCount = parseNumber(name, value);
+      } else if (name == "--rings") {
+        configuration.ringsCount = parseNumber(name, value);
+      } else if (name == "--racks") {
+        configuration.racksCount = parseNumber(name, value);
+      } else if (name == "--inter-rack-latency-us") {
+        configuration.interRackLatency =
+            microseconds{parseNumber(name, value)};
+      } else if (name == "--reorder-ms") {
+        configuration.timing.reorderInterval =
+            milliseconds{parseNumber(name, value)};
+      } else if (name == "--verbose") {
+        verbose = value == "on" || value == "true" || value == "1";
+      } else {
+        throw std::invalid_argument("Unknown option " + name);
+      }
+    }
+  } catch (const std::invalid_argument &ex) {
+    std::cerr << ex.what() << std::endl;
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  Logger::getInstance().setEnabled(verbose);
+
+  Simulation::Report report;
+  auto wallClockStart = std::chrono::steady_clock::now();
+
+  try {
+    Simulation simulation(configuration);
+    report = simulation.run();
+  } catch (const std::runtime_error &ex) {
+    std::cerr << "Simulation failed: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  auto wallClockTime = std::chrono::duration_cast<milliseconds>(
+      std::chrono::steady_clock::now() - wallClockStart);
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "Nodes: " << report.nodesCount << " (" << report.aliveNodesCount
+            << " alive";
+  if (configuration.joiningNodesCount > 0) {
+    std::cout << ", " << report.joinedNodesCount << " joined";
+  }
+  std::cout << ")" << std::endl
+            << "Virtual time: " << report.duration.count() << " ms" << std::endl
+            << "Events: " << report.eventsCount << std::endl
+            << "Frames transmitted: " << report.framesTransmitted << std::endl
+            << "Bytes transmitted: " << report.bytesTransmitted << std::endl
+            << "Frames lost: " << report.framesLost << std::endl
+            << "Token passes: " << report.tokenPasses << std::endl
+            << "Rotation time avg/max: "
+            << report.averageRotationTime.count() << " / "
+            << report.maxRotationTime.count() << " us" << std::endl
+            << "Longest token gap: " << report.maxTokenGap.count() << " us"
+            << std::endl
+            << "Messages sent/delivered: " << report.messagesSent << " / "
+            << report.messagesDelivered << std::endl
+            << "Messages not delivered/out of order: "
+            << report.messagesNotDelivered << " / "
+            << report.messagesOutOfOrder << std::endl
+            << "Messages per DATA frame: "
+            << (report.dataFramesDelivered
+                    ? static_cast<double>(report.messagesDelivered) /
+                          report.dataFramesDelivered
+                    : 0.0)
+            << std::endl
+            << "Throughput: " << report.messagesPerSecond << " msgs/s"
+            << std::endl
+            << "Fairness (Jain): " << report.fairness << std::endl
+            << "Wall clock time: " << wallClockTime.count() << " ms"
+            << std::endl;
+
+  return 0;
+}
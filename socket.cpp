@@ -1,10 +1,19 @@
 #include "socket.h"
 
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
+#include <ctime>
+#include <functional>
 #include <iostream>
+#include <string>
 
 void Socket::getProtocolTypeFromSocketOpts(int descriptor) {
   int socketTypeOpt = 0;
@@ -95,11 +104,166 @@ int Socket::dataToRead() const {
   return count;
 }
 
+int Socket::getDescriptor() const { return socketDescriptor; }
+
+void Socket::setTcpNoDelay(bool enabled) noexcept(false) {
+  int value = enabled ? 1 : 0;
+
+  if (::setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &value,
+                   sizeof(value)) == -1) {
+    throw SocketOptionFailedException("Failed to set TCP_NODELAY");
+  }
+}
+
+void Socket::setReusePort(bool enabled) noexcept(false) {
+  int value = enabled ? 1 : 0;
+
+  if (::setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEPORT, &value,
+                   sizeof(value)) == -1) {
+    throw SocketOptionFailedException("Failed to set SO_REUSEPORT");
+  }
+}
+
+void Socket::setReceiveBufferSize(int size) noexcept(false) {
+  if (::setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVBUF, &size,
+                   sizeof(size)) == -1) {
+    throw SocketOptionFailedException("Failed to set SO_RCVBUF");
+  }
+}
+
+void Socket::setSendBufferSize(int size) noexcept(false) {
+  if (::setsockopt(socketDescriptor, SOL_SOCKET, SO_SNDBUF, &size,
+                   sizeof(size)) == -1) {
+    throw SocketOptionFailedException("Failed to set SO_SNDBUF");
+  }
+}
+
+int Socket::getReceiveBufferSize() const noexcept(false) {
+  int size = 0;
+  socklen_t length = sizeof(size);
+
+  if (::getsockopt(socketDescriptor, SOL_SOCKET, SO_RCVBUF, &size, &length) ==
+      -1) {
+    throw SocketOptionFailedException("Failed to get SO_RCVBUF");
+  }
+
+  return size;
+}
+
+int Socket::getSendBufferSize() const noexcept(false) {
+  int size = 0;
+  socklen_t length = sizeof(size);
+
+  if (::getsockopt(socketDescriptor, SOL_SOCKET, SO_SNDBUF, &size, &length) ==
+      -1) {
+    throw SocketOptionFailedException("Failed to get SO_SNDBUF");
+  }
+
+  return size;
+}
+
+void Socket::setDscp(int dscp) noexcept(false) {
+  if (dscp < 0 || dscp > 63) {
+    throw SocketOptionFailedException("DSCP has to be in range 0-63");
+  }
+
+  // DSCP is upper six bits of TOS, ECN bits are left to kernel
+  int tos = dscp << 2;
+  if (::setsockopt(socketDescriptor, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) ==
+      -1) {
+    throw SocketOptionFailedException("Failed to set IP_TOS");
+  }
+}
+
+void Socket::setBusyPoll(const std::chrono::microseconds &time) noexcept(
+    false) {
+  int value = static_cast<int>(time.count());
+
+  if (::setsockopt(socketDescriptor, SOL_SOCKET, SO_BUSY_POLL, &value,
+                   sizeof(value)) == -1) {
+    throw SocketOptionFailedException("Failed to set SO_BUSY_POLL");
+  }
+}
+
+void Socket::setReceiveTimestamps(bool enabled) noexcept(false) {
+  int value = enabled ? 1 : 0;
+
+  if (::setsockopt(socketDescriptor, SOL_SOCKET, SO_TIMESTAMPNS, &value,
+                   sizeof(value)) == -1) {
+    throw SocketOptionFailedException("Failed to set SO_TIMESTAMPNS");
+  }
+
+  receiveTimestamps = enabled;
+}
+
+void Socket::setNonBlocking(bool enabled) noexcept(false) {
+  int flags = ::fcntl(socketDescriptor, F_GETFL);
+  if (flags == -1) {
+    throw SocketOptionFailedException("Failed to get descriptor flags");
+  }
+
+  flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (::fcntl(socketDescriptor, F_SETFL, flags) == -1) {
+    throw SocketOptionFailedException("Failed to set O_NONBLOCK");
+  }
+}
+
+void Socket::setOptions(const SocketOptions &options) noexcept(false) {
+  std::string failures;
+
+  auto apply = [&failures](const std::function<void()> &setter) {
+    try {
+      setter();
+    } catch (const SocketOptionFailedException &ex) {
+      failures += (failures.empty() ? "" : ", ") + std::string(ex.what());
+    }
+  };
+
+  if (options.receiveBufferSize > 0) {
+    apply([&] { setReceiveBufferSize(options.receiveBufferSize); });
+  }
+  if (options.sendBufferSize > 0) {
+    apply([&] { setSendBufferSize(options.sendBufferSize); });
+  }
+  if (options.dscp >= 0) {
+    apply([&] { setDscp(options.dscp); });
+  }
+  if (options.busyPollTime > 0) {
+    apply([&] {
+      setBusyPoll(std::chrono::microseconds{options.busyPollTime});
+    });
+  }
+  if (options.receiveTimestamps) {
+    apply([&] { setReceiveTimestamps(true); });
+  }
+  if (options.nonBlocking) {
+    apply([&] { setNonBlocking(true); });
+  }
+
+  if (!failures.empty()) {
+    throw SocketOptionFailedException(failures);
+  }
+}
+
+Ip4 Socket::routeSourceFor(const Ip4 &destination) noexcept(false) {
+  // Connecting datagram socket sends nothing, it only looks route up
+  Socket probe(Protocol::UDP);
+  probe.connect(destination, 9);
+
+  return probe.getIp();
+}
+
 Socket::Socket(int descriptor) : socketDescriptor(descriptor) {
-  if (protocol == Protocol::TCP) {
+  // Destructor does not run when constructor throws
+  try {
     getProtocolTypeFromSocketOpts(descriptor);
 
-    getIpAndPortFromSocket(descriptor);
+    if (protocol == Protocol::TCP) {
+      getIpAndPortFromSocket(descriptor);
+    }
+  } catch (const SocketException &) {
+    close();
+    throw;
   }
 }
 
@@ -108,7 +272,12 @@ Socket::Socket(int descriptor, in_addr connectionAddress,
     : socketDescriptor(descriptor),
       connectionIp(Ip4(connectionAddress)),
       connectionPort(connectionPort) {
-  getProtocolTypeFromSocketOpts(descriptor);
+  try {
+    getProtocolTypeFromSocketOpts(descriptor);
+  } catch (const SocketException &) {
+    close();
+    throw;
+  }
 }
 
 Socket::Socket(Protocol protocol) noexcept(false) : protocol(protocol) {
@@ -125,46 +294,49 @@ Socket::Socket(Protocol protocol) noexcept(false) : protocol(protocol) {
     throw SocketInvalidProtocolException("Invalid protocol type");
   }
 
-  socketDescriptor = socket(AF_INET, socket_type, socket_protocol);
+  socketDescriptor =
+      ::socket(AF_INET, socket_type | SOCK_CLOEXEC, socket_protocol);
 
   if (socketDescriptor == -1) {
     throw SocketCreationFailedException("Failed to create socket");
   }
 
   if (protocol == Protocol::TCP) {
-    setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, nullptr, 0);
+    int reuseAddress = 1;
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuseAddress,
+               sizeof(reuseAddress));
   }
 }
 
-Socket::Socket(const Socket &other)
+Socket::Socket(Socket &&other) noexcept
     : protocol(other.protocol),
-      socketDescriptor(other.socketDescriptor),
+      socketDescriptor(other.release()),
       connectionIp(other.connectionIp),
-      connectionPort(other.connectionPort) {}
-
-Socket::Socket(Socket &&other)
-    : protocol(other.protocol),
-      socketDescriptor(other.socketDescriptor),
-      connectionIp(other.connectionIp),
-      connectionPort(other.connectionPort) {}
-
-Socket &Socket::operator=(const Socket &other) {
-  protocol = other.protocol;
-  socketDescriptor = other.socketDescriptor;
-  connectionIp = other.connectionIp;
-  connectionPort = other.connectionPort;
+      connectionPort(other.connectionPort),
+      receiveTimestamps(other.receiveTimestamps) {}
+
+Socket &Socket::operator=(Socket &&other) noexcept {
+  if (this != &other) {
+    close();
+
+    protocol = other.protocol;
+    socketDescriptor = other.release();
+    connectionIp = other.connectionIp;
+    connectionPort = other.connectionPort;
+    receiveTimestamps = other.receiveTimestamps;
+  }
   return *this;
 }
 
-Socket &Socket::operator=(Socket &&other) {
-  protocol = other.protocol;
-  socketDescriptor = other.socketDescriptor;
-  connectionIp = other.connectionIp;
-  connectionPort = other.connectionPort;
-  return *this;
-}
+Socket::~Socket() { close(); }
+
+bool Socket::empty() const { return socketDescriptor == -1; }
 
-Socket::~Socket() {}
+int Socket::release() noexcept {
+  int descriptor = socketDescriptor;
+  socketDescriptor = -1;
+  return descriptor;
+}
 
 void Socket::bind(const Ip4 &ip, unsigned short port) noexcept(false) {
   struct sockaddr_in socketAddressStruct;
@@ -210,6 +382,49 @@ void Socket::connect(const Ip4 &ip, unsigned short port) {
   connectionPort = port;
 }
 
+bool Socket::startConnect(const Ip4 &ip, unsigned short port) {
+  setNonBlocking(true);
+
+  struct sockaddr_in socketAddressStruct;
+
+  std::memset(&socketAddressStruct, 0, sizeof(struct sockaddr_in));
+
+  socketAddressStruct.sin_addr = ip;
+  socketAddressStruct.sin_port = htons(port);
+  socketAddressStruct.sin_family = AF_INET;
+
+  int ret = ::connect(socketDescriptor,
+                      reinterpret_cast<struct sockaddr *>(&socketAddressStruct),
+                      sizeof(socketAddressStruct));
+
+  if (ret == -1 && errno != EINPROGRESS) {
+    throw SocketConnectFailedException(
+        std::string("Failed to connect to specified ip and port: ") +
+        std::strerror(errno));
+  }
+
+  connectionIp = ip;
+  connectionPort = port;
+
+  return ret == 0;
+}
+
+void Socket::finishConnect() noexcept(false) {
+  int error = 0;
+  socklen_t errorSize = sizeof(error);
+
+  if (::getsockopt(socketDescriptor, SOL_SOCKET, SO_ERROR, &error,
+                   &errorSize) == -1) {
+    throw SocketConnectFailedException("Failed to get connection state");
+  }
+
+  if (error != 0) {
+    throw SocketConnectFailedException(
+        std::string("Failed to connect to specified ip and port: ") +
+        std::strerror(error));
+  }
+}
+
 void Socket::listen(int backlog) noexcept(false) {
   if (protocol == Protocol::TCP) {
     int ret = ::listen(socketDescriptor, backlog);
@@ -267,9 +482,9 @@ Socket Socket::accept() noexcept(false) {
   struct sockaddr_in incomingAddress;
   unsigned int incomingAddressSize = sizeof(incomingAddress);
 
-  descriptor = ::accept(socketDescriptor,
-                        reinterpret_cast<struct sockaddr *>(&incomingAddress),
-                        &incomingAddressSize);
+  descriptor = ::accept4(socketDescriptor,
+                         reinterpret_cast<struct sockaddr *>(&incomingAddress),
+                         &incomingAddressSize, SOCK_CLOEXEC);
 
   if (descriptor < 0) {
     throw SocketAcceptFailedException("Failed to accept connection");
@@ -279,15 +494,52 @@ Socket Socket::accept() noexcept(false) {
                 ntohs(incomingAddress.sin_port));
 }
 
-void Socket::send(const std::vector<unsigned char> &data) noexcept(false) {
-  ssize_t sentSize = 0;
+void Socket::send(const std::vector<unsigned char> &data,
+                  int flags) noexcept(false) {
+  size_t totalSentSize = 0;
+
+  while (totalSentSize < data.size()) {
+    ssize_t sentSize =
+        ::send(socketDescriptor, data.data() + totalSentSize,
+               data.size() - totalSentSize, flags | MSG_NOSIGNAL);
+
+    if (sentSize == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("Failed to send data");
+      throw SocketSendingFailedException("Failed to send data");
+    }
 
-  sentSize = ::send(socketDescriptor, data.data(), data.size(), 0);
+    totalSentSize += static_cast<size_t>(sentSize);
+  }
+}
 
-  if (sentSize == -1) {
-    perror("Failed to send data");
-    throw SocketSendingFailedException("Failed to send data");
+size_t Socket::sendAvailable(const std::vector<unsigned char> &data,
+                             size_t offset, int flags) noexcept(false) {
+  size_t totalSentSize = offset;
+
+  while (totalSentSize < data.size()) {
+    ssize_t sentSize =
+        ::send(socketDescriptor, data.data() + totalSentSize,
+               data.size() - totalSentSize,
+               flags | MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (sentSize == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      throw SocketSendingFailedException(
+          std::string("Failed to send data: ") + std::strerror(errno));
+    }
+
+    totalSentSize += static_cast<size_t>(sentSize);
   }
+
+  return totalSentSize - offset;
 }
 
 void Socket::sendTo(const std::vector<unsigned char> &data,
@@ -312,6 +564,46 @@ void Socket::sendTo(const std::vector<unsigned char> &data,
   }
 }
 
+void Socket::sendToMany(const std::vector<Datagram> &datagrams) noexcept(
+    false) {
+  std::vector<struct sockaddr_in> addresses(datagrams.size());
+  std::vector<struct iovec> buffers(datagrams.size());
+  std::vector<struct mmsghdr> messages(datagrams.size());
+
+  for (size_t i = 0; i < datagrams.size(); ++i) {
+    std::memset(&addresses[i], 0, sizeof(addresses[i]));
+    addresses[i].sin_addr = datagrams[i].address.first;
+    addresses[i].sin_port = htons(datagrams[i].address.second);
+    addresses[i].sin_family = AF_INET;
+
+    buffers[i].iov_base = const_cast<unsigned char *>(datagrams[i].data.data());
+    buffers[i].iov_len = datagrams[i].data.size();
+
+    std::memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_name = &addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    messages[i].msg_hdr.msg_iov = &buffers[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  size_t sentCount = 0;
+  while (sentCount < messages.size()) {
+    int ret = ::sendmmsg(socketDescriptor, messages.data() + sentCount,
+                         static_cast<unsigned int>(messages.size() - sentCount),
+                         MSG_NOSIGNAL);
+
+    if (ret == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw SocketSendingFailedException(
+          "Failed to send data to specified host");
+    }
+
+    sentCount += static_cast<size_t>(ret);
+  }
+}
+
 std::vector<unsigned char> Socket::receive(size_t bufferSize) noexcept(false) {
   std::vector<unsigned char> buffer;
   buffer.resize(bufferSize > 0 ? bufferSize : Socket::bufferSize);
@@ -353,8 +645,89 @@ Socket::receiveFrom(size_t bufferSize) noexcept(false) {
                         buffer);
 }
 
+size_t Socket::receiveFromMany(std::vector<Datagram> &output, size_t maxCount,
+                               size_t bufferSize) noexcept(false) {
+  if (maxCount == 0) {
+    return 0;
+  }
+
+  size_t firstIndex = output.size();
+  output.resize(firstIndex + maxCount);
+
+  std::vector<struct sockaddr_in> addresses(maxCount);
+  std::vector<struct iovec> buffers(maxCount);
+  std::vector<struct mmsghdr> messages(maxCount);
+
+  const size_t controlSize = CMSG_SPACE(sizeof(struct timespec));
+  std::vector<char> controls(receiveTimestamps ? maxCount * controlSize : 0);
+
+  for (size_t i = 0; i < maxCount; ++i) {
+    std::vector<unsigned char> &data = output[firstIndex + i].data;
+    data.resize(bufferSize > 0 ? bufferSize : Socket::bufferSize);
+
+    buffers[i].iov_base = data.data();
+    buffers[i].iov_len = data.size();
+
+    std::memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_name = &addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    messages[i].msg_hdr.msg_iov = &buffers[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+
+    if (receiveTimestamps) {
+      messages[i].msg_hdr.msg_control = controls.data() + i * controlSize;
+      messages[i].msg_hdr.msg_controllen = controlSize;
+    }
+  }
+
+  int ret = ::recvmmsg(socketDescriptor, messages.data(),
+                       static_cast<unsigned int>(maxCount), MSG_DONTWAIT,
+                       nullptr);
+
+  if (ret == -1) {
+    output.resize(firstIndex);
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return 0;
+    }
+    throw SocketReceivingFailedException("Failed to receive data from socket");
+  }
+
+  size_t receivedCount = static_cast<size_t>(ret);
+  for (size_t i = 0; i < receivedCount; ++i) {
+    Datagram &datagram = output[firstIndex + i];
+    datagram.address = std::make_pair(Ip4(addresses[i].sin_addr),
+                                      ntohs(addresses[i].sin_port));
+    datagram.data.resize(messages[i].msg_len);
+    datagram.receiveTimestamp = std::chrono::nanoseconds{0};
+
+    struct msghdr &header = messages[i].msg_hdr;
+    for (struct cmsghdr *control = CMSG_FIRSTHDR(&header); control;
+         control = CMSG_NXTHDR(&header, control)) {
+      if (control->cmsg_level == SOL_SOCKET &&
+          control->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec time;
+        std::memcpy(&time, CMSG_DATA(control), sizeof(time));
+        datagram.receiveTimestamp = std::chrono::seconds{time.tv_sec} +
+                                    std::chrono::nanoseconds{time.tv_nsec};
+      }
+    }
+  }
+  output.resize(firstIndex + receivedCount);
+
+  return receivedCount;
+}
+
 void Socket::disconnect() noexcept {
   ::shutdown(this->socketDescriptor, SHUT_RDWR);
 }
 
-void Socket::close() noexcept { ::close(socketDescriptor); }
+void Socket::close() noexcept {
+  if (socketDescriptor != -1) {
+    ::close(socketDescriptor);
+    socketDescriptor = -1;
+  }
+}
+
+SocketView::SocketView(const Socket &socket)
+    : socketDescriptor(socket.getDescriptor()) {}
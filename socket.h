@@ -35,19 +35,98 @@ using SocketSendingFailedException = SocketException;
 
 using SocketReceivingFailedException = SocketException;
 
+using SocketOptionFailedException = SocketException;
+
+/**
+ * Socket tuning. Zero (or -1 for DSCP) keeps system default.
+ */
+struct SocketOptions {
+  int receiveBufferSize{0};  // SO_RCVBUF, bytes
+  int sendBufferSize{0};     // SO_SNDBUF, bytes
+  int dscp{-1};              // IP_TOS DiffServ code point, 0-63
+  int busyPollTime{0};       // SO_BUSY_POLL, microseconds
+  bool receiveTimestamps{false};  // SO_TIMESTAMPNS
+  bool nonBlocking{false};
+
+  /**
+   * Options that matter for socket that only receives
+   */
+  SocketOptions receivingOptions() const {
+    SocketOptions options = *this;
+    options.sendBufferSize = 0;
+    options.dscp = -1;
+    return options;
+  }
+
+  /**
+   * Options that matter for socket that only sends
+   */
+  SocketOptions sendingOptions() const {
+    SocketOptions options;
+    options.sendBufferSize = sendBufferSize;
+    options.dscp = dscp;
+    return options;
+  }
+};
+
+class Socket;
+
+/**
+ * Non-owning reference to socket descriptor, for code that only waits on or
+ * inspects socket. Has to be dropped before the socket is closed.
+ */
+class SocketView {
+ private:
+  int socketDescriptor{-1};
+
+ public:
+  SocketView() = default;
+
+  explicit SocketView(int descriptor) : socketDescriptor(descriptor) {}
+
+  SocketView(const Socket& socket);
+
+  int getDescriptor() const { return socketDescriptor; }
+
+  bool empty() const { return socketDescriptor == -1; }
+
+  bool operator==(const SocketView& other) const {
+    return socketDescriptor == other.socketDescriptor;
+  }
+
+  bool operator!=(const SocketView& other) const { return !(*this == other); }
+};
+
+/**
+ * Owns socket descriptor, closes it on destruction. Move only, moved-from
+ * socket is empty.
+ */
 class Socket {
  public:
   static const int bufferSize = 1024;
 
   using IpAndPortPair = std::pair<Ip4, unsigned short>;
 
+  /**
+   * Address is destination of sent datagram and source of received one
+   */
+  struct Datagram {
+    IpAndPortPair address;
+    std::vector<unsigned char> data;
+    // Kernel receive time (CLOCK_REALTIME), zero if timestamps are disabled.
+    // Transport moves it to steady_clock, see Transport::Frame.
+    std::chrono::nanoseconds receiveTimestamp{0};
+  };
+
  private:
   Protocol protocol = Protocol::NONE;
-  int socketDescriptor;
+  int socketDescriptor{-1};
 
   Ip4 connectionIp{0};
   unsigned short connectionPort{0};
 
+  bool receiveTimestamps{false};
+
  private:
   explicit Socket(int descriptor) noexcept(false);
 
@@ -57,22 +136,46 @@ class Socket {
  public:
   explicit Socket(Protocol protocol) noexcept(false);
 
-  Socket(const Socket&);
-  explicit Socket(Socket&&);
+  /**
+   * Empty socket, owns nothing
+   */
+  Socket() = default;
+
+  Socket(const Socket&) = delete;
+  Socket(Socket&& other) noexcept;
 
-  Socket& operator=(const Socket&);
-  Socket& operator=(Socket&&);
+  Socket& operator=(const Socket&) = delete;
+  Socket& operator=(Socket&& other) noexcept;
 
   ~Socket();
 
+  bool empty() const;
+
+  /**
+   * Gives descriptor up, caller becomes responsible for closing it
+   */
+  int release() noexcept;
+
   void bind(const Ip4& ip, unsigned short port) noexcept(false);
 
   void connect(const Ip4& ip, unsigned short port) noexcept(false);
 
+  /**
+   * Connects without waiting, socket is made non-blocking. Returns false
+   * while connection is being set up, socket becomes writable when it is
+   * done and finishConnect() tells how it ended.
+   */
+  bool startConnect(const Ip4& ip, unsigned short port) noexcept(false);
+
+  /**
+   * Throws if connection started by startConnect() failed
+   */
+  void finishConnect() noexcept(false);
+
   void listen(int backlog = 50) noexcept(false);
 
   /**
-   * Select without timeout
+   * Select without timeout. Accepts and returns waiting connection.
    */
   Socket select() noexcept(false);
 
@@ -82,18 +185,44 @@ class Socket {
 
   Socket accept() noexcept(false);
 
-  void send(const std::vector<unsigned char>& data) noexcept(false);
+  /**
+   * Sends whole buffer. Flags are passed to ::send (e.g. MSG_MORE).
+   */
+  void send(const std::vector<unsigned char>& data,
+            int flags = 0) noexcept(false);
+
+  /**
+   * Sends data from offset on without blocking, as much as socket buffer
+   * takes. Returns number of bytes sent.
+   */
+  size_t sendAvailable(const std::vector<unsigned char>& data, size_t offset,
+                       int flags = 0) noexcept(false);
 
   void sendTo(const std::vector<unsigned char>& data, const Ip4& destination,
               unsigned short port) noexcept(false);
 
+  /**
+   * Sends datagrams with as few system calls as possible (sendmmsg)
+   */
+  void sendToMany(const std::vector<Datagram>& datagrams) noexcept(false);
+
   std::vector<unsigned char> receive(size_t bufferSize = 0) noexcept(false);
 
   std::pair<IpAndPortPair, std::vector<unsigned char>> receiveFrom(size_t bufferSize = 0) noexcept(
       false);
 
+  /**
+   * Receives up to maxCount waiting datagrams without blocking (recvmmsg).
+   * Returns number of datagrams appended to output.
+   */
+  size_t receiveFromMany(std::vector<Datagram>& output, size_t maxCount,
+                         size_t bufferSize) noexcept(false);
+
   void disconnect() noexcept;
 
+  /**
+   * Closes descriptor now, socket becomes empty
+   */
   void close() noexcept;
 
   Ip4 getConnectionIp() const;
@@ -108,6 +237,53 @@ class Socket {
 
   int dataToRead() const;
 
+  int getDescriptor() const;
+
+  void setTcpNoDelay(bool enabled) noexcept(false);
+
+  /**
+   * Lets several sockets bind the same address and port, has to be set
+   * before bind
+   */
+  void setReusePort(bool enabled) noexcept(false);
+
+  void setReceiveBufferSize(int size) noexcept(false);
+
+  void setSendBufferSize(int size) noexcept(false);
+
+  int getReceiveBufferSize() const noexcept(false);
+
+  int getSendBufferSize() const noexcept(false);
+
+  /**
+   * Marks outgoing packets with DiffServ code point (0-63)
+   */
+  void setDscp(int dscp) noexcept(false);
+
+  /**
+   * Busy polls device queue up to time when receiving, needs
+   * CAP_NET_ADMIN to exceed net.core.busy_read
+   */
+  void setBusyPoll(const std::chrono::microseconds& time) noexcept(false);
+
+  /**
+   * Kernel receive timestamps, filled in by receiveFromMany()
+   */
+  void setReceiveTimestamps(bool enabled) noexcept(false);
+
+  void setNonBlocking(bool enabled) noexcept(false);
+
+  /**
+   * Applies every option that differs from default. All options are tried,
+   * exception lists those that failed.
+   */
+  void setOptions(const SocketOptions& options) noexcept(false);
+
+  /**
+   * Local address kernel picks when sending to destination
+   */
+  static Ip4 routeSourceFor(const Ip4& destination) noexcept(false);
+
  private:
   Socket select(struct timeval* tv) noexcept(false);
 
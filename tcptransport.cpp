@@ -0,0 +1,354 @@
+#include "tcptransport.h"
+#include "logger.h"
+
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace {
+const int maxEventsPerPoll = 64;
+
+// Connection that is not set up by then is dropped on next send, so it is
+// tried again once host comes back
+const std::chrono::milliseconds connectTimeout{1000};
+}  // namespace
+
+const size_t TCPTransport::OutgoingBufferSize;
+
+TCPTransport::TCPTransport(const ProgramArguments& programArguments)
+    : programArguments(programArguments),
+      inputSocketPort(programArguments.getPort()),
+      listenSocket(Protocol::TCP) {}
+
+TCPTransport::~TCPTransport() {
+  if (epollDescriptor != -1) {
+    ::close(epollDescriptor);
+  }
+}
+
+void TCPTransport::open() {
+  if (programArguments.useReusePort()) {
+    listenSocket.setReusePort(true);
+  }
+  // Accepted connections inherit receive buffer size from listening socket
+  SocketOptions listenOptions =
+      programArguments.getSocketOptions().receivingOptions();
+  listenOptions.receiveTimestamps = false;
+  try {
+    listenSocket.setOptions(listenOptions);
+  } catch (const SocketOptionFailedException& ex) {
+    Logger::getInstance().log(std::string("Socket options ignored: ") +
+                              ex.what());
+  }
+  listenSocket.bind(programArguments.getBindIp(), inputSocketPort);
+  listenSocket.listen();
+
+  advertisedIp = resolveAdvertisedIp(programArguments, listenSocket.getIp());
+
+  epollDescriptor = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epollDescriptor == -1) {
+    throw TransportOpenFailedException("Failed to create epoll instance");
+  }
+
+  if (!watch(listenSocket)) {
+    throw TransportOpenFailedException("Failed to watch listening socket");
+  }
+}
+
+bool TCPTransport::watch(SocketView socket) {
+  struct epoll_event event {};
+  event.events = EPOLLIN;
+  event.data.fd = socket.getDescriptor();
+
+  return ::epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, event.data.fd, &event) !=
+         -1;
+}
+
+bool TCPTransport::rewatch(SocketView socket, uint32_t events) {
+  struct epoll_event event {};
+  event.events = events;
+  event.data.fd = socket.getDescriptor();
+
+  return ::epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, event.data.fd, &event) !=
+         -1;
+}
+
+Ip4 TCPTransport::getLocalIp() const { return advertisedIp; }
+
+unsigned short TCPTransport::getLocalPort() const {
+  return listenSocket.getPort();
+}
+
+TCPTransport::OutgoingConnection& TCPTransport::getOutgoingConnection(
+    const Ip4& ip, unsigned short port) noexcept(false) {
+  ConnectionKey key = std::make_pair(ip.s_addr, port);
+
+  auto it = outgoingConnections.find(key);
+  if (it != outgoingConnections.end()) {
+    if (it->second.connected ||
+        std::chrono::steady_clock::now() < it->second.connectDeadline) {
+      return it->second;
+    }
+
+    Logger::getInstance().log(std::string("Connecting to ") +
+                              ::to_string(ip) + ":" + std::to_string(port) +
+                              " timed out. Dropping queued frames.");
+    closeOutgoingConnection(key);
+  }
+
+  OutgoingConnection connection;
+  connection.socket = Socket(Protocol::TCP);
+  try {
+    connection.socket.setTcpNoDelay(true);
+    connection.socket.setOptions(
+        programArguments.getSocketOptions().sendingOptions());
+    connection.connected = connection.socket.startConnect(ip, port);
+  } catch (const SocketException& ex) {
+    throw TransportSendingFailedException(
+        std::string("Failed to connect to ") + ::to_string(ip) + ":" +
+        std::to_string(port) + ": " + ex.what());
+  }
+  connection.connectDeadline =
+      std::chrono::steady_clock::now() + connectTimeout;
+
+  SocketView view = connection.socket;
+  if (!watch(view)) {
+    throw TransportSendingFailedException("Failed to watch connection");
+  }
+  outgoingDescriptors[view.getDescriptor()] = key;
+
+  return outgoingConnections[key] = std::move(connection);
+}
+
+void TCPTransport::flushOutgoingConnection(
+    OutgoingConnection& connection) noexcept(false) {
+  if (connection.connected) {
+    connection.sentSize += connection.socket.sendAvailable(
+        connection.buffer, connection.sentSize);
+
+    if (connection.sentSize == connection.buffer.size()) {
+      connection.buffer.clear();
+      connection.sentSize = 0;
+    }
+  }
+
+  // Incoming data is not expected, EPOLLIN only reports peer closing
+  bool waitForWrite = !connection.buffer.empty() || !connection.connected;
+  if (waitForWrite != connection.waitingForWrite) {
+    rewatch(connection.socket, waitForWrite ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    connection.waitingForWrite = waitForWrite;
+  }
+}
+
+void TCPTransport::handleOutgoingConnectionEvent(int descriptor,
+                                                 uint32_t events) {
+  ConnectionKey key = outgoingDescriptors[descriptor];
+  OutgoingConnection& connection = outgoingConnections[key];
+
+  try {
+    if (!connection.connected) {
+      connection.socket.finishConnect();
+      connection.connected = true;
+    }
+
+    // Peer never sends on this connection, readable means it was closed
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      throw SocketSendingFailedException("Connection closed by peer");
+    }
+
+    flushOutgoingConnection(connection);
+  } catch (const SocketException& ex) {
+    Logger::getInstance().log(std::string("Outgoing connection failed: ") +
+                              ex.what());
+    closeOutgoingConnection(key);
+  }
+}
+
+void TCPTransport::closeOutgoingConnection(const ConnectionKey& key) {
+  auto it = outgoingConnections.find(key);
+  if (it == outgoingConnections.end()) {
+    return;
+  }
+
+  int descriptor = it->second.socket.getDescriptor();
+  ::epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+  outgoingDescriptors.erase(descriptor);
+  outgoingConnections.erase(it);
+}
+
+void TCPTransport::send(const std::vector<Frame>& frames) noexcept(false) {
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const Frame& frame = frames[i];
+    const Ip4& ip = frame.address.first;
+    unsigned short port = frame.address.second;
+
+    OutgoingConnection& connection = getOutgoingConnection(ip, port);
+
+    Serializable::container_type& buffer = connection.buffer;
+    if (buffer.size() + sizeof(FrameLength_t) + frame.data.size() >
+        OutgoingBufferSize) {
+      throw TransportSendingFailedException(
+          std::string("Too many frames waiting for ") + ::to_string(ip) +
+          ":" + std::to_string(port));
+    }
+
+    FrameLength_t frameLength =
+        htonl(static_cast<FrameLength_t>(frame.data.size()));
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(frameLength) + frame.data.size());
+    std::memcpy(buffer.data() + offset, &frameLength, sizeof(frameLength));
+    std::memcpy(buffer.data() + offset + sizeof(frameLength),
+                frame.data.data(), frame.data.size());
+
+    // Consecutive frames for the same host go out in one send
+    bool more = i + 1 < frames.size() &&
+                frames[i + 1].address.first.s_addr == ip.s_addr &&
+                frames[i + 1].address.second == port;
+    if (more) {
+      continue;
+    }
+
+    try {
+      flushOutgoingConnection(connection);
+    } catch (const SocketSendingFailedException&) {
+      closeOutgoingConnection(std::make_pair(ip.s_addr, port));
+      throw;
+    }
+  }
+}
+
+void TCPTransport::acceptIncomingConnection() {
+  try {
+    IncomingConnection connection;
+    connection.socket = listenSocket.accept();
+    connection.socket.setTcpNoDelay(true);
+    if (programArguments.getSocketOptions().busyPollTime > 0) {
+      connection.socket.setBusyPoll(std::chrono::microseconds{
+          programArguments.getSocketOptions().busyPollTime});
+    }
+
+    SocketView view = connection.socket;
+    if (!watch(view)) {
+      throw SocketAcceptFailedException("Failed to watch connection");
+    }
+
+    incomingConnections[view.getDescriptor()] = std::move(connection);
+  } catch (const SocketException& ex) {
+    Logger::getInstance().log(std::string("Accepting connection failed: ") +
+                              ex.what());
+  }
+}
+
+void TCPTransport::closeIncomingConnection(int descriptor) {
+  auto it = incomingConnections.find(descriptor);
+  if (it == incomingConnections.end()) {
+    return;
+  }
+
+  ::epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+  incomingConnections.erase(it);
+}
+
+bool TCPTransport::readFromIncomingConnection(IncomingConnection& connection) {
+  Serializable::container_type data;
+  try {
+    data = connection.socket.receive(ReceiveBufferSize);
+  } catch (const SocketReceivingFailedException&) {
+    return false;
+  }
+
+  if (data.empty()) {
+    return false;
+  }
+
+  Serializable::container_type& buffer = connection.buffer;
+  buffer.insert(buffer.end(), data.begin(), data.end());
+
+  size_t offset = 0;
+  while (buffer.size() - offset >= sizeof(FrameLength_t)) {
+    FrameLength_t frameLength;
+    std::memcpy(&frameLength, buffer.data() + offset, sizeof(frameLength));
+    frameLength = ntohl(frameLength);
+
+    if (frameLength > MaxFrameSize) {
+      Logger::getInstance().log(
+          "Invalid frame length received. Closing connection.");
+      return false;
+    }
+
+    if (buffer.size() - offset - sizeof(frameLength) < frameLength) {
+      break;
+    }
+
+    offset += sizeof(frameLength);
+
+    Frame frame;
+    frame.address = std::make_pair(connection.socket.getConnectionIp(),
+                                   connection.socket.getConnectionPort());
+    frame.data.assign(buffer.begin() + offset,
+                      buffer.begin() + offset + frameLength);
+    receivedFrames.push(std::move(frame));
+
+    offset += frameLength;
+  }
+  buffer.erase(buffer.begin(), buffer.begin() + offset);
+
+  return true;
+}
+
+void TCPTransport::pollIncomingConnections() noexcept(false) {
+  struct epoll_event events[maxEventsPerPoll];
+
+  int ret = ::epoll_wait(epollDescriptor, events, maxEventsPerPoll, 0);
+  if (ret == -1) {
+    if (errno == EINTR) {
+      return;
+    }
+    throw TransportReceivingFailedException("Failed to poll connections");
+  }
+
+  for (int i = 0; i < ret; ++i) {
+    int descriptor = events[i].data.fd;
+
+    if (descriptor == listenSocket.getDescriptor()) {
+      acceptIncomingConnection();
+      continue;
+    }
+
+    if (outgoingDescriptors.count(descriptor) > 0) {
+      handleOutgoingConnectionEvent(descriptor, events[i].events);
+      continue;
+    }
+
+    auto it = incomingConnections.find(descriptor);
+    if (it != incomingConnections.end() &&
+        !readFromIncomingConnection(it->second)) {
+      closeIncomingConnection(descriptor);
+    }
+  }
+}
+
+size_t TCPTransport::receive(std::vector<Frame>& output,
+                             size_t maxFrames) noexcept(false) {
+  if (receivedFrames.size() < maxFrames) {
+    pollIncomingConnections();
+  }
+
+  size_t receivedCount = 0;
+  while (receivedCount < maxFrames && !receivedFrames.empty()) {
+    output.push_back(std::move(receivedFrames.front()));
+    receivedFrames.pop();
+    ++receivedCount;
+  }
+
+  return receivedCount;
+}
+
+int TCPTransport::getReadinessDescriptor() const { return epollDescriptor; }
+
+bool TCPTransport::prepareToWait() { return receivedFrames.empty(); }
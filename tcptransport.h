@@ -0,0 +1,132 @@
+#ifndef TCPTRANSPORT_H
+#define TCPTRANSPORT_H
+
+#include <cstdint>
+
+#include <chrono>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "programarguments.h"
+#include "socket.h"
+#include "tokenringpacket.h"
+#include "transport.h"
+
+/**
+ * Token ring over persistent TCP connections. Every frame is prefixed with
+ * its length (FrameLength_t, network byte order).
+ *
+ * Sending never blocks. Outgoing connections are set up in the background
+ * and frames wait in per-host buffer until connection takes them, so dead
+ * successor does not stall timers of the engine.
+ */
+class TCPTransport : public Transport {
+ public:
+  using FrameLength_t = uint32_t;
+
+  static const size_t MaxFrameSize =
+      sizeof(TokenRingPacket::Header) + TokenRingPacket::DataMaxSize;
+
+  static const size_t ReceiveBufferSize = 64 * 1024;
+
+  // Frames over this size waiting for one host are refused
+  static const size_t OutgoingBufferSize = 1024 * 1024;
+
+  // Private variables
+ private:
+  struct IncomingConnection {
+    Socket socket;
+    Serializable::container_type buffer;
+  };
+
+  using ConnectionKey = std::pair<in_addr_t, unsigned short>;
+
+  const ProgramArguments& programArguments;
+
+  unsigned short inputSocketPort;
+  Ip4 advertisedIp{};
+
+  Socket listenSocket;
+
+  // Waits for listening socket and all incoming connections at once
+  int epollDescriptor{-1};
+
+  // Keyed by descriptor
+  std::map<int, IncomingConnection> incomingConnections;
+  std::queue<Frame> receivedFrames;
+
+  struct OutgoingConnection {
+    Socket socket;
+    bool connected{false};
+    std::chrono::steady_clock::time_point connectDeadline;
+    // Frames not taken by socket yet, sentSize bytes of them are sent
+    Serializable::container_type buffer;
+    size_t sentSize{0};
+    // Socket is watched for writability
+    bool waitingForWrite{false};
+  };
+
+  std::map<ConnectionKey, OutgoingConnection> outgoingConnections;
+  // Outgoing connection of epoll event, keyed by descriptor
+  std::map<int, ConnectionKey> outgoingDescriptors;
+
+  // Private methods
+ private:
+  OutgoingConnection& getOutgoingConnection(
+      const Ip4& ip, unsigned short port) noexcept(false);
+
+  /**
+   * Sends buffered frames as far as socket takes them, watches socket for
+   * writability if some are left
+   */
+  void flushOutgoingConnection(OutgoingConnection& connection) noexcept(false);
+
+  void handleOutgoingConnectionEvent(int descriptor, uint32_t events);
+
+  void closeOutgoingConnection(const ConnectionKey& key);
+
+  /**
+   * Adds socket to epoll set, returns false on failure
+   */
+  bool watch(SocketView socket);
+
+  /**
+   * Changes events socket is watched for, returns false on failure
+   */
+  bool rewatch(SocketView socket, uint32_t events);
+
+  void acceptIncomingConnection();
+
+  void closeIncomingConnection(int descriptor);
+
+  /**
+   * Returns false when connection was closed
+   */
+  bool readFromIncomingConnection(IncomingConnection& connection);
+
+  void pollIncomingConnections() noexcept(false);
+
+ public:
+  TCPTransport(const ProgramArguments& programArguments);
+
+  ~TCPTransport() override;
+
+  void open() noexcept(false) override;
+
+  Ip4 getLocalIp() const override;
+
+  unsigned short getLocalPort() const override;
+
+  void send(const std::vector<Frame>& frames) noexcept(false) override;
+
+  size_t receive(std::vector<Frame>& output,
+                 size_t maxFrames) noexcept(false) override;
+
+  int getReadinessDescriptor() const override;
+
+  bool prepareToWait() override;
+};
+
+#endif  // TCPTRANSPORT_H
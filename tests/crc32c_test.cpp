@@ -0,0 +1,69 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "crc32c.h"
+#include "testing.h"
+
+namespace {
+uint32_t checksum(const std::vector<unsigned char>& data) {
+  return Crc32c::extend(0, data.data(), data.size());
+}
+
+std::vector<unsigned char> pattern(size_t size) {
+  std::vector<unsigned char> data(size);
+  uint32_t state = 1;
+  for (unsigned char& byte : data) {
+    state = state * 1103515245u + 12345u;
+    byte = static_cast<unsigned char>(state >> 24);
+  }
+  return data;
+}
+
+void testCheckValue() {
+  const char* input = "123456789";
+  CHECK(Crc32c::extend(0, input, std::strlen(input)) == 0xE3069283u);
+  CHECK(Crc32c::extend(0, input, 0) == 0);
+}
+
+void testExtendInParts() {
+  // Sizes around the 8 byte steps of every implementation
+  for (size_t size : {1u, 7u, 8u, 9u, 63u, 64u, 65u, 1000u, 4099u}) {
+    std::vector<unsigned char> data = pattern(size);
+
+    for (size_t split : {size_t{0}, size / 3, size / 2, size - 1, size}) {
+      uint32_t crc = Crc32c::extend(0, data.data(), split);
+      crc = Crc32c::extend(crc, data.data() + split, size - split);
+      CHECK(crc == checksum(data));
+    }
+  }
+}
+
+void testReplace() {
+  std::vector<unsigned char> data = pattern(600);
+  uint32_t crc = checksum(data);
+
+  // Like forwarding host rewriting header fields
+  for (size_t offset : {size_t{0}, size_t{17}, size_t{590}}) {
+    for (size_t size : {size_t{1}, size_t{4}, size_t{10}}) {
+      std::vector<unsigned char> changed = data;
+      for (size_t i = 0; i < size; ++i) {
+        changed[offset + i] = static_cast<unsigned char>(~data[offset + i]);
+      }
+
+      uint32_t replaced =
+          Crc32c::replace(crc, data.data() + offset, changed.data() + offset,
+                          size, data.size() - offset - size);
+      CHECK(replaced == checksum(changed));
+    }
+  }
+}
+}  // namespace
+
+int main() {
+  testCheckValue();
+  testExtendInParts();
+  testReplace();
+
+  return testing::finish();
+}
@@ -0,0 +1,164 @@
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "deliverydispatcher.h"
+#include "testing.h"
+
+namespace {
+TokenRingEngine::ReceivedMessage createMessage(
+    const std::string& receiverName, const std::string& data) {
+  TokenRingEngine::ReceivedMessage message;
+  message.senderName = "A";
+  message.receiverName = receiverName;
+  message.messageId = 1;
+  message.data = reinterpret_cast<const unsigned char*>(data.data());
+  message.size = data.size();
+  return message;
+}
+
+/**
+ * Consumer that records messages, first one waits until test opens it. It
+ * does not take first messages offered while refusals last, empty one throws.
+ */
+class Consumer {
+ public:
+  std::mutex mutex;
+  std::vector<std::string> messages;
+
+  std::promise<void> entered;
+  std::shared_future<void> opened;
+  bool blocking{false};
+  int refusals{0};
+
+  explicit Consumer(std::shared_future<void> opened = {})
+      : opened(opened), blocking(opened.valid()) {}
+
+  DeliveryDispatcher::Handler handler() {
+    return [this](const DeliveryDispatcher::Message& message) {
+      if (blocking) {
+        blocking = false;
+        entered.set_value();
+        opened.wait();
+      }
+
+      if (refusals > 0) {
+        --refusals;
+        return false;
+      }
+      if (message.data.empty()) {
+        throw std::runtime_error("Empty message");
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      messages.emplace_back(message.data.begin(), message.data.end());
+      return true;
+    };
+  }
+};
+
+void testMessagesInOrder() {
+  Consumer all;
+  Consumer onlyB;
+  onlyB.refusals = 3;
+
+  {
+    DeliveryDispatcher dispatcher(2);
+    dispatcher.addConsumer("all", all.handler(), {});
+    DeliveryDispatcher::ConsumerOptions options;
+    options.receiverName = "B";
+    dispatcher.addConsumer("B", onlyB.handler(), options);
+
+    CHECK_THROWS(dispatcher.addConsumer("B", onlyB.handler(), options),
+                 DeliveryDispatcherDuplicateConsumerException);
+
+    for (int i = 0; i < 100; ++i) {
+      CHECK(dispatcher.dispatch(createMessage(
+                i % 2 ? "B" : "C", std::to_string(i))) ==
+            TokenRingEngine::MessageHandling::TAKEN);
+    }
+    CHECK(dispatcher.dispatch(createMessage("B", "")) ==
+          TokenRingEngine::MessageHandling::TAKEN);
+
+    // Stop does not wait for messages offered again
+    DeliveryDispatcher::Statistics statistics;
+    do {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      statistics = dispatcher.getStatistics("B");
+    } while (statistics.handled + statistics.failed < 51);
+    dispatcher.stop();
+
+    statistics = dispatcher.getStatistics("B");
+    CHECK(statistics.handled == 50);
+    CHECK(statistics.failed == 1);
+    CHECK(statistics.retried == 3);
+    CHECK(statistics.queued == 0);
+  }
+
+  CHECK(all.messages.size() == 100);
+  CHECK(onlyB.messages.size() == 50);
+  for (int i = 0; i < 100; ++i) {
+    CHECK(all.messages[i] == std::to_string(i));
+  }
+  for (int i = 0; i < 50; ++i) {
+    CHECK(onlyB.messages[i] == std::to_string(2 * i + 1));
+  }
+}
+
+void checkOverflow(OverflowPolicy policy,
+                   const std::vector<std::string>& expectedMessages) {
+  std::promise<void> open;
+  Consumer consumer(open.get_future().share());
+
+  DeliveryDispatcher dispatcher(1);
+  DeliveryDispatcher::ConsumerOptions options;
+  options.queueCapacity = 2;
+  options.overflowPolicy = policy;
+  options.receiverName = "B";
+  dispatcher.addConsumer("slow", consumer.handler(), options);
+
+  CHECK(dispatcher.dispatch(createMessage("C", "m0")) ==
+        TokenRingEngine::MessageHandling::REFUSED);
+
+  // The first one is taken by worker, which waits
+  CHECK(dispatcher.dispatch(createMessage("B", "m1")) ==
+        TokenRingEngine::MessageHandling::TAKEN);
+  consumer.entered.get_future().wait();
+
+  CHECK(dispatcher.dispatch(createMessage("B", "m2")) ==
+        TokenRingEngine::MessageHandling::TAKEN);
+  CHECK(dispatcher.dispatch(createMessage("B", "m3")) ==
+        TokenRingEngine::MessageHandling::TAKEN);
+  // Queued messages are never dropped for it
+  CHECK(dispatcher.dispatch(createMessage("B", "m4")) ==
+        (policy == OverflowPolicy::REJECT
+             ? TokenRingEngine::MessageHandling::BUSY
+             : TokenRingEngine::MessageHandling::REFUSED));
+
+  open.set_value();
+  dispatcher.stop();
+
+  DeliveryDispatcher::Statistics statistics =
+      dispatcher.getStatistics("slow");
+  CHECK(statistics.maxQueued == 2);
+  CHECK(statistics.rejected == (policy == OverflowPolicy::REJECT ? 1u : 0u));
+  CHECK(statistics.dropped == (policy == OverflowPolicy::REJECT ? 0u : 1u));
+  CHECK(consumer.messages == expectedMessages);
+}
+
+void testOverflow() {
+  checkOverflow(OverflowPolicy::REJECT, {"m1", "m2", "m3"});
+  checkOverflow(OverflowPolicy::DROP_NEWEST, {"m1", "m2", "m3"});
+}
+}  // namespace
+
+int main() {
+  testMessagesInOrder();
+  testOverflow();
+
+  return testing::finish();
+}
@@ -0,0 +1,96 @@
+#include <string>
+#include <vector>
+
+#include "lzcodec.h"
+#include "testing.h"
+
+namespace {
+std::vector<unsigned char> toBytes(const std::string& text) {
+  return std::vector<unsigned char>(text.begin(), text.end());
+}
+
+std::vector<unsigned char> noise(size_t size) {
+  std::vector<unsigned char> data(size);
+  uint32_t state = 7;
+  for (unsigned char& byte : data) {
+    state = state * 1103515245u + 12345u;
+    byte = static_cast<unsigned char>(state >> 24);
+  }
+  return data;
+}
+
+void checkRoundTrip(const std::vector<unsigned char>& input) {
+  std::vector<unsigned char> compressed;
+  CHECK(LZCodec::compress(input, compressed, input.size()));
+  CHECK(compressed.size() < input.size());
+  CHECK(LZCodec::decompress(compressed, input.size()) == input);
+}
+
+void testRoundTrip() {
+  checkRoundTrip(std::vector<unsigned char>(1000, 'a'));
+
+  std::string text;
+  for (int i = 0; i < 50; ++i) {
+    text += "Greetings from host " + std::to_string(i % 7) + ". ";
+  }
+  checkRoundTrip(toBytes(text));
+
+  // Long literal runs and matches need extra length bytes
+  std::vector<unsigned char> mixed = noise(300);
+  std::vector<unsigned char> repeated(5000, 'x');
+  mixed.insert(mixed.end(), repeated.begin(), repeated.end());
+  std::vector<unsigned char> tail = noise(40);
+  mixed.insert(mixed.end(), tail.begin(), tail.end());
+  checkRoundTrip(mixed);
+}
+
+void testDecompressReusesOutput() {
+  std::vector<unsigned char> input(2000, 'b');
+  std::vector<unsigned char> compressed;
+  CHECK(LZCodec::compress(input, compressed, input.size()));
+
+  std::vector<unsigned char> output(10, 'z');
+  LZCodec::decompress(compressed.data(), compressed.size(), output,
+                      input.size());
+  CHECK(output == input);
+}
+
+void testIncompressible() {
+  std::vector<unsigned char> input = noise(500);
+  std::vector<unsigned char> compressed;
+  CHECK(!LZCodec::compress(input, compressed, input.size()));
+
+  // Compressible, but not below the limit
+  std::vector<unsigned char> repeated(1000, 'a');
+  CHECK(!LZCodec::compress(repeated, compressed, 4));
+}
+
+void testCorrupted() {
+  std::vector<unsigned char> input(1000, 'c');
+  std::vector<unsigned char> compressed;
+  CHECK(LZCodec::compress(input, compressed, input.size()));
+
+  CHECK_THROWS(LZCodec::decompress(compressed, input.size() - 1),
+               LZCodecCorruptedInputException);
+
+  // Cut inside match offset of the first sequence
+  std::vector<unsigned char> truncated(compressed.begin(),
+                                       compressed.begin() + 3);
+  CHECK_THROWS(LZCodec::decompress(truncated, input.size()),
+               LZCodecCorruptedInputException);
+
+  // Match reaching before start of output
+  std::vector<unsigned char> badOffset = {0x10, 'a', 0x10, 0x00};
+  CHECK_THROWS(LZCodec::decompress(badOffset, 100),
+               LZCodecCorruptedInputException);
+}
+}  // namespace
+
+int main() {
+  testRoundTrip();
+  testDecompressReusesOutput();
+  testIncompressible();
+  testCorrupted();
+
+  return testing::finish();
+}
@@ -0,0 +1,97 @@
+#include <cstring>
+#include <string>
+
+#include "membershipupdate.h"
+#include "testing.h"
+#include "utility.h"
+
+namespace {
+std::string nameOf(const char* array) {
+  return maybeNonterminatedCharArrayToString(array,
+                                             TokenRingPacket::NameMaxSize);
+}
+
+void testBatchRoundTrip() {
+  MembershipUpdate update;
+  update.setEpoch(42);
+  update.addEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::ADD, "joining", "previous",
+      Ip4_from_string("10.0.0.1"), 7000));
+  update.addEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::MOVE, "B", "A", Ip4_from_string("10.0.0.2"),
+      7001));
+  update.addEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::COMMIT, "", "", Ip4(), 0));
+
+  MembershipUpdate received(update.toBinary());
+
+  CHECK(received.getEpoch() == 42);
+  CHECK(received.getEntries().size() == 3);
+
+  const MembershipUpdate::Entry& entry = received.getEntries()[0];
+  CHECK(entry.action == MembershipUpdate::Action::ADD);
+  CHECK(nameOf(entry.hostName) == "joining");
+  CHECK(nameOf(entry.repointHostName) == "previous");
+  CHECK(entry.ip.s_addr == Ip4_from_string("10.0.0.1").s_addr);
+  CHECK(entry.port == 7000);
+
+  CHECK(received.getEntries()[1].action == MembershipUpdate::Action::MOVE);
+  CHECK(received.getEntries()[2].action == MembershipUpdate::Action::COMMIT);
+}
+
+void testFullBatch() {
+  MembershipUpdate update;
+  for (size_t i = 0; i < MembershipUpdate::MaxEntries; ++i) {
+    CHECK(!update.isFull());
+    update.addEntry(MembershipUpdate::createEntry(
+        MembershipUpdate::Action::REMOVE, "H" + std::to_string(i), "", Ip4(),
+        0));
+  }
+
+  CHECK(update.isFull());
+  CHECK_THROWS(update.addEntry(MembershipUpdate::createEntry(
+                   MembershipUpdate::Action::REMOVE, "X", "", Ip4(), 0)),
+               MembershipUpdateTooManyEntriesException);
+
+  // Full batch fits into one REGISTER packet
+  CHECK(update.toBinary().size() <= TokenRingPacket::DataMaxSize);
+  CHECK(MembershipUpdate(update.toBinary()).getEntries().size() ==
+        MembershipUpdate::MaxEntries);
+}
+
+void testLongNames() {
+  // Names of other implementations may fill the whole field
+  std::string name(TokenRingPacket::NameMaxSize, 'n');
+  MembershipUpdate::Entry entry = MembershipUpdate::createEntry(
+      MembershipUpdate::Action::ADD, "", "", Ip4(), 0);
+  std::memcpy(entry.hostName, name.data(), name.size());
+
+  MembershipUpdate update;
+  update.addEntry(entry);
+
+  MembershipUpdate received(update.toBinary());
+  CHECK(nameOf(received.getEntries()[0].hostName) == name);
+}
+
+void testTruncated() {
+  MembershipUpdate update;
+  update.addEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::REMOVE, "A", "", Ip4(), 0));
+  Serializable::container_type buffer = update.toBinary();
+
+  buffer.pop_back();
+  CHECK_THROWS(MembershipUpdate{buffer},
+               MembershipUpdateInputBufferTooSmallException);
+  CHECK_THROWS(MembershipUpdate{Serializable::container_type(3)},
+               MembershipUpdateInputBufferTooSmallException);
+}
+}  // namespace
+
+int main() {
+  testBatchRoundTrip();
+  testFullBatch();
+  testLongNames();
+  testTruncated();
+
+  return testing::finish();
+}
@@ -0,0 +1,96 @@
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "messagering.h"
+#include "testing.h"
+
+namespace {
+TokenRingEngine::ReceivedMessage createMessage(
+    TokenRingPacket::MessageId_t messageId, const std::string& data) {
+  TokenRingEngine::ReceivedMessage message;
+  message.senderName = "A";
+  message.receiverName = "B";
+  message.messageId = messageId;
+  message.data = reinterpret_cast<const unsigned char*>(data.data());
+  message.size = data.size();
+  return message;
+}
+
+std::string dataOf(const MessageRing::Message& message) {
+  return std::string(reinterpret_cast<const char*>(message.data),
+                     message.size);
+}
+
+void testMessagesInOrder() {
+  std::string name = "test_" + std::to_string(getpid());
+  std::unique_ptr<MessageRing> application = MessageRing::create(name);
+  std::unique_ptr<MessageRing> host = MessageRing::attach(name);
+  CHECK(host != nullptr);
+  if (!host) {
+    return;
+  }
+
+  MessageRing::Message message;
+  CHECK(!application->pop(message));
+
+  CHECK(host->push(createMessage(1, "first")));
+  CHECK(host->push(createMessage(2, "")));
+  CHECK(host->push(createMessage(3, std::string(5000, 'x'))));
+
+  CHECK(application->pop(message));
+  CHECK(message.messageId == 1);
+  CHECK(message.senderName == "A");
+  CHECK(message.receiverName == "B");
+  CHECK(dataOf(message) == "first");
+
+  CHECK(application->pop(message));
+  CHECK(message.messageId == 2);
+  CHECK(message.size == 0);
+
+  CHECK(application->pop(message));
+  CHECK(message.messageId == 3);
+  CHECK(dataOf(message) == std::string(5000, 'x'));
+
+  CHECK(!application->pop(message));
+}
+
+void testFullRing() {
+  std::string name = "test_full_" + std::to_string(getpid());
+  std::unique_ptr<MessageRing> application = MessageRing::create(name);
+  std::unique_ptr<MessageRing> host = MessageRing::attach(name);
+  CHECK(host != nullptr);
+  if (!host) {
+    return;
+  }
+
+  std::string data(60000, 'y');
+  TokenRingPacket::MessageId_t pushed = 0;
+  while (host->push(createMessage(pushed + 1, data))) {
+    ++pushed;
+  }
+  CHECK(pushed > 0);
+  CHECK(pushed * data.size() <= SharedMemoryRing::Capacity);
+
+  // Room made by application is used again
+  MessageRing::Message message;
+  CHECK(application->pop(message));
+  CHECK(message.messageId == 1);
+  CHECK(host->push(createMessage(pushed + 1, data)));
+
+  TokenRingPacket::MessageId_t popped = 1;
+  while (application->pop(message)) {
+    CHECK(message.messageId == ++popped);
+  }
+  CHECK(popped == pushed + 1);
+}
+}  // namespace
+
+int main() {
+  testMessagesInOrder();
+  testFullRing();
+
+  return testing::finish();
+}
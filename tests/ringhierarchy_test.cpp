@@ -0,0 +1,107 @@
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "ringhierarchy.h"
+#include "testing.h"
+
+namespace {
+RingHierarchy parseHierarchy(const std::string& text) {
+  std::istringstream input(text);
+  return RingHierarchy::fromStream(input);
+}
+
+const char* HierarchyText =
+    "ring r1\n"
+    "A 127.0.0.1 7000\n"
+    "B 127.0.0.1 7001  # bridge of r1\n"
+    "ring r2\n"
+    "C 127.0.0.1 7002\n"
+    "D 127.0.0.1 7003\n"
+    "ring backbone\n"
+    "B 127.0.0.1 7001\n"
+    "C 127.0.0.1 7002\n"
+    "E 127.0.0.1 7004\n";
+
+void testHierarchyParsing() {
+  RingHierarchy hierarchy = parseHierarchy(HierarchyText);
+
+  CHECK(hierarchy.getRings().size() == 3);
+  CHECK(hierarchy.getLocalRingOf("A") == "r1");
+  CHECK(hierarchy.getLocalRingOf("B") == "r1");
+  CHECK(hierarchy.getLocalRingOf("E") == RingHierarchy::BackboneRingName);
+  CHECK(hierarchy.isOnBackbone("C"));
+  CHECK(!hierarchy.isOnBackbone("D"));
+  CHECK(hierarchy.getBridgeOf("r2") == "C");
+}
+
+void testHierarchyErrors() {
+  // Hosts before first ring line
+  CHECK_THROWS(parseHierarchy("A 127.0.0.1 7000\n"),
+               RingHierarchyInvalidException);
+  // Second ring without backbone
+  CHECK_THROWS(parseHierarchy("ring r1\nA 127.0.0.1 7000\n"
+                              "ring r2\nB 127.0.0.1 7001\n"),
+               RingHierarchyInvalidException);
+  // Ring without bridge
+  CHECK_THROWS(parseHierarchy("ring r1\nA 127.0.0.1 7000\n"
+                              "ring r2\nB 127.0.0.1 7001\n"
+                              "ring backbone\nA 127.0.0.1 7000\n"),
+               RingHierarchyInvalidException);
+  // Bridge with other address on backbone
+  CHECK_THROWS(parseHierarchy("ring r1\nA 127.0.0.1 7000\n"
+                              "ring backbone\nA 127.0.0.1 7009\n"),
+               RingHierarchyInvalidException);
+  // Host in two local rings
+  CHECK_THROWS(parseHierarchy("ring r1\nA 127.0.0.1 7000\n"
+                              "ring r2\nA 127.0.0.1 7000\n"
+                              "ring backbone\nA 127.0.0.1 7000\n"),
+               RingHierarchyInvalidException);
+}
+
+void checkRoute(const std::map<std::string, RingHierarchy::Route>& routes,
+                const std::string& receiverName, const std::string& ringName,
+                const std::string& nextHopName) {
+  auto route = routes.find(receiverName);
+  CHECK(route != routes.end());
+  if (route != routes.end()) {
+    CHECK(route->second.ringName == ringName);
+    CHECK(route->second.nextHopName == nextHopName);
+  }
+}
+
+void testRoutingTables() {
+  RingHierarchy hierarchy = parseHierarchy(HierarchyText);
+  const std::string backbone = RingHierarchy::BackboneRingName;
+
+  auto routes = hierarchy.getRoutingTable("A");
+  CHECK(routes.size() == 4);
+  CHECK(routes.count("A") == 0);
+  checkRoute(routes, "B", "r1", "B");
+  checkRoute(routes, "C", "r1", "B");
+  checkRoute(routes, "D", "r1", "B");
+  checkRoute(routes, "E", "r1", "B");
+
+  routes = hierarchy.getRoutingTable("B");
+  checkRoute(routes, "A", "r1", "A");
+  checkRoute(routes, "C", backbone, "C");
+  checkRoute(routes, "D", backbone, "C");
+  checkRoute(routes, "E", backbone, "E");
+
+  routes = hierarchy.getRoutingTable("E");
+  checkRoute(routes, "A", backbone, "B");
+  checkRoute(routes, "D", backbone, "C");
+
+  routes = hierarchy.getRoutingTable("D");
+  checkRoute(routes, "C", "r2", "C");
+  checkRoute(routes, "A", "r2", "C");
+}
+}  // namespace
+
+int main() {
+  testHierarchyParsing();
+  testHierarchyErrors();
+  testRoutingTables();
+
+  return testing::finish();
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ringordering.h"
+#include "testing.h"
+
+namespace {
+using Duration = RingOrdering::Duration;
+
+// Hosts of the same cluster are close, clusters are far from each other
+Duration roundTripTimeOf(const std::string& host, const std::string& other) {
+  return host[0] == other[0] ? Duration{100} : Duration{10000};
+}
+
+RingOrdering measuredOrdering(const std::vector<std::string>& hosts) {
+  RingOrdering ordering;
+  for (const std::string& host : hosts) {
+    for (const std::string& other : hosts) {
+      if (host != other) {
+        ordering.setRoundTripTime(host, other, roundTripTimeOf(host, other));
+      }
+    }
+  }
+  return ordering;
+}
+
+void testCurrentOrder() {
+  RingOrdering ordering;
+  ordering.setNextHost("A", "B");
+  ordering.setNextHost("B", "C");
+  ordering.setNextHost("C", "A");
+
+  std::set<std::string> hosts = {"A", "B", "C"};
+  CHECK((ordering.getCurrentOrder("B", hosts) ==
+         std::vector<std::string>{"B", "C", "A"}));
+
+  // Reports have to make ring of exactly the hosts
+  CHECK(ordering.getCurrentOrder("A", {"A", "B", "C", "D"}).empty());
+  CHECK(ordering.getCurrentOrder("A", {"A", "B"}).empty());
+
+  ordering.setNextHost("C", "B");
+  CHECK(ordering.getCurrentOrder("A", hosts).empty());
+
+  ordering.setNextHost("C", "A");
+  ordering.forgetHost("B");
+  CHECK(ordering.getCurrentOrder("A", hosts).empty());
+}
+
+void testRotationTime() {
+  std::vector<std::string> order = {"a1", "a2", "b1", "b2"};
+  RingOrdering ordering = measuredOrdering(order);
+
+  // One-way latencies: two links inside clusters, two between them
+  CHECK(ordering.getRotationTime(order) == Duration{2 * 50 + 2 * 5000});
+}
+
+void testOptimize() {
+  std::vector<std::string> order = {"a1", "b1", "a2", "b2", "a3", "b3"};
+  RingOrdering ordering = measuredOrdering(order);
+
+  std::vector<std::string> optimized = ordering.optimize(order);
+
+  CHECK(optimized.size() == order.size());
+  CHECK(optimized.front() == "a1");
+  CHECK(std::is_permutation(optimized.begin(), optimized.end(),
+                            order.begin()));
+
+  // Clusters are visited one after another
+  CHECK(ordering.getRotationTime(optimized) == Duration{4 * 50 + 2 * 5000});
+  CHECK(ordering.getRotationTime(optimized) <
+        ordering.getRotationTime(order));
+
+  // Optimal order is kept
+  CHECK(ordering.optimize(optimized) == optimized);
+
+  // Every order of three hosts is the same ring
+  std::vector<std::string> small = {"a1", "b1", "a2"};
+  CHECK(ordering.optimize(small) == small);
+}
+}  // namespace
+
+int main() {
+  testCurrentOrder();
+  testRotationTime();
+  testOptimize();
+
+  return testing::finish();
+}
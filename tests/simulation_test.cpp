@@ -0,0 +1,200 @@
+#include <chrono>
+
+#include "logger.h"
+#include "simulation.h"
+#include "testing.h"
+
+namespace {
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+Simulation::Configuration createConfiguration(size_t nodesCount,
+                                              milliseconds duration) {
+  Simulation::Configuration configuration;
+  configuration.nodesCount = nodesCount;
+  configuration.duration = duration;
+  configuration.seed = 5;
+  // The same as simulator uses
+  configuration.timing.greetingInterval = milliseconds{0};
+  configuration.timing.retransmissionTimeout = milliseconds{500};
+
+  return configuration;
+}
+
+void testTokenLoss() {
+  Simulation::Configuration configuration =
+      createConfiguration(20, milliseconds{10000});
+  configuration.linkModel.lossProbability = 0.001;
+  configuration.messageInterval = milliseconds{50};
+  configuration.timing.retransmissionTimeout = milliseconds{200};
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.framesLost > 0);
+  // Lost token is regenerated, ring keeps going
+  CHECK(report.maxTokenGap < milliseconds{1000});
+  CHECK(report.messagesDelivered * 10 >= report.messagesSent * 8);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testJoinAfterTokenLoss() {
+  Simulation::Configuration configuration =
+      createConfiguration(20, milliseconds{10000});
+  configuration.linkModel.lossProbability = 0.001;
+  configuration.messageInterval = milliseconds{50};
+  configuration.timing.retransmissionTimeout = milliseconds{200};
+  // Token is regenerated before that
+  configuration.joiningNodesCount = 2;
+  configuration.joinTime = milliseconds{6000};
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.framesLost > 0);
+  CHECK(report.joinedNodesCount == 2);
+  CHECK(report.aliveNodesCount == 22);
+  CHECK(report.maxTokenGap < milliseconds{1000});
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testCrash() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{6000});
+  configuration.crashedNodesCount = 3;
+  configuration.crashTime = milliseconds{3000};
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.aliveNodesCount == 27);
+  // Dead hosts are bypassed once their neighbors notice
+  CHECK(report.maxTokenGap < 2 * configuration.timing.neighborFailureTimeout);
+  CHECK(report.messagesDelivered > 0);
+}
+
+void testLeave() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{6000});
+  configuration.messageInterval = milliseconds{100};
+
+  Simulation::Configuration crashConfiguration = configuration;
+  crashConfiguration.crashedNodesCount = 3;
+  crashConfiguration.crashTime = milliseconds{3000};
+  Simulation::Report crashReport = Simulation(crashConfiguration).run();
+
+  configuration.leavingNodesCount = 3;
+  configuration.leaveTime = milliseconds{3000};
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.aliveNodesCount == 27);
+  // Neighbors are told, nobody waits for failure timeout
+  CHECK(report.maxTokenGap < configuration.timing.neighborFailureTimeout);
+  CHECK(report.maxTokenGap < crashReport.maxTokenGap);
+  CHECK(report.messagesDelivered > 0);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testFrameReorder() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{5000});
+  configuration.linkModel.reorderProbability = 0.05;
+  configuration.linkModel.jitter = microseconds{50};
+  configuration.messageInterval = milliseconds{50};
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.aliveNodesCount == 30);
+  CHECK(report.maxTokenGap < milliseconds{10});
+  CHECK(report.messagesDelivered > 0);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testCoalescing() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{3000});
+  // Much more than one message per token hold
+  configuration.messageInterval = microseconds{1000};
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.messagesDelivered > 0);
+  CHECK(report.dataFramesDelivered * 4 < report.messagesDelivered);
+}
+
+void testDualRing() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{6000});
+  configuration.crashedNodesCount = 3;
+  configuration.crashTime = milliseconds{3000};
+  configuration.messageInterval = milliseconds{50};
+  Simulation::Report singleReport = Simulation(configuration).run();
+
+  configuration.dualRing = true;
+  Simulation::Report report = Simulation(configuration).run();
+
+  CHECK(report.aliveNodesCount == 27);
+  // Receivers bypassed on one ring are still reached over the other
+  CHECK(report.messagesDelivered > singleReport.messagesDelivered);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testLanes() {
+  Simulation::Configuration configuration =
+      createConfiguration(30, milliseconds{3000});
+  configuration.messageInterval = microseconds{1000};
+  Simulation::Report singleReport = Simulation(configuration).run();
+
+  configuration.lanesCount = 4;
+  Simulation::Report report = Simulation(configuration).run();
+
+  // Every lane has its own token, so lanes carry more together
+  CHECK(report.messagesDelivered > 2 * singleReport.messagesDelivered);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testRings() {
+  Simulation::Configuration configuration =
+      createConfiguration(40, milliseconds{6000});
+  configuration.messageInterval = milliseconds{50};
+  Simulation::Report singleReport = Simulation(configuration).run();
+
+  configuration.ringsCount = 4;
+  Simulation::Report report = Simulation(configuration).run();
+
+  // Token goes around small local ring, bridges carry the rest
+  CHECK(report.averageRotationTime * 2 < singleReport.averageRotationTime);
+  CHECK(report.messagesDelivered > 0);
+  CHECK(report.messagesNotDelivered == 0);
+  CHECK(report.messagesOutOfOrder == 0);
+}
+
+void testRingReorder() {
+  Simulation::Configuration configuration =
+      createConfiguration(40, milliseconds{20000});
+  configuration.racksCount = 4;
+
+  Simulation::Report report = Simulation(configuration).run();
+
+  // Hosts of the same rack end up next to each other
+  configuration.timing.reorderInterval = milliseconds{2000};
+  Simulation::Report reorderedReport = Simulation(configuration).run();
+
+  CHECK(reorderedReport.aliveNodesCount == 40);
+  CHECK(reorderedReport.averageRotationTime * 2 < report.averageRotationTime);
+}
+}  // namespace
+
+int main() {
+  Logger::getInstance().setEnabled(false);
+
+  testTokenLoss();
+  testJoinAfterTokenLoss();
+  testCrash();
+  testLeave();
+  testFrameReorder();
+  testCoalescing();
+  testDualRing();
+  testLanes();
+  testRings();
+  testRingReorder();
+
+  return testing::finish();
+}
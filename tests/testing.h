@@ -0,0 +1,54 @@
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * Checks of test programs run by CTest. Failed check is reported and test
+ * goes on, exit status of finish() tells if any failed.
+ */
+namespace testing {
+inline int& failuresCount() {
+  static int count = 0;
+  return count;
+}
+
+inline void fail(const char* file, int line, const char* expression) {
+  std::cerr << file << ":" << line << ": check failed: " << expression
+            << std::endl;
+  ++failuresCount();
+}
+
+inline int finish() {
+  if (failuresCount() != 0) {
+    std::cerr << failuresCount() << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+}  // namespace testing
+
+#define CHECK(condition)                             \
+  do {                                               \
+    if (!(condition)) {                              \
+      testing::fail(__FILE__, __LINE__, #condition); \
+    }                                                \
+  } while (false)
+
+#define CHECK_THROWS(statement, exception)             \
+  do {                                                 \
+    bool thrown = false;                               \
+    try {                                              \
+      statement;                                       \
+    } catch (const exception&) {                       \
+      thrown = true;                                   \
+    }                                                  \
+    if (!thrown) {                                     \
+      testing::fail(__FILE__, __LINE__,                \
+                    #statement " throws " #exception); \
+    }                                                  \
+  } while (false)
+
+#endif  // TESTING_H
@@ -0,0 +1,432 @@
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "logger.h"
+#include "loopbacktransport.h"
+#include "testing.h"
+#include "tokenringengine.h"
+#include "tokenringpacket.h"
+#include "topology.h"
+
+namespace {
+using Status = TokenRingEngine::DeliveryStatus;
+
+/**
+ * Network whose frames may be dropped on their way by test
+ */
+class FilteringNetwork : public LoopbackNetwork {
+ public:
+  // Returns false for frame that is lost
+  std::function<bool(const TokenRingPacket&, unsigned short destinationPort)>
+      filter;
+
+  void transmit(const Transport::Frame& frame,
+                const Socket::IpAndPortPair& source) override {
+    if (filter && !filter(TokenRingPacket(frame.data), frame.address.second)) {
+      return;
+    }
+    LoopbackNetwork::transmit(frame, source);
+  }
+};
+
+/**
+ * Ring of hosts A, B, C on virtual clock. A sends.
+ */
+class TestRing {
+ public:
+  static const unsigned short BasePort = 7000;
+
+  FilteringNetwork network;
+  std::vector<std::unique_ptr<LoopbackTransport>> transports;
+  std::vector<std::unique_ptr<TokenRingEngine>> engines;
+  TokenRingEngine::TimePoint now{};
+
+  // Crashed hosts are not run any more
+  std::vector<bool> crashed;
+  // Messages of test handed over to each host, greetings are left out
+  std::vector<std::vector<std::string>> delivered;
+  std::map<TokenRingPacket::MessageId_t, std::vector<Status>> reports;
+  // Answer of hosts to messages of test, greetings are always taken
+  std::function<TokenRingEngine::MessageHandling(size_t hostIndex,
+                                                 const std::string& data)>
+      receiver = [](size_t, const std::string&) {
+        return TokenRingEngine::MessageHandling::TAKEN;
+      };
+
+  TestRing() {
+    std::istringstream input("A 127.0.0.1 7000\n"
+                             "B 127.0.0.1 7001\n"
+                             "C 127.0.0.1 7002\n");
+    Topology topology = Topology::fromStream(input);
+
+    TokenRingEngine::Timing timing;
+    timing.greetingInterval = std::chrono::milliseconds{5};
+    timing.retransmissionTimeout = std::chrono::milliseconds{50};
+
+    for (const Topology::Host& host : topology.getHosts()) {
+      transports.emplace_back(
+          new LoopbackTransport(network, host.ip, host.port));
+      transports.back()->open();
+      engines.emplace_back(
+          new TokenRingEngine(host.name, topology, *transports.back()));
+      engines.back()->setTiming(timing);
+      engines.back()->setRandomSeed(1);
+    }
+
+    crashed.resize(engines.size());
+    delivered.resize(engines.size());
+    for (size_t i = 0; i < engines.size(); ++i) {
+      engines[i]->setMessageHandler(
+          [this, i](const TokenRingEngine::ReceivedMessage& message) {
+            std::string data(reinterpret_cast<const char*>(message.data),
+                             message.size);
+            if (data.compare(0, 9, "Greetings") == 0) {
+              return TokenRingEngine::MessageHandling::TAKEN;
+            }
+
+            TokenRingEngine::MessageHandling handling = receiver(i, data);
+            if (handling == TokenRingEngine::MessageHandling::TAKEN) {
+              delivered[i].push_back(data);
+            }
+            return handling;
+          });
+    }
+
+    engines[0]->setDeliveryReportHandler(
+        [this](const TokenRingEngine::DeliveryReport& report) {
+          reports[report.messageId].push_back(report.status);
+        });
+
+    for (auto& engine : engines) {
+      engine->start(now);
+    }
+  }
+
+  TokenRingPacket::MessageId_t send(const std::string& receiverName,
+                                    const std::string& data) {
+    return engines[0]->sendMessage(
+        receiverName, std::vector<unsigned char>(data.begin(), data.end()));
+  }
+
+  void run(std::chrono::milliseconds duration) {
+    std::vector<Transport::Frame> frames;
+
+    for (auto end = now + duration; now < end;
+         now += std::chrono::microseconds{100}) {
+      for (size_t i = 0; i < engines.size(); ++i) {
+        if (crashed[i]) {
+          continue;
+        }
+
+        frames.clear();
+        transports[i]->receive(frames, 64);
+        for (const Transport::Frame& frame : frames) {
+          engines[i]->handleFrame(frame.data, now);
+        }
+        engines[i]->handleTimeout(now);
+      }
+    }
+  }
+};
+
+bool carries(const TokenRingPacket& packet, const std::string& data) {
+  if (packet.getHeader().type != TokenRingPacket::PacketType::DATA) {
+    return false;
+  }
+
+  std::vector<TokenRingPacket::Record> records;
+  packet.getRecords(records);
+  for (const TokenRingPacket::Record& record : records) {
+    if (std::string(reinterpret_cast<const char*>(record.data),
+                    record.size) == data) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool reportedOnce(const TestRing& ring, TokenRingPacket::MessageId_t id,
+                  Status status) {
+  auto report = ring.reports.find(id);
+  return report != ring.reports.end() &&
+         report->second == std::vector<Status>{status};
+}
+
+void testDeliveryReports() {
+  TestRing ring;
+
+  TokenRingPacket::MessageId_t known = ring.send("B", "m1");
+  TokenRingPacket::MessageId_t unknown = ring.send("Z", "m2");
+  ring.run(std::chrono::milliseconds{100});
+
+  CHECK(reportedOnce(ring, known, Status::DELIVERED));
+  CHECK(reportedOnce(ring, unknown, Status::RECEIVER_NOT_FOUND));
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1"}));
+  CHECK(ring.delivered[2].empty());
+}
+
+void testBusyReceiverGetsMessagesAgain() {
+  TestRing ring;
+
+  int busyAnswers = 3;
+  ring.receiver = [&](size_t, const std::string&) {
+    if (busyAnswers > 0) {
+      --busyAnswers;
+      return TokenRingEngine::MessageHandling::BUSY;
+    }
+    return TokenRingEngine::MessageHandling::TAKEN;
+  };
+
+  TokenRingPacket::MessageId_t first = ring.send("B", "m1");
+  TokenRingPacket::MessageId_t second = ring.send("B", "m2");
+  ring.run(std::chrono::milliseconds{2000});
+
+  CHECK(busyAnswers == 0);
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1", "m2"}));
+  CHECK(reportedOnce(ring, first, Status::DELIVERED));
+  CHECK(reportedOnce(ring, second, Status::DELIVERED));
+}
+
+void testReceiverStaysBusy() {
+  TestRing ring;
+  ring.receiver = [](size_t, const std::string& data) {
+    return data == "bad" ? TokenRingEngine::MessageHandling::BUSY
+                         : TokenRingEngine::MessageHandling::TAKEN;
+  };
+
+  TokenRingPacket::MessageId_t refused = ring.send("B", "bad");
+  ring.run(std::chrono::milliseconds{5000});
+  CHECK(reportedOnce(ring, refused, Status::RECEIVER_BUSY));
+
+  // Sent alone, queued together it would share frame and its fate
+  TokenRingPacket::MessageId_t taken = ring.send("B", "m1");
+  ring.run(std::chrono::milliseconds{100});
+
+  CHECK(reportedOnce(ring, taken, Status::DELIVERED));
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1"}));
+}
+
+void testRefusedMessageIsSkipped() {
+  TestRing ring;
+  ring.receiver = [](size_t, const std::string& data) {
+    return data == "bad" ? TokenRingEngine::MessageHandling::REFUSED
+                         : TokenRingEngine::MessageHandling::TAKEN;
+  };
+
+  // Queued together, they share frame
+  TokenRingPacket::MessageId_t first = ring.send("B", "m1");
+  TokenRingPacket::MessageId_t refused = ring.send("B", "bad");
+  TokenRingPacket::MessageId_t second = ring.send("B", "m2");
+  ring.run(std::chrono::milliseconds{500});
+
+  // Window of B moves past refused message
+  TokenRingPacket::MessageId_t third = ring.send("B", "m3");
+  ring.run(std::chrono::milliseconds{500});
+
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1", "m2", "m3"}));
+  CHECK(reportedOnce(ring, first, Status::DELIVERED));
+  CHECK(reportedOnce(ring, refused, Status::NOT_COPIED));
+  CHECK(reportedOnce(ring, second, Status::DELIVERED));
+  CHECK(reportedOnce(ring, third, Status::DELIVERED));
+}
+
+void testLostFrameIsDeliveredInOrder() {
+  TestRing ring;
+
+  // The first frame of m1 is lost before B, token with it
+  bool dropped = false;
+  ring.network.filter = [&](const TokenRingPacket& packet,
+                            unsigned short port) {
+    if (!dropped && port == TestRing::BasePort + 1 && carries(packet, "m1")) {
+      dropped = true;
+      return false;
+    }
+    return true;
+  };
+
+  TokenRingPacket::MessageId_t first = ring.send("B", "m1");
+  ring.run(std::chrono::milliseconds{20});
+  CHECK(dropped);
+
+  // Comes to B before m1 is sent again, it waits for it
+  TokenRingPacket::MessageId_t second = ring.send("B", "m2");
+  ring.run(std::chrono::milliseconds{1000});
+
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1", "m2"}));
+  CHECK(reportedOnce(ring, first, Status::DELIVERED));
+  CHECK(reportedOnce(ring, second, Status::DELIVERED));
+}
+
+void testLostAcknowledgementIsNotDeliveredTwice() {
+  TestRing ring;
+
+  // Frame returning to A after B copied m1 is lost, A sends it again
+  bool dropped = false;
+  ring.network.filter = [&](const TokenRingPacket& packet,
+                            unsigned short port) {
+    if (!dropped && port == TestRing::BasePort && carries(packet, "m1")) {
+      dropped = true;
+      return false;
+    }
+    return true;
+  };
+
+  TokenRingPacket::MessageId_t id = ring.send("B", "m1");
+  ring.run(std::chrono::milliseconds{1000});
+
+  CHECK(dropped);
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1"}));
+  CHECK(reportedOnce(ring, id, Status::DELIVERED));
+}
+
+bool isTokenFrame(const TokenRingPacket& packet) {
+  using trppt = TokenRingPacket::PacketType;
+
+  return packet.getHeader().tokenStatus &&
+         packet.getHeader().type != trppt::HEARTBEAT &&
+         packet.getHeader().type != trppt::HEARTBEAT_ACK &&
+         packet.getHeader().type != trppt::JOIN;
+}
+
+void testHolderCrashesAfterPassingToken() {
+  TestRing ring;
+
+  // C holds token for long after its greeting, A does not miss its frames
+  // meanwhile
+  TokenRingEngine::Timing timing;
+  timing.greetingInterval = std::chrono::milliseconds{5};
+  timing.retransmissionTimeout = std::chrono::milliseconds{10000};
+  ring.engines[0]->setTiming(timing);
+  timing.greetingInterval = std::chrono::milliseconds{3000};
+  ring.engines[2]->setTiming(timing);
+  ring.run(std::chrono::milliseconds{100});
+
+  // B dies right after it passed token on, before it answered heartbeat
+  TokenRingPacket::TokenEpoch_t passedEpoch = 0;
+  std::vector<TokenRingPacket::TokenEpoch_t> epochsToC;
+  ring.network.filter = [&](const TokenRingPacket& packet,
+                            unsigned short port) {
+    if (port == TestRing::BasePort + 1) {
+      return !ring.crashed[1];
+    }
+    if (port == TestRing::BasePort + 2 && isTokenFrame(packet)) {
+      if (!ring.crashed[1]) {
+        ring.crashed[1] = true;
+        passedEpoch = packet.getHeader().tokenEpoch;
+      } else {
+        epochsToC.push_back(packet.getHeader().tokenEpoch);
+      }
+    }
+    return true;
+  };
+  while (!ring.crashed[1]) {
+    ring.run(std::chrono::milliseconds{1});
+  }
+  ring.run(std::chrono::milliseconds{2500});
+
+  // A bypassed B and regenerated token while C still held the passed one
+  CHECK(ring.engines[2]->holdsToken());
+  CHECK(!epochsToC.empty());
+  for (TokenRingPacket::TokenEpoch_t epoch : epochsToC) {
+    CHECK(epoch > passedEpoch);
+  }
+
+  // Old token of C is dropped, the ring goes on with the new one
+  timing.greetingInterval = std::chrono::milliseconds{5};
+  ring.engines[2]->setTiming(timing);
+  TokenRingPacket::MessageId_t id = ring.send("C", "m1");
+  ring.run(std::chrono::milliseconds{5000});
+
+  CHECK(reportedOnce(ring, id, Status::DELIVERED));
+  CHECK((ring.delivered[2] == std::vector<std::string>{"m1"}));
+}
+
+void testDirectTransfer() {
+  TestRing ring;
+
+  // Payload goes straight to B, C does not see it
+  std::map<unsigned short, size_t> directFrames;
+  ring.network.filter = [&](const TokenRingPacket& packet,
+                            unsigned short port) {
+    if (packet.getHeader().type == TokenRingPacket::PacketType::DIRECT) {
+      ++directFrames[port];
+    }
+    return true;
+  };
+
+  std::string large(20000, 'L');
+  TokenRingPacket::MessageId_t first = ring.send("B", large);
+  TokenRingPacket::MessageId_t second = ring.send("B", "m1");
+  ring.run(std::chrono::milliseconds{200});
+
+  CHECK((ring.delivered[1] == std::vector<std::string>{large, "m1"}));
+  CHECK(reportedOnce(ring, first, Status::DELIVERED));
+  CHECK(reportedOnce(ring, second, Status::DELIVERED));
+  CHECK(directFrames[TestRing::BasePort + 1] > 0);
+  CHECK(directFrames.size() == 1);
+}
+
+void testLostDirectFrame() {
+  TestRing ring;
+
+  bool dropped = false;
+  ring.network.filter = [&](const TokenRingPacket& packet, unsigned short) {
+    if (!dropped &&
+        packet.getHeader().type == TokenRingPacket::PacketType::DIRECT) {
+      dropped = true;
+      return false;
+    }
+    return true;
+  };
+
+  std::string large(5000, 'L');
+  TokenRingPacket::MessageId_t id = ring.send("B", large);
+  ring.run(std::chrono::milliseconds{1000});
+
+  CHECK(dropped);
+  CHECK((ring.delivered[1] == std::vector<std::string>{large}));
+  CHECK(reportedOnce(ring, id, Status::DELIVERED));
+}
+
+void testMulticastReports() {
+  TestRing ring;
+  ring.engines[2]->joinGroup("@g");
+
+  TokenRingPacket::MessageId_t broadcast =
+      ring.send(TokenRingPacket::BroadcastReceiverName, "m1");
+  TokenRingPacket::MessageId_t group = ring.send("@g", "m2");
+  TokenRingPacket::MessageId_t emptyGroup = ring.send("@none", "m3");
+  ring.run(std::chrono::milliseconds{100});
+
+  CHECK(reportedOnce(ring, broadcast, Status::DELIVERED));
+  CHECK(reportedOnce(ring, group, Status::DELIVERED));
+  CHECK(reportedOnce(ring, emptyGroup, Status::RECEIVER_NOT_FOUND));
+
+  // Sender does not get its own broadcast
+  CHECK(ring.delivered[0].empty());
+  CHECK((ring.delivered[1] == std::vector<std::string>{"m1"}));
+  CHECK((ring.delivered[2] == std::vector<std::string>{"m1", "m2"}));
+}
+}  // namespace
+
+int main() {
+  Logger::getInstance().setEnabled(false);
+
+  testDeliveryReports();
+  testLostFrameIsDeliveredInOrder();
+  testLostAcknowledgementIsNotDeliveredTwice();
+  testHolderCrashesAfterPassingToken();
+  testDirectTransfer();
+  testLostDirectFrame();
+  testBusyReceiverGetsMessagesAgain();
+  testReceiverStaysBusy();
+  testRefusedMessageIsSkipped();
+  testMulticastReports();
+
+  return testing::finish();
+}
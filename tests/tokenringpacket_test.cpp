@@ -0,0 +1,151 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "crc32c.h"
+#include "testing.h"
+#include "tokenringpacket.h"
+
+namespace {
+std::vector<unsigned char> toBytes(const std::string& text) {
+  return std::vector<unsigned char>(text.begin(), text.end());
+}
+
+std::string toString(const TokenRingPacket::Record& record) {
+  return std::string(reinterpret_cast<const char*>(record.data), record.size);
+}
+
+uint32_t readBigEndian(const std::vector<unsigned char>& buffer,
+                       size_t offset, size_t size) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value = (value << 8) | buffer[offset + i];
+  }
+  return value;
+}
+
+TokenRingPacket createDataPacket(TokenRingPacket::MessageId_t messageId,
+                                 const std::string& data) {
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::DATA;
+  header.messageId = messageId;
+
+  TokenRingPacket packet;
+  packet.setHeader(header);
+  packet.setData(toBytes(data));
+  return packet;
+}
+
+void testSingleMessage() {
+  TokenRingPacket packet = createDataPacket(5, "alone");
+  CHECK(!packet.hasRecords());
+
+  std::vector<TokenRingPacket::Record> records;
+  packet.getRecords(records);
+  CHECK(records.size() == 1);
+  CHECK(records[0].messageId == 5);
+  CHECK(toString(records[0]) == "alone");
+}
+
+void testCoalescedRecords() {
+  TokenRingPacket packet = createDataPacket(7, "first");
+  CHECK(packet.appendRecord(8, toBytes("second")));
+  CHECK(packet.appendRecord(9, toBytes("")));
+  CHECK(packet.hasRecords());
+
+  // Records survive the wire
+  TokenRingPacket received(packet.toBinary());
+
+  std::vector<TokenRingPacket::Record> records;
+  received.getRecords(records);
+  CHECK(records.size() == 3);
+  CHECK(records[0].messageId == 7);
+  CHECK(toString(records[0]) == "first");
+  CHECK(records[1].messageId == 8);
+  CHECK(toString(records[1]) == "second");
+  CHECK(records[2].messageId == 9);
+  CHECK(records[2].size == 0);
+}
+
+void testFrameLimit() {
+  TokenRingPacket packet = createDataPacket(1, std::string(100, 'a'));
+
+  size_t appended = 0;
+  TokenRingPacket::MessageId_t messageId = 2;
+  while (packet.appendRecord(messageId++, toBytes(std::string(100, 'b')))) {
+    ++appended;
+  }
+
+  // Every record takes its header too
+  size_t recordSize = TokenRingPacket::RecordHeaderSize + 100;
+  CHECK(appended + 1 == TokenRingPacket::DataMaxSize / recordSize);
+  CHECK(packet.getHeader().dataSize <= TokenRingPacket::DataMaxSize);
+
+  std::vector<TokenRingPacket::Record> records;
+  packet.getRecords(records);
+  CHECK(records.size() == appended + 1);
+}
+
+void testHeaderInNetworkOrder() {
+  using Header = TokenRingPacket::Header;
+
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::DATA;
+  header.registerPort = 0x0102;
+  header.messageId = 0x01020304;
+  header.sequenceNumber = 0x05060708;
+  header.windowStart = 0x090a0b0c;
+  header.copiedCount = 0x0d0e;
+  header.tokenEpoch = 0x0f101112;
+
+  TokenRingPacket packet;
+  packet.setHeader(header);
+  packet.setData(toBytes("abc"));
+  // Checksum is updated, not computed again
+  header.windowStart = 0x13141516;
+  packet.setHeader(header);
+
+  std::vector<unsigned char> buffer = packet.toBinary();
+  CHECK(readBigEndian(buffer, offsetof(Header, registerPort), 2) == 0x0102);
+  CHECK(readBigEndian(buffer, offsetof(Header, dataSize), 2) == 3);
+  CHECK(readBigEndian(buffer, offsetof(Header, messageId), 4) == 0x01020304);
+  CHECK(readBigEndian(buffer, offsetof(Header, sequenceNumber), 4) ==
+        0x05060708);
+  CHECK(readBigEndian(buffer, offsetof(Header, windowStart), 4) ==
+        0x13141516);
+  CHECK(readBigEndian(buffer, offsetof(Header, copiedCount), 2) == 0x0d0e);
+  CHECK(readBigEndian(buffer, offsetof(Header, tokenEpoch), 4) == 0x0f101112);
+
+  // Checksum covers bytes as sent
+  uint32_t checksum = readBigEndian(buffer, offsetof(Header, checksum), 4);
+  std::memset(buffer.data() + offsetof(Header, checksum), 0,
+              sizeof(uint32_t));
+  CHECK(checksum == Crc32c::extend(0, buffer.data(), buffer.size()));
+
+  TokenRingPacket received(packet.toBinary());
+  CHECK(received.getHeader().messageId == 0x01020304);
+  CHECK(received.getHeader().windowStart == 0x13141516);
+  CHECK(received.getHeader().tokenEpoch == 0x0f101112);
+  CHECK(received.getData() == toBytes("abc"));
+}
+
+void testCompressedPacketTakesNoRecords() {
+  TokenRingPacket packet = createDataPacket(1, "");
+  CHECK(packet.setDataCompressed(toBytes(std::string(400, 'c'))));
+  CHECK(packet.isCompressed());
+  CHECK(!packet.appendRecord(2, toBytes("more")));
+  CHECK(packet.getUncompressedData() == toBytes(std::string(400, 'c')));
+}
+}  // namespace
+
+int main() {
+  testSingleMessage();
+  testCoalescedRecords();
+  testFrameLimit();
+  testHeaderInNetworkOrder();
+  testCompressedPacketTakesNoRecords();
+
+  return testing::finish();
+}
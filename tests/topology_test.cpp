@@ -0,0 +1,58 @@
+#include <sstream>
+#include <string>
+
+#include "testing.h"
+#include "topology.h"
+
+namespace {
+Topology parseTopology(const std::string& text) {
+  std::istringstream input(text);
+  return Topology::fromStream(input);
+}
+
+void testTopologyParsing() {
+  Topology topology = parseTopology(
+      "# ring\n"
+      "A 127.0.0.1 6000\n"
+      "\n"
+      "B 127.0.0.2 6001   # second\n"
+      "C 127.0.0.1 6002\n");
+
+  CHECK(topology.getHosts().size() == 3);
+  CHECK(topology.getHost("B").port == 6001);
+  CHECK(topology.getHost("B").ip.s_addr ==
+        Ip4_from_string("127.0.0.2").s_addr);
+  CHECK(topology.nextHostOf("A").name == "B");
+  CHECK(topology.nextHostOf("C").name == "A");
+  CHECK(topology.previousHostOf("A").name == "C");
+  CHECK(!topology.contains("D"));
+  CHECK_THROWS(topology.getHost("D"), TopologyUnknownHostException);
+
+  Topology reversed = topology.reversed();
+  CHECK(reversed.getHosts().front().name == "A");
+  CHECK(reversed.nextHostOf("A").name == "C");
+
+  CHECK(topology.withPortOffset(10).getHost("C").port == 6012);
+}
+
+void testTopologyErrors() {
+  CHECK_THROWS(parseTopology("A 127.0.0.1\n"), TopologyInvalidEntryException);
+  CHECK_THROWS(parseTopology("A 127.0.0.1 6000 x\n"),
+               TopologyInvalidEntryException);
+  CHECK_THROWS(parseTopology("A 127.0.0.1 70000\n"),
+               TopologyInvalidEntryException);
+  CHECK_THROWS(parseTopology("A 127.0.0.300 6000\n"),
+               TopologyInvalidEntryException);
+  CHECK_THROWS(parseTopology("A 127.0.0.1 6000\nA 127.0.0.1 6001\n"),
+               TopologyInvalidEntryException);
+  CHECK_THROWS(parseTopology("ABCDEFGHIJKLMNOP 127.0.0.1 6000\n"),
+               TopologyInvalidEntryException);
+}
+}  // namespace
+
+int main() {
+  testTopologyParsing();
+  testTopologyErrors();
+
+  return testing::finish();
+}
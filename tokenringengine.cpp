@@ -0,0 +1,2367 @@
+#include "tokenringengine.h"
+#include "latencyreport.h"
+#include "logger.h"
+#include "membershipupdate.h"
+#include "tokenringpacket.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+// New round trip time sample is averaged in with this weight (1/8)
+const int RoundTripTimeSmoothing = 8;
+
+// Ring is rewired only when rotation gets this much shorter
+const int64_t MinReorderGainPercent = 10;
+
+// Low part of token epoch is rank of host that regenerated token
+const TokenRingPacket::TokenEpoch_t TokenEpochRanks = 1 << 16;
+
+// Token is regenerated when it is that many rotations late
+const int TokenLossRotations = 2;
+
+// Shorter rotation time sample is averaged in with this weight (1/8)
+const int RotationTimeSmoothing = 8;
+}  // namespace
+
+TokenRingEngine::TokenRingEngine(const ProgramArguments& programArguments,
+                                 Transport& transport)
+    : transport(transport),
+      hostId(programArguments.getUserIdentifier()),
+      nextHostIp(programArguments.getNeighborIp()),
+      nextHostPort(programArguments.getNeighborPort()),
+      previousHostName(programArguments.getUserIdentifier()),
+      tokenStatus(programArguments.getHasToken()),
+      compressGreetings(programArguments.useCompression()),
+      directTransferThreshold(programArguments.getDirectTransferThreshold()),
+      lane(programArguments.getLane()),
+      lanesCount(programArguments.getLanesCount()) {
+  timing.reorderInterval =
+      std::chrono::milliseconds(programArguments.getReorderInterval());
+
+  if (programArguments.hasTopology()) {
+    loadTopology(programArguments.getTopology());
+  }
+}
+
+TokenRingEngine::TokenRingEngine(const std::string& hostId,
+                                 const Topology& topology,
+                                 Transport& transport) noexcept(false)
+    : transport(transport),
+      hostId(hostId),
+      nextHostIp(topology.nextHostOf(hostId).ip),
+      nextHostPort(topology.nextHostOf(hostId).port),
+      previousHostName(hostId),
+      tokenStatus(topology.getHosts().front().name == hostId) {
+  loadTopology(topology);
+}
+
+void TokenRingEngine::setTiming(const Timing& timing) {
+  this->timing = timing;
+}
+
+void TokenRingEngine::setGreetingCompression(bool enabled) {
+  compressGreetings = enabled;
+}
+
+void TokenRingEngine::setDirectTransferThreshold(size_t threshold) {
+  directTransferThreshold = threshold < TokenRingPacket::DataMaxSize
+                                ? threshold
+                                : TokenRingPacket::DataMaxSize;
+}
+
+void TokenRingEngine::setRoutedMessages(bool enabled) {
+  routedMessages = enabled;
+}
+
+void TokenRingEngine::setRing(uint8_t ring) { this->ring = ring; }
+
+void TokenRingEngine::setLane(size_t lane, size_t lanesCount) {
+  this->lane = lane;
+  this->lanesCount = lanesCount;
+}
+
+size_t TokenRingEngine::getLaneOf(const std::string& receiverName,
+                                  size_t lanesCount) {
+  if (lanesCount <= 1) {
+    return 0;
+  }
+
+  // FNV-1a, the same on every host
+  uint32_t hash = 2166136261u;
+  for (unsigned char c : receiverName) {
+    hash = (hash ^ c) * 16777619u;
+  }
+
+  return hash % lanesCount;
+}
+
+TokenRingPacket::MessageId_t TokenRingEngine::sendMessage(
+    const std::string& receiverName, const std::vector<unsigned char>& data,
+    bool compress) noexcept(false) {
+  bool direct = data.size() > directTransferThreshold &&
+                !TokenRingPacket::isMulticastReceiver(receiverName);
+  // Compressed message may get under threshold, it is decided below
+  if (direct && (!compress ||
+                 data.size() > TokenRingPacket::UncompressedDataMaxSize)) {
+    return queueDirectMessage(receiverName, data);
+  }
+
+  auto batch = openBatches.find(receiverName);
+
+  if (!compress && batch != openBatches.end() &&
+      batch->second->appendRecord(nextMessageId, data)) {
+    if (batch->second->getHeader().flags & TokenRingPacket::FLAG_SEQUENCED) {
+      SendStream& stream = sendStreams[receiverName];
+      stream.unacknowledged.insert(stream.nextSequence++);
+    }
+    return nextMessageId++;
+  }
+
+  TokenRingPacket packet = createDataPacket(receiverName, routedMessages);
+
+  try {
+    if (compress) {
+      packet.setDataCompressed(data);
+    } else {
+      packet.setData(data);
+    }
+  } catch (const TokenRingPacketTooMuchDataException&) {
+    // Sequence number that is never sent would hold send window forever
+    cancelDataPacket(packet);
+    if (direct) {
+      return queueDirectMessage(receiverName, data);
+    }
+    throw;
+  }
+
+  if (direct && packet.getHeader().dataSize > directTransferThreshold) {
+    cancelDataPacket(packet);
+    return queueDirectMessage(receiverName, data);
+  }
+
+  dataPackets.push(packet);
+
+  // Queue does not move its elements, only removed one is invalidated
+  if (packet.isCompressed()) {
+    openBatches.erase(receiverName);
+  } else {
+    openBatches[receiverName] = &dataPackets.back();
+  }
+
+  return packet.getHeader().messageId;
+}
+
+TokenRingPacket::MessageId_t TokenRingEngine::queueDirectMessage(
+    const std::string& receiverName,
+    const std::vector<unsigned char>& data) noexcept(false) {
+  if (data.size() > TokenRingPacket::DirectDataMaxSize) {
+    throw TokenRingPacketTooMuchDataException(
+        "Message is larger than TokenRingPacket::DirectDataMaxSize");
+  }
+
+  TokenRingPacket packet = createDataPacket(receiverName, routedMessages);
+
+  TokenRingPacket::Header header = packet.getHeader();
+  header.flags |= TokenRingPacket::FLAG_DIRECT;
+  packet.setHeader(header);
+
+  uint32_t size = htonl(static_cast<uint32_t>(data.size()));
+  const unsigned char* sizeBytes = reinterpret_cast<const unsigned char*>(&size);
+  packet.setData(std::vector<unsigned char>(sizeBytes, sizeBytes + sizeof(size)));
+
+  directPayloads[header.messageId] = data;
+  dataPackets.push(packet);
+
+  // Following messages get following sequence numbers, they cannot join
+  // frame queued before this one
+  openBatches.erase(receiverName);
+
+  return header.messageId;
+}
+
+void TokenRingEngine::sendDirectData(const TokenRingPacket& packet) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      header.packetReceiverName, TokenRingPacket::NameMaxSize);
+
+  auto payload = directPayloads.find(header.messageId);
+  if (payload == directPayloads.end()) {
+    return;
+  }
+
+  Socket::IpAndPortPair address =
+      std::make_pair(transport.getLocalIp(), transport.getLocalPort());
+  if (receiverName != hostId) {
+    auto knownAddress = hostAddresses.find(receiverName);
+    if (knownAddress == hostAddresses.end()) {
+      // Receiver, if there is one, finds message incomplete
+      Logger::getInstance().log("[" + hostId + "] Address of `" +
+                                receiverName + "` is unknown.");
+      return;
+    }
+    address = knownAddress->second;
+  }
+
+  TokenRingPacket::Header directHeader{};
+  directHeader.type = TokenRingPacket::PacketType::DIRECT;
+  std::memcpy(directHeader.originalSenderName, header.originalSenderName,
+              TokenRingPacket::NameMaxSize);
+  std::memcpy(directHeader.packetSenderName, header.originalSenderName,
+              TokenRingPacket::NameMaxSize);
+  std::memcpy(directHeader.packetReceiverName, header.packetReceiverName,
+              TokenRingPacket::NameMaxSize);
+  directHeader.messageId = header.messageId;
+
+  const std::vector<unsigned char>& data = payload->second;
+  for (size_t offset = 0; offset < data.size();
+       offset += TokenRingPacket::DataMaxSize) {
+    size_t size = data.size() - offset;
+    if (size > TokenRingPacket::DataMaxSize) {
+      size = TokenRingPacket::DataMaxSize;
+    }
+    directHeader.sequenceNumber =
+        static_cast<TokenRingPacket::SequenceNumber_t>(offset);
+
+    TokenRingPacket directPacket;
+    directPacket.setHeader(directHeader);
+    directPacket.setData(std::vector<unsigned char>(
+        data.begin() + offset, data.begin() + offset + size));
+
+    sendPacket(directPacket, address.first, address.second);
+  }
+}
+
+void TokenRingEngine::handleIncomingDirectPacket(
+    const TokenRingPacket& packet) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+
+  if (maybeNonterminatedCharArrayToString(header.packetReceiverName,
+                                          TokenRingPacket::NameMaxSize) !=
+      hostId) {
+    return;
+  }
+
+  size_t offset = header.sequenceNumber;
+  if (offset > TokenRingPacket::DirectDataMaxSize - header.dataSize) {
+    Logger::getInstance().log("[" + hostId +
+                              "] DIRECT packet exceeds message size limit.");
+    return;
+  }
+
+  DirectTransfer& transfer = directTransfers[std::make_pair(
+      maybeNonterminatedCharArrayToString(header.originalSenderName,
+                                          TokenRingPacket::NameMaxSize),
+      header.messageId)];
+  transfer.lastUpdate = now;
+
+  // Sent again with lost part
+  if (!transfer.offsets.insert(header.sequenceNumber).second) {
+    return;
+  }
+
+  if (transfer.data.size() < offset + header.dataSize) {
+    transfer.data.resize(offset + header.dataSize);
+  }
+  std::memcpy(transfer.data.data() + offset, packet.getRawData(),
+              header.dataSize);
+  transfer.receivedSize += header.dataSize;
+}
+
+bool TokenRingEngine::attachDirectData(const TokenRingPacket& packet,
+                                       const std::string& senderName) {
+  uint32_t size = 0;
+  if (records.size() != 1 || records[0].size != sizeof(size)) {
+    return false;
+  }
+  std::memcpy(&size, records[0].data, sizeof(size));
+  size = ntohl(size);
+
+  auto transfer = directTransfers.find(
+      std::make_pair(senderName, packet.getHeader().messageId));
+  if (transfer == directTransfers.end() ||
+      transfer->second.receivedSize != size ||
+      transfer->second.data.size() != size) {
+    return false;
+  }
+
+  records[0].data = transfer->second.data.data();
+  records[0].size = size;
+
+  return true;
+}
+
+void TokenRingEngine::dropStaleDirectTransfers() {
+  for (auto it = directTransfers.begin(); it != directTransfers.end();) {
+    if (now - it->second.lastUpdate >= timing.retransmissionTimeout) {
+      it = directTransfers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void TokenRingEngine::closeBatch(const TokenRingPacket& packet) {
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().packetReceiverName, TokenRingPacket::NameMaxSize);
+
+  auto batch = openBatches.find(receiverName);
+  if (batch != openBatches.end() && batch->second == &packet) {
+    openBatches.erase(batch);
+  }
+}
+
+void TokenRingEngine::setDeliveryReportHandler(
+    const DeliveryReportHandler& handler) {
+  deliveryReportHandler = handler;
+}
+
+void TokenRingEngine::setMessageHandler(const MessageHandler& handler) {
+  messageHandler = handler;
+}
+
+TokenRingPacket TokenRingEngine::createDataPacket(
+    const std::string& receiverName, bool routed) {
+  TokenRingPacket packet;
+
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::DATA;
+  header.tokenStatus = 1;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(receiverName, header.packetReceiverName,
+                                    TokenRingPacket::NameMaxSize);
+  header.messageId = nextMessageId++;
+
+  if (!TokenRingPacket::isMulticastReceiver(receiverName)) {
+    SendStream& stream = sendStreams[receiverName];
+    header.flags |= TokenRingPacket::FLAG_SEQUENCED;
+    header.sequenceNumber = stream.nextSequence;
+    stream.unacknowledged.insert(stream.nextSequence++);
+  }
+
+  if (routed) {
+    header.ring |= TokenRingPacket::RingRoutedBit;
+  }
+
+  packet.setHeader(header);
+
+  return packet;
+}
+
+void TokenRingEngine::cancelDataPacket(const TokenRingPacket& packet) {
+  if (!(packet.getHeader().flags & TokenRingPacket::FLAG_SEQUENCED)) {
+    return;
+  }
+
+  SendStream& stream =
+      sendStreams[maybeNonterminatedCharArrayToString(
+          packet.getHeader().packetReceiverName,
+          TokenRingPacket::NameMaxSize)];
+  stream.unacknowledged.erase(packet.getHeader().sequenceNumber);
+
+  // Nothing was numbered after it, receiver does not see the gap
+  if (stream.nextSequence == packet.getHeader().sequenceNumber + 1) {
+    --stream.nextSequence;
+  }
+}
+
+void TokenRingEngine::setRandomSeed(uint32_t seed) {
+  randomGenerator.seed(seed);
+}
+
+void TokenRingEngine::loadTopology(const Topology& topology) {
+  for (const Topology::Host& host : topology.getHosts()) {
+    if (host.name != hostId) {
+      rememberHost(host.name, host.ip, host.port);
+    }
+  }
+
+  previousHostName = topology.previousHostOf(hostId).name;
+  nextHostName = topology.nextHostOf(hostId).name;
+
+  joinedFromTopology = true;
+}
+
+void TokenRingEngine::setNextHost(const Ip4& ip, unsigned short port) {
+  nextHostIp = ip;
+  nextHostPort = port;
+  transport.setNextHost(ip, port);
+}
+
+void TokenRingEngine::sendJoinRequestToNextHost() {
+  using trppt = TokenRingPacket::PacketType;
+
+  TokenRingPacket joinPacket;
+
+  TokenRingPacket::Header header{};
+
+  header.type = trppt::JOIN;
+  header.tokenStatus = 1;
+
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength("", header.packetReceiverName,
+                                    TokenRingPacket::NameMaxSize);
+
+  insertStringToCharArrayWithLength("", header.neighborToDisconnectName,
+                                    TokenRingPacket::NameMaxSize);
+
+  header.registerIp = transport.getLocalIp();
+  header.registerPort = transport.getLocalPort();
+
+  joinPacket.setHeader(header);
+  joinPacket.setData({});
+
+  sendPacket(joinPacket, nextHostIp, nextHostPort);
+}
+
+void TokenRingEngine::handleIncomingJoinPacket(
+    TokenRingPacket incomingPacket) {
+  TokenRingPacket& packet = incomingPacket;
+
+  std::string joiningHostName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+
+  rememberHost(joiningHostName, packet.getHeader().registerIp,
+               packet.getHeader().registerPort);
+
+  // Joining host is placed between us and our previous host. Following joins
+  // are placed after it, so they can be batched into one update.
+  std::string repointHostName = previousHostName;
+  previousHostName = joiningHostName;
+
+  Logger::getInstance().log("[" + hostId +
+                            "] Host joining ring: " + joiningHostName);
+
+  queueMembershipEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::ADD, joiningHostName, repointHostName,
+      packet.getHeader().registerIp, packet.getHeader().registerPort));
+}
+
+void TokenRingEngine::handleIncomingRegisterPacket(TokenRingPacket& packet) {
+  if (packet.getHeader().tokenStatus) {
+    std::string originalSenderName = maybeNonterminatedCharArrayToString(
+        packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+
+    MembershipUpdate update;
+    bool updateValid = true;
+    try {
+      update.fromBinary(packet.getData());
+    } catch (const MembershipUpdateException& ex) {
+      Logger::getInstance().log("[" + hostId +
+                                "] Malformed REGISTER packet: " + ex.what());
+      updateValid = false;
+    }
+
+    if (!updateValid) {
+      // Nothing to apply, token is taken anyway
+    } else if (originalSenderName == hostId &&
+               !applyMembershipUpdate(update)) {
+      Logger::getInstance().log("[" + hostId +
+                                "] Dropping circulating REGISTER packet.");
+
+      if (membershipUpdatesInFlight > 0) {
+        --membershipUpdatesInFlight;
+      }
+    } else if (originalSenderName == hostId) {
+      // We were connected to new hosts, they have to see update too
+      Logger::getInstance().log("[" + hostId +
+                                "] Forwarding own REGISTER packet to new hosts.");
+
+      registerPackets.push(packet);
+    } else if (!acceptMembershipEpoch(originalSenderName, update.getEpoch())) {
+      Logger::getInstance().log("[" + hostId +
+                                "] Dropping duplicated REGISTER packet.");
+    } else {
+      applyMembershipUpdate(update);
+
+      TokenRingPacket::Header header = packet.getHeader();
+      insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                        TokenRingPacket::NameMaxSize);
+
+      packet.setHeader(header);
+
+      Logger::getInstance().log("[" + hostId +
+                                "] Forwarding REGISTER packet.");
+
+      registerPackets.push(packet);
+    }
+
+    // Own COMMIT came back, every other host took new order already
+    if (stagedRing.committed && originalSenderName == hostId) {
+      applyStagedRing();
+    }
+
+    tokenStatus = true;
+  } else {
+    Logger::getInstance().log(
+        "[" + hostId + "] Received REGISTER packet has no token. Passing.");
+  }
+}
+
+void TokenRingEngine::handleIncomingDataPacket(TokenRingPacket& packet) {
+  if (packet.getHeader().tokenStatus) {
+    std::string originalSenderName = maybeNonterminatedCharArrayToString(
+        packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+    std::string receiverName = maybeNonterminatedCharArrayToString(
+        packet.getHeader().packetReceiverName, TokenRingPacket::NameMaxSize);
+    bool ownPacket = originalSenderName == hostId;
+
+    if (departedHosts.count(originalSenderName) != 0) {
+      Logger::getInstance().log("[" + hostId +
+                                "] Stripping DATA packet of departed `" +
+                                originalSenderName + "`.");
+
+      releasingToken = true;
+      tokenStatus = true;
+      return;
+    }
+
+    hosts.insert(originalSenderName);
+    hosts.insert(maybeNonterminatedCharArrayToString(
+        packet.getHeader().packetSenderName, TokenRingPacket::NameMaxSize));
+
+    if (ownPacket && receiverName != hostId) {
+      // Frame went around the ring, receiver marked it on its way
+      handleReturnedDataPacket(packet);
+
+      Logger::getInstance().log("[" + hostId +
+                                "] Stripping returned DATA packet.");
+
+      // Next host sends first, so sender does not keep the ring for itself
+      releasingToken = true;
+    } else if (ownPacket) {
+      // Sent to ourselves, delivered without leaving ring
+      TokenRingPacket::Header header = packet.getHeader();
+      deliverDataPacket(packet, header);
+      packet.setHeader(header);
+
+      handleReturnedDataPacket(packet);
+    } else {
+      TokenRingPacket::Header header = packet.getHeader();
+
+      if (receiverName == hostId || acceptsMulticast(receiverName)) {
+        deliverDataPacket(packet, header);
+      }
+
+      // Frame goes back to original sender, which strips it
+      insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                        TokenRingPacket::NameMaxSize);
+
+      packet.setHeader(header);
+
+      Logger::getInstance().log("[" + hostId + "] Forwarding DATA packet.");
+
+      transitPackets.push(packet);
+    }
+
+    tokenStatus = true;
+  } else {
+    Logger::getInstance().log("[" + hostId +
+                              "] Received DATA packet has no token. Passing.");
+  }
+}
+
+void TokenRingEngine::deliverDataPacket(
+    const TokenRingPacket& packet, TokenRingPacket::Header& returnedHeader) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+  returnedHeader.flags |= TokenRingPacket::FLAG_ADDRESS_RECOGNIZED;
+
+  try {
+    // Forwarding hosts pass compressed data as is, receiver unpacks it
+    if (packet.isCompressed()) {
+      packet.decompressData(uncompressedData);
+      records.assign(1, TokenRingPacket::Record{header.messageId,
+                                                uncompressedData.data(),
+                                                uncompressedData.size()});
+    } else {
+      packet.getRecords(records);
+    }
+  } catch (const TokenRingPacketException& ex) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Received broken DATA packet: " + ex.what());
+    return;
+  }
+
+  ReceivedMessage message;
+  message.ring = ring;
+  message.routed = (header.ring & TokenRingPacket::RingRoutedBit) != 0;
+  message.senderName = maybeNonterminatedCharArrayToString(
+      header.originalSenderName, TokenRingPacket::NameMaxSize);
+  message.receiverName = maybeNonterminatedCharArrayToString(
+      header.packetReceiverName, TokenRingPacket::NameMaxSize);
+
+  if (header.flags & TokenRingPacket::FLAG_SEQUENCED) {
+    auto directTransfer = directTransfers.end();
+
+    if (header.flags & TokenRingPacket::FLAG_DIRECT) {
+      auto stream = receiveStreams.find(message.senderName);
+      bool delivered =
+          stream != receiveStreams.end() &&
+          SequenceBefore()(header.sequenceNumber,
+                           stream->second.expectedSequence);
+
+      if (!attachDirectData(packet, message.senderName) && !delivered) {
+        // Sender sends it all again
+        returnedHeader.copiedCount = 0;
+        returnedHeader.flags |= TokenRingPacket::FLAG_RECEIVER_BUSY;
+        return;
+      }
+
+      directTransfer = directTransfers.find(
+          std::make_pair(message.senderName, header.messageId));
+    }
+
+    MessageHandling handling = MessageHandling::TAKEN;
+    size_t copiedCount = deliverSequencedRecords(message, header, handling);
+
+    if (copiedCount == records.size() &&
+        directTransfer != directTransfers.end()) {
+      directTransfers.erase(directTransfer);
+    }
+
+    // Sender sends the rest again, refused one is reported not copied
+    returnedHeader.copiedCount = static_cast<uint16_t>(copiedCount);
+    if (copiedCount == records.size()) {
+      returnedHeader.flags |= TokenRingPacket::FLAG_FRAME_COPIED;
+    } else if (handling != MessageHandling::REFUSED) {
+      returnedHeader.flags |= TokenRingPacket::FLAG_RECEIVER_BUSY;
+    }
+    return;
+  }
+
+  size_t copiedCount = 0;
+  size_t refusedCount = 0;
+  for (const TokenRingPacket::Record& record : records) {
+    message.messageId = record.messageId;
+    message.data = record.data;
+    message.size = record.size;
+
+    MessageHandling handling = handOverMessage(message);
+    if (handling == MessageHandling::BUSY) {
+      break;
+    }
+    // Refused message is skipped, frame counts as copied by others
+    if (handling == MessageHandling::REFUSED) {
+      ++refusedCount;
+    } else {
+      ++copiedCount;
+    }
+  }
+
+  if (copiedCount == 0) {
+    if (refusedCount == 0) {
+      returnedHeader.flags |= TokenRingPacket::FLAG_RECEIVER_BUSY;
+    }
+    return;
+  }
+
+  // Multicast frame is either copied or sent again, rest of it cannot be
+  if (copiedCount + refusedCount < records.size()) {
+    Logger::getInstance().log(
+        "[" + hostId + "] Receiver got busy, " +
+        std::to_string(records.size() - copiedCount - refusedCount) + " of " +
+        std::to_string(records.size()) + " messages in frame dropped.");
+  }
+
+  returnedHeader.flags |= TokenRingPacket::FLAG_FRAME_COPIED;
+}
+
+size_t TokenRingEngine::deliverSequencedRecords(
+    ReceivedMessage& message, const TokenRingPacket::Header& header,
+    MessageHandling& handling) {
+  auto found = receiveStreams.find(message.senderName);
+  if (found == receiveStreams.end()) {
+    found = receiveStreams
+                .emplace(message.senderName,
+                         ReceiveStream{header.windowStart, {}})
+                .first;
+  }
+  ReceiveStream& stream = found->second;
+  SequenceBefore before;
+
+  // Sender gave up on messages before windowStart and reported them, the
+  // buffered ones were not acknowledged and go too
+  if (before(stream.expectedSequence, header.windowStart)) {
+    stream.reorderBuffer.erase(
+        stream.reorderBuffer.begin(),
+        stream.reorderBuffer.lower_bound(header.windowStart));
+    stream.expectedSequence = header.windowStart;
+  }
+  deliverBufferedMessages(stream, message);
+
+  // Only messages handed over in order are acknowledged
+  size_t copiedCount = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const TokenRingPacket::Record& record = records[i];
+    TokenRingPacket::SequenceNumber_t sequence =
+        header.sequenceNumber +
+        static_cast<TokenRingPacket::SequenceNumber_t>(i);
+
+    if (before(sequence, stream.expectedSequence)) {
+      // Sent again after it was handed over, acknowledged once more
+    } else if (sequence == stream.expectedSequence) {
+      message.messageId = record.messageId;
+      message.data = record.data;
+      message.size = record.size;
+      // Refused message is skipped once sender moves windowStart past it
+      handling = handOverMessage(message);
+      if (handling != MessageHandling::TAKEN) {
+        break;
+      }
+
+      stream.reorderBuffer.erase(sequence);
+      ++stream.expectedSequence;
+      deliverBufferedMessages(stream, message);
+    } else if (sequence - stream.expectedSequence < timing.sendWindow) {
+      // Earlier message is missing, this one waits for it. Sender sends it
+      // again, so the rest of frame is buffered too.
+      BufferedMessage& buffered = stream.reorderBuffer[sequence];
+      buffered.messageId = record.messageId;
+      buffered.data.assign(record.data, record.data + record.size);
+      continue;
+    } else {
+      break;
+    }
+
+    ++copiedCount;
+  }
+
+  return copiedCount;
+}
+
+void TokenRingEngine::deliverBufferedMessages(ReceiveStream& stream,
+                                              ReceivedMessage& message) {
+  while (!stream.reorderBuffer.empty() &&
+         stream.reorderBuffer.begin()->first == stream.expectedSequence) {
+    BufferedMessage& buffered = stream.reorderBuffer.begin()->second;
+    message.messageId = buffered.messageId;
+    message.data = buffered.data.data();
+    message.size = buffered.data.size();
+
+    // Sender sends it again, it is taken or refused from that frame
+    MessageHandling handling = handOverMessage(message);
+    if (handling == MessageHandling::REFUSED) {
+      stream.reorderBuffer.erase(stream.reorderBuffer.begin());
+    }
+    if (handling != MessageHandling::TAKEN) {
+      return;
+    }
+
+    stream.reorderBuffer.erase(stream.reorderBuffer.begin());
+    ++stream.expectedSequence;
+  }
+}
+
+TokenRingEngine::MessageHandling TokenRingEngine::handOverMessage(
+    const ReceivedMessage& message) {
+  if (messageHandler) {
+    return messageHandler(message);
+  }
+
+  Logger::getInstance().log(
+      "[" + hostId + "] Received DATA packet. Contents: \n" +
+      std::string(reinterpret_cast<const char*>(message.data), message.size));
+
+  return MessageHandling::TAKEN;
+}
+
+void TokenRingEngine::handleReturnedDataPacket(const TokenRingPacket& packet) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+  bool sequenced = (header.flags & TokenRingPacket::FLAG_SEQUENCED) != 0;
+
+  if (sequenced) {
+    auto inFlight = inFlightPackets.find(header.messageId);
+    if (inFlight == inFlightPackets.end()) {
+      // Presumed lost and sent again, the other copy is reported
+      Logger::getInstance().log("[" + hostId +
+                                "] Dropping late copy of DATA packet.");
+      return;
+    }
+    inFlightPackets.erase(inFlight);
+  }
+
+  readOwnRecords(packet);
+
+  size_t copiedCount = 0;
+  if (header.flags & TokenRingPacket::FLAG_FRAME_COPIED) {
+    copiedCount = records.size();
+  } else if (sequenced &&
+             (header.flags & TokenRingPacket::FLAG_ADDRESS_RECOGNIZED)) {
+    copiedCount = std::min<size_t>(header.copiedCount, records.size());
+  }
+
+  if (copiedCount > 0) {
+    receiverBackoffs.erase(maybeNonterminatedCharArrayToString(
+        header.packetReceiverName, TokenRingPacket::NameMaxSize));
+    reportDelivery(packet, 0, copiedCount, DeliveryStatus::DELIVERED);
+  }
+
+  if (copiedCount == records.size()) {
+    retransmissionsCounts.erase(header.messageId);
+    return;
+  }
+
+  DeliveryStatus status = DeliveryStatus::NOT_COPIED;
+  if (!(header.flags & TokenRingPacket::FLAG_ADDRESS_RECOGNIZED)) {
+    status = DeliveryStatus::RECEIVER_NOT_FOUND;
+  } else if (header.flags & TokenRingPacket::FLAG_RECEIVER_BUSY) {
+    status = DeliveryStatus::RECEIVER_BUSY;
+  }
+
+  if (status == DeliveryStatus::RECEIVER_BUSY &&
+      scheduleRetransmission(packet, copiedCount, true)) {
+    return;
+  }
+
+  // Receiver refused one message, the ones after it are sent again
+  size_t reportedCount = records.size();
+  if (status == DeliveryStatus::NOT_COPIED && sequenced &&
+      copiedCount + 1 < records.size()) {
+    reportedCount = copiedCount + 1;
+    retransmittedPackets.push(
+        createRetransmissionPacket(packet, reportedCount));
+  }
+
+  retransmissionsCounts.erase(header.messageId);
+  reportDelivery(packet, copiedCount, reportedCount, status);
+}
+
+void TokenRingEngine::readOwnRecords(const TokenRingPacket& packet) {
+  records.assign(
+      1, TokenRingPacket::Record{packet.getHeader().messageId, nullptr, 0});
+
+  if (!packet.isCompressed()) {
+    try {
+      packet.getRecords(records);
+    } catch (const TokenRingPacketException&) {
+      records.assign(1, TokenRingPacket::Record{packet.getHeader().messageId,
+                                                nullptr, 0});
+    }
+  }
+}
+
+void TokenRingEngine::reportDelivery(const TokenRingPacket& packet,
+                                     size_t first, size_t last,
+                                     DeliveryStatus status) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+
+  DeliveryReport report;
+  report.receiverName = maybeNonterminatedCharArrayToString(
+      header.packetReceiverName, TokenRingPacket::NameMaxSize);
+  report.status = status;
+
+  auto stream = sendStreams.end();
+  if (header.flags & TokenRingPacket::FLAG_SEQUENCED) {
+    stream = sendStreams.find(report.receiverName);
+  }
+
+  // Every message sharing frame gets its report
+  for (size_t i = first; i < last; ++i) {
+    report.messageId = records[i].messageId;
+
+    if (header.flags & TokenRingPacket::FLAG_DIRECT) {
+      directPayloads.erase(report.messageId);
+    }
+
+    if (stream != sendStreams.end()) {
+      stream->second.unacknowledged.erase(
+          header.sequenceNumber +
+          static_cast<TokenRingPacket::SequenceNumber_t>(i));
+    }
+
+    if (report.status != DeliveryStatus::DELIVERED) {
+      Logger::getInstance().log(
+          "[" + hostId + "] Message " + std::to_string(report.messageId) +
+          " for `" + report.receiverName + "` was not delivered.");
+    }
+
+    if (deliveryReportHandler) {
+      deliveryReportHandler(report);
+    }
+  }
+}
+
+bool TokenRingEngine::isBehindUnacknowledged(const TokenRingPacket& packet,
+                                             size_t firstRecord) const {
+  const TokenRingPacket::Header& header = packet.getHeader();
+  if (!(header.flags & TokenRingPacket::FLAG_SEQUENCED)) {
+    return false;
+  }
+
+  auto stream = sendStreams.find(maybeNonterminatedCharArrayToString(
+      header.packetReceiverName, TokenRingPacket::NameMaxSize));
+  if (stream == sendStreams.end() || stream->second.unacknowledged.empty()) {
+    return false;
+  }
+
+  return SequenceBefore()(
+      *stream->second.unacknowledged.begin(),
+      header.sequenceNumber +
+          static_cast<TokenRingPacket::SequenceNumber_t>(firstRecord));
+}
+
+bool TokenRingEngine::scheduleRetransmission(const TokenRingPacket& packet,
+                                             size_t firstRecord,
+                                             bool receiverBusy) {
+  const TokenRingPacket::Header& header = packet.getHeader();
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      header.packetReceiverName, TokenRingPacket::NameMaxSize);
+
+  // Members that copied multicast would get it twice
+  if (TokenRingPacket::isMulticastReceiver(receiverName)) {
+    return false;
+  }
+
+  unsigned int retransmissionsCount = 0;
+  auto counted = retransmissionsCounts.find(header.messageId);
+  if (counted != retransmissionsCounts.end()) {
+    retransmissionsCount = counted->second;
+    retransmissionsCounts.erase(counted);
+  }
+
+  if (retransmissionsCount >= timing.maxRetransmissions) {
+    return false;
+  }
+
+  // Receiver keeps messages that came before earlier ones, waiting for those
+  // is not counted
+  bool waitingForEarlier =
+      receiverBusy && isBehindUnacknowledged(packet, firstRecord);
+  if (!waitingForEarlier) {
+    ++retransmissionsCount;
+  }
+
+  TokenRingPacket retransmittedPacket =
+      createRetransmissionPacket(packet, firstRecord);
+  retransmissionsCounts[retransmittedPacket.getHeader().messageId] =
+      retransmissionsCount;
+
+  if (!receiverBusy) {
+    Logger::getInstance().log(
+        "[" + hostId + "] DATA packet for `" + receiverName +
+        "` did not come back. Sending it again.");
+
+    retransmittedPackets.push(retransmittedPacket);
+    return true;
+  }
+
+  // Nor does it back off further, earlier message would never get its turn
+  ReceiverBackoff& backoff = receiverBackoffs[receiverName];
+  if (!waitingForEarlier) {
+    backoff.delay = std::min(
+        std::max(backoff.delay * 2, timing.receiverBusyBackoff),
+        timing.maxReceiverBusyBackoff);
+    backoff.retryTime = now + backoff.delay;
+  }
+
+  heldPackets[receiverName].push(retransmittedPacket);
+
+  Logger::getInstance().log(
+      "[" + hostId + "] Receiver `" + receiverName + "` is busy. Message " +
+      std::to_string(records[firstRecord].messageId) + " is sent again in " +
+      std::to_string(backoff.delay.count()) + " ms.");
+
+  return true;
+}
+
+TokenRingPacket TokenRingEngine::createRetransmissionPacket(
+    const TokenRingPacket& packet, size_t firstRecord) {
+  TokenRingPacket::Header header = packet.getHeader();
+  header.flags &= ~(TokenRingPacket::FLAG_ADDRESS_RECOGNIZED |
+                    TokenRingPacket::FLAG_FRAME_COPIED |
+                    TokenRingPacket::FLAG_RECEIVER_BUSY);
+  header.copiedCount = 0;
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+
+  TokenRingPacket retransmittedPacket = packet;
+  if (firstRecord == 0) {
+    retransmittedPacket.setHeader(header);
+    return retransmittedPacket;
+  }
+
+  // Copied messages are left out, the rest keeps its ids and numbers
+  header.messageId = records[firstRecord].messageId;
+  header.sequenceNumber +=
+      static_cast<TokenRingPacket::SequenceNumber_t>(firstRecord);
+  retransmittedPacket.setHeader(header);
+  retransmittedPacket.setData(
+      std::vector<unsigned char>(records[firstRecord].data,
+                                 records[firstRecord].data +
+                                     records[firstRecord].size));
+
+  for (size_t i = firstRecord + 1; i < records.size(); ++i) {
+    retransmittedPacket.appendRecord(
+        records[i].messageId,
+        std::vector<unsigned char>(records[i].data,
+                                   records[i].data + records[i].size));
+  }
+
+  return retransmittedPacket;
+}
+
+void TokenRingEngine::checkInFlightPackets() {
+  for (auto it = inFlightPackets.begin(); it != inFlightPackets.end();) {
+    if (now - it->second.sentTime < timing.retransmissionTimeout) {
+      ++it;
+      continue;
+    }
+
+    TokenRingPacket packet = std::move(it->second.packet);
+    it = inFlightPackets.erase(it);
+
+    readOwnRecords(packet);
+    if (!scheduleRetransmission(packet, 0, false)) {
+      reportDelivery(packet, 0, records.size(), DeliveryStatus::LOST);
+    }
+  }
+}
+
+void TokenRingEngine::checkTokenLoss() {
+  if (!awaitingToken || now < tokenLossDeadline) {
+    return;
+  }
+  awaitingToken = false;
+
+  // Every frame passes us within rotation, only we know token is gone since
+  // it left with our frame
+  if (!tokenStatus) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Token did not come back. Regenerating "
+                              "token.");
+
+    tokenStatus = true;
+    // Token that was only late is dropped by hosts that see this one
+    tokenEpoch = getNextTokenEpoch();
+    replacedTokenLeftTime = tokenLeftTime;
+    replacedTokenEpoch = tokenLeftEpoch;
+  }
+}
+
+void TokenRingEngine::measureTokenRotation(const TokenRingPacket& packet) {
+  Clock::duration sample;
+  if (awaitingToken && packet.getHeader().tokenEpoch == tokenLeftEpoch) {
+    sample = now - tokenLeftTime;
+  } else if (replacedTokenLeftTime != TimePoint() &&
+             packet.getHeader().tokenEpoch == replacedTokenEpoch) {
+    // Token was only slow, it was regenerated too early
+    sample = now - replacedTokenLeftTime;
+    replacedTokenLeftTime = TimePoint();
+  } else {
+    return;
+  }
+
+  if (sample > rotationTime) {
+    rotationTime = sample;
+  } else {
+    rotationTime -= (rotationTime - sample) / RotationTimeSmoothing;
+  }
+}
+
+TokenRingPacket::TokenEpoch_t TokenRingEngine::getNextTokenEpoch() const {
+  // Hosts before this one, hostAddresses is sorted by name
+  auto rank = static_cast<TokenRingPacket::TokenEpoch_t>(std::distance(
+      hostAddresses.begin(), hostAddresses.lower_bound(hostId)));
+  rank = rank < TokenEpochRanks ? rank : TokenEpochRanks - 1;
+
+  return (tokenEpoch / TokenEpochRanks + 1) * TokenEpochRanks + rank;
+}
+
+bool TokenRingEngine::acceptTokenEpoch(const TokenRingPacket& packet) {
+  if (packet.getHeader().tokenEpoch < tokenEpoch) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Dropping frame of replaced token.");
+    return false;
+  }
+
+  tokenEpoch = packet.getHeader().tokenEpoch;
+  return true;
+}
+
+bool TokenRingEngine::isOwnSequencedPacket(
+    const TokenRingPacket& packet) const {
+  return packet.getHeader().type == TokenRingPacket::PacketType::DATA &&
+         (packet.getHeader().flags & TokenRingPacket::FLAG_SEQUENCED) &&
+         maybeNonterminatedCharArrayToString(
+             packet.getHeader().originalSenderName,
+             TokenRingPacket::NameMaxSize) == hostId;
+}
+
+TokenRingPacket::SequenceNumber_t TokenRingEngine::getWindowStart(
+    const std::string& receiverName) const {
+  auto stream = sendStreams.find(receiverName);
+  if (stream == sendStreams.end()) {
+    return 0;
+  }
+
+  if (stream->second.unacknowledged.empty()) {
+    return stream->second.nextSequence;
+  }
+
+  return *stream->second.unacknowledged.begin();
+}
+
+bool TokenRingEngine::isReceiverBlocked(const TokenRingPacket& packet) const {
+  if (packet.getHeader().type != TokenRingPacket::PacketType::DATA) {
+    return false;
+  }
+
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().packetReceiverName, TokenRingPacket::NameMaxSize);
+
+  auto backoff = receiverBackoffs.find(receiverName);
+  if (backoff != receiverBackoffs.end() && backoff->second.retryTime > now) {
+    return true;
+  }
+
+  return isOwnSequencedPacket(packet) &&
+         packet.getHeader().sequenceNumber - getWindowStart(receiverName) >=
+             timing.sendWindow;
+}
+
+bool TokenRingEngine::holdPacketForBlockedReceiver(
+    const TokenRingPacket& packet) {
+  if (!isReceiverBlocked(packet)) {
+    return false;
+  }
+
+  std::string receiverName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().packetReceiverName, TokenRingPacket::NameMaxSize);
+  heldPackets[receiverName].push(packet);
+
+  return true;
+}
+
+void TokenRingEngine::releaseHeldPackets() {
+  for (auto it = heldPackets.begin(); it != heldPackets.end();) {
+    std::queue<TokenRingPacket>& packets = it->second;
+
+    while (!packets.empty() && !isReceiverBlocked(packets.front())) {
+      retransmittedPackets.push(packets.front());
+      packets.pop();
+    }
+
+    if (packets.empty()) {
+      it = heldPackets.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool TokenRingEngine::acceptsMulticast(const std::string& receiverName) const {
+  return receiverName == TokenRingPacket::BroadcastReceiverName ||
+         groups.count(receiverName) != 0;
+}
+
+void TokenRingEngine::handleIncomingHeartbeatPacket(TokenRingPacket& packet) {
+  std::string senderName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+
+  rememberHost(senderName, packet.getHeader().registerIp,
+               packet.getHeader().registerPort);
+
+  previousHostKnown = true;
+  previousHostHeartbeatName = senderName;
+  previousHostAddress = std::make_pair(packet.getHeader().registerIp,
+                                       packet.getHeader().registerPort);
+
+  // Once all our membership changes went around the ring, heartbeat sender
+  // is our real previous host
+  if (pendingMembershipEntries.empty() && membershipUpdatesInFlight == 0) {
+    previousHostName = senderName;
+  }
+
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::HEARTBEAT_ACK;
+  header.tokenStatus = tokenStatus ? 1 : 0;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(senderName, header.packetReceiverName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(nextHostName,
+                                    header.neighborToDisconnectName,
+                                    TokenRingPacket::NameMaxSize);
+  header.registerIp = nextHostIp;
+  header.registerPort = nextHostPort;
+
+  TokenRingPacket ackPacket;
+  ackPacket.setHeader(header);
+  ackPacket.setData({});
+
+  sendPacket(ackPacket, packet.getHeader().registerIp,
+             packet.getHeader().registerPort);
+}
+
+void TokenRingEngine::handleIncomingHeartbeatAckPacket(
+    TokenRingPacket& packet) {
+  std::string responderName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+
+  if (!nextHostName.empty() && nextHostName != responderName) {
+    // Late answer from host we are no longer connected to
+    return;
+  }
+
+  nextHostName = responderName;
+  nextNextHostName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().neighborToDisconnectName,
+      TokenRingPacket::NameMaxSize);
+  nextNextHost = std::make_pair(packet.getHeader().registerIp,
+                                packet.getHeader().registerPort);
+  nextNextHostKnown = true;
+  nextHostHoldsToken = packet.getHeader().tokenStatus != 0;
+  lastHeartbeatAck = now;
+  waitingForNextHost = false;
+}
+
+void TokenRingEngine::rememberHost(const std::string& name, const Ip4& ip,
+                                   unsigned short port) {
+  if (name.empty()) {
+    return;
+  }
+
+  hosts.insert(name);
+  hostAddresses[name] = std::make_pair(ip, port);
+  departedHosts.erase(name);
+}
+
+void TokenRingEngine::forgetHost(const std::string& name) {
+  hosts.erase(name);
+  hostAddresses.erase(name);
+  departedHosts.insert(name);
+  // Host that comes back numbers its messages anew
+  receiveStreams.erase(name);
+
+  roundTripTimes.erase(name);
+  pendingProbes.erase(name);
+  ringOrdering.forgetHost(name);
+}
+
+void TokenRingEngine::resetNextHostLiveness(const std::string& name) {
+  nextHostName = name;
+  nextNextHostKnown = false;
+  nextHostHoldsToken = false;
+  lastHeartbeatAck = now;
+}
+
+void TokenRingEngine::sendToNextHost(const TokenRingPacket& packet) {
+  if (!packet.getHeader().tokenStatus) {
+    sendPacket(packet, nextHostIp, nextHostPort);
+    return;
+  }
+
+  TokenRingPacket tokenPacket = packet;
+  TokenRingPacket::Header header = packet.getHeader();
+  header.tokenEpoch = tokenEpoch;
+  tokenPacket.setHeader(header);
+  sendPacket(tokenPacket, nextHostIp, nextHostPort);
+
+  lastTokenPassed = now;
+}
+
+void TokenRingEngine::sendHeartbeatToNextHost() {
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::HEARTBEAT;
+  header.tokenStatus = 0;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  header.registerIp = transport.getLocalIp();
+  header.registerPort = transport.getLocalPort();
+
+  TokenRingPacket heartbeatPacket;
+  heartbeatPacket.setHeader(header);
+  heartbeatPacket.setData({});
+
+  sendPacket(heartbeatPacket, nextHostIp, nextHostPort);
+}
+
+void TokenRingEngine::queueMembershipEntry(
+    const MembershipUpdate::Entry& entry) {
+  pendingMembershipEntries.push_back(entry);
+}
+
+bool TokenRingEngine::acceptMembershipEpoch(
+    const std::string& originalSenderName, MembershipUpdate::Epoch_t epoch) {
+  auto it = lastMembershipEpochs.find(originalSenderName);
+  if (it != lastMembershipEpochs.end() && epoch <= it->second) {
+    return false;
+  }
+
+  lastMembershipEpochs[originalSenderName] = epoch;
+  return true;
+}
+
+bool TokenRingEngine::applyMembershipUpdate(const MembershipUpdate& update) {
+  bool nextHostChanged = false;
+  membershipEpoch = std::max(membershipEpoch, update.getEpoch());
+
+  for (const MembershipUpdate::Entry& entry : update.getEntries()) {
+    std::string name = maybeNonterminatedCharArrayToString(
+        entry.hostName, TokenRingPacket::NameMaxSize);
+    std::string repointHostName = maybeNonterminatedCharArrayToString(
+        entry.repointHostName, TokenRingPacket::NameMaxSize);
+
+    // Ring keeps old order until COMMIT goes on, see applyStagedRing()
+    if (entry.action == MembershipUpdate::Action::MOVE) {
+      if (name == hostId) {
+        stagedRing.previousHostKnown = true;
+        stagedRing.previousHostName = repointHostName;
+      }
+      stagedRing.nextHostNames[repointHostName] = name;
+      if (repointHostName == hostId) {
+        stagedRing.nextHostKnown = true;
+        stagedRing.nextHostName = name;
+        stagedRing.nextHost = std::make_pair(entry.ip, entry.port);
+      }
+      continue;
+    } else if (entry.action == MembershipUpdate::Action::COMMIT) {
+      stagedRing.committed = true;
+      continue;
+    }
+
+    if (name == hostId) {
+      if (entry.action == MembershipUpdate::Action::ADD) {
+        previousHostName = repointHostName;
+      }
+      continue;
+    }
+
+    if (entry.action == MembershipUpdate::Action::ADD) {
+      rememberHost(name, entry.ip, entry.port);
+    } else if (entry.action == MembershipUpdate::Action::REMOVE) {
+      forgetHost(name);
+    }
+
+    if (repointHostName == hostId &&
+        (nextHostIp.s_addr != entry.ip.s_addr || nextHostPort != entry.port)) {
+      setNextHost(entry.ip, entry.port);
+      resetNextHostLiveness(
+          entry.action == MembershipUpdate::Action::ADD ? name : "");
+      nextHostChanged = true;
+
+      Logger::getInstance().log("[" + hostId + "] Connecting to " +
+                                ::to_string(entry.ip) + ":" +
+                                std::to_string(entry.port) + ".");
+    }
+  }
+
+  return nextHostChanged;
+}
+
+TokenRingPacket TokenRingEngine::createMembershipUpdatePacket() {
+  MembershipUpdate update;
+  update.setEpoch(++membershipEpoch);
+
+  auto it = pendingMembershipEntries.begin();
+  for (; it != pendingMembershipEntries.end() && !update.isFull(); ++it) {
+    update.addEntry(*it);
+  }
+  pendingMembershipEntries.erase(pendingMembershipEntries.begin(), it);
+
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::REGISTER;
+  header.tokenStatus = 1;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+
+  TokenRingPacket packet;
+  packet.setHeader(header);
+  packet.setData(update.toBinary());
+
+  return packet;
+}
+
+void TokenRingEngine::sendProbes() {
+  // Hosts with known address, which excludes this one
+  size_t probesCount =
+      std::min<size_t>(timing.probesPerHeartbeat, hostAddresses.size());
+
+  for (size_t i = 0; i < probesCount; ++i) {
+    auto host = hostAddresses.upper_bound(lastProbedHostName);
+    if (host == hostAddresses.end()) {
+      // Every host was probed, coordinator gets results of the round
+      sendLatencyReport();
+      host = hostAddresses.begin();
+    }
+    lastProbedHostName = host->first;
+
+    TokenRingPacket::Header header{};
+    header.type = TokenRingPacket::PacketType::PROBE;
+    header.tokenStatus = 0;
+    insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                      TokenRingPacket::NameMaxSize);
+    insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                      TokenRingPacket::NameMaxSize);
+    insertStringToCharArrayWithLength(host->first, header.packetReceiverName,
+                                      TokenRingPacket::NameMaxSize);
+    header.messageId = nextProbeId;
+    header.registerIp = transport.getLocalIp();
+    header.registerPort = transport.getLocalPort();
+
+    TokenRingPacket probePacket;
+    probePacket.setHeader(header);
+    probePacket.setData({});
+
+    // Unanswered probe is replaced by the next one
+    pendingProbes[host->first] = Probe{nextProbeId++, now};
+
+    sendPacket(probePacket, host->second.first, host->second.second);
+  }
+}
+
+void TokenRingEngine::handleIncomingProbePacket(TokenRingPacket& packet) {
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::PROBE_ACK;
+  header.tokenStatus = 0;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(
+      maybeNonterminatedCharArrayToString(
+          packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize),
+      header.packetReceiverName, TokenRingPacket::NameMaxSize);
+  header.messageId = packet.getHeader().messageId;
+
+  TokenRingPacket ackPacket;
+  ackPacket.setHeader(header);
+  ackPacket.setData({});
+
+  sendPacket(ackPacket, packet.getHeader().registerIp,
+             packet.getHeader().registerPort);
+}
+
+void TokenRingEngine::handleIncomingProbeAckPacket(TokenRingPacket& packet) {
+  std::string responderName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+
+  auto probe = pendingProbes.find(responderName);
+  if (probe == pendingProbes.end() ||
+      probe->second.probeId != packet.getHeader().messageId) {
+    return;
+  }
+
+  // Kernel timestamp is moved between clocks, it may be slightly off
+  auto sample = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::max(frameReceiveTime, probe->second.sentTime) -
+      probe->second.sentTime);
+  pendingProbes.erase(probe);
+
+  auto roundTripTime = roundTripTimes.find(responderName);
+  if (roundTripTime == roundTripTimes.end()) {
+    roundTripTimes[responderName] = sample;
+  } else {
+    roundTripTime->second +=
+        (sample - roundTripTime->second) / RoundTripTimeSmoothing;
+  }
+}
+
+void TokenRingEngine::sendLatencyReport() {
+  const std::string& coordinatorName = getCoordinatorName();
+
+  if (coordinatorName == hostId) {
+    ringOrdering.setNextHost(hostId, nextHostName);
+    for (const auto& roundTripTime : roundTripTimes) {
+      ringOrdering.setRoundTripTime(hostId, roundTripTime.first,
+                                    roundTripTime.second);
+    }
+    return;
+  }
+
+  auto address = hostAddresses.find(coordinatorName);
+  if (address == hostAddresses.end()) {
+    return;
+  }
+
+  auto roundTripTime = roundTripTimes.begin();
+  do {
+    LatencyReport report;
+    for (; roundTripTime != roundTripTimes.end() && !report.isFull();
+         ++roundTripTime) {
+      report.addEntry(LatencyReport::createEntry(
+          roundTripTime->first,
+          static_cast<uint32_t>(std::min<int64_t>(
+              roundTripTime->second.count(),
+              std::numeric_limits<uint32_t>::max()))));
+    }
+
+    TokenRingPacket::Header header{};
+    header.type = TokenRingPacket::PacketType::LATENCY_REPORT;
+    header.tokenStatus = 0;
+    insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                      TokenRingPacket::NameMaxSize);
+    insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                      TokenRingPacket::NameMaxSize);
+    insertStringToCharArrayWithLength(coordinatorName,
+                                      header.packetReceiverName,
+                                      TokenRingPacket::NameMaxSize);
+    insertStringToCharArrayWithLength(nextHostName,
+                                      header.neighborToDisconnectName,
+                                      TokenRingPacket::NameMaxSize);
+
+    TokenRingPacket reportPacket;
+    reportPacket.setHeader(header);
+    reportPacket.setData(report.toBinary());
+
+    sendPacket(reportPacket, address->second.first, address->second.second);
+  } while (roundTripTime != roundTripTimes.end());
+}
+
+void TokenRingEngine::handleIncomingLatencyReportPacket(
+    TokenRingPacket& packet) {
+  if (getCoordinatorName() != hostId) {
+    return;
+  }
+
+  LatencyReport report;
+  try {
+    report.fromBinary(packet.getData());
+  } catch (const LatencyReportException& ex) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Malformed LATENCY_REPORT packet: " +
+                              ex.what());
+    return;
+  }
+
+  std::string senderName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+  ringOrdering.setNextHost(senderName,
+                           maybeNonterminatedCharArrayToString(
+                               packet.getHeader().neighborToDisconnectName,
+                               TokenRingPacket::NameMaxSize));
+
+  for (const LatencyReport::Entry& entry : report.getEntries()) {
+    ringOrdering.setRoundTripTime(
+        senderName,
+        maybeNonterminatedCharArrayToString(entry.hostName,
+                                            TokenRingPacket::NameMaxSize),
+        std::chrono::microseconds(entry.roundTripTime));
+  }
+}
+
+const std::string& TokenRingEngine::getCoordinatorName() const {
+  if (hostAddresses.empty() || hostId < hostAddresses.begin()->first) {
+    return hostId;
+  }
+
+  return hostAddresses.begin()->first;
+}
+
+void TokenRingEngine::reorderRing() {
+  nextReorderTime = now + timing.reorderInterval;
+
+  // Ring is not rewired while other membership changes go around
+  if (getCoordinatorName() != hostId || hostAddresses.size() < 3 ||
+      !pendingMembershipEntries.empty() || membershipUpdatesInFlight > 0 ||
+      !registerPackets.empty()) {
+    return;
+  }
+
+  ringOrdering.setNextHost(hostId, nextHostName);
+
+  std::set<std::string> members{hostId};
+  for (const auto& address : hostAddresses) {
+    members.insert(address.first);
+  }
+
+  // Empty until every host reported, and while reports disagree
+  std::vector<std::string> order =
+      ringOrdering.getCurrentOrder(hostId, members);
+  if (order.empty()) {
+    return;
+  }
+
+  std::vector<std::string> optimizedOrder = ringOrdering.optimize(order);
+  RingOrdering::Duration rotationTime = ringOrdering.getRotationTime(order);
+  RingOrdering::Duration optimizedRotationTime =
+      ringOrdering.getRotationTime(optimizedOrder);
+
+  if (optimizedRotationTime.count() * 100 >
+      rotationTime.count() * (100 - MinReorderGainPercent)) {
+    return;
+  }
+
+  Logger::getInstance().log(
+      "[" + hostId + "] Reordering ring, estimated rotation time " +
+      std::to_string(rotationTime.count()) + " us -> " +
+      std::to_string(optimizedRotationTime.count()) + " us.");
+
+  queueRingOrder(optimizedOrder);
+}
+
+bool TokenRingEngine::isRingCoordinator() const {
+  return getCoordinatorName() == hostId;
+}
+
+bool TokenRingEngine::requestRingOrder(const std::vector<std::string>& order) {
+  if (!isRingCoordinator() || !pendingMembershipEntries.empty() ||
+      membershipUpdatesInFlight > 0 || !registerPackets.empty()) {
+    return false;
+  }
+
+  std::set<std::string> members{hostId};
+  for (const auto& address : hostAddresses) {
+    members.insert(address.first);
+  }
+  if (std::set<std::string>(order.begin(), order.end()) != members ||
+      order.size() != members.size()) {
+    return false;
+  }
+
+  Logger::getInstance().log("[" + hostId + "] Reordering ring on request.");
+
+  queueRingOrder(order);
+  return true;
+}
+
+void TokenRingEngine::queueRingOrder(const std::vector<std::string>& order) {
+  // Every link is listed, so hosts with stale reports get rewired too
+  for (size_t i = 0; i < order.size(); ++i) {
+    const std::string& repointHostName = order[i];
+    const std::string& name = order[(i + 1) % order.size()];
+
+    Socket::IpAndPortPair address =
+        name == hostId
+            ? std::make_pair(transport.getLocalIp(), transport.getLocalPort())
+            : hostAddresses.at(name);
+
+    queueMembershipEntry(MembershipUpdate::createEntry(
+        MembershipUpdate::Action::MOVE, name, repointHostName, address.first,
+        address.second));
+    ringOrdering.setNextHost(repointHostName, name);
+  }
+
+  queueMembershipEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::COMMIT, hostId, hostId,
+      transport.getLocalIp(), transport.getLocalPort()));
+}
+
+bool TokenRingEngine::carriesRingCommit(const TokenRingPacket& packet) const {
+  if (packet.getHeader().type != TokenRingPacket::PacketType::REGISTER) {
+    return false;
+  }
+
+  try {
+    MembershipUpdate update(packet.getData());
+    for (const MembershipUpdate::Entry& entry : update.getEntries()) {
+      if (entry.action == MembershipUpdate::Action::COMMIT) {
+        return true;
+      }
+    }
+  } catch (const MembershipUpdateException&) {
+  }
+
+  return false;
+}
+
+void TokenRingEngine::applyStagedRing() {
+  if (stagedRing.previousHostKnown) {
+    previousHostName = stagedRing.previousHostName;
+  }
+
+  if (stagedRing.nextHostKnown &&
+      (nextHostIp.s_addr != stagedRing.nextHost.first.s_addr ||
+       nextHostPort != stagedRing.nextHost.second)) {
+    setNextHost(stagedRing.nextHost.first, stagedRing.nextHost.second);
+    resetNextHostLiveness(stagedRing.nextHostName);
+
+    Logger::getInstance().log("[" + hostId +
+                              "] Ring reordered. Connecting to " +
+                              ::to_string(nextHostIp) + ":" +
+                              std::to_string(nextHostPort) + ".");
+  }
+
+  // MOVE entries list every link, so whole order is known here
+  std::vector<std::string> order{hostId};
+  auto next = stagedRing.nextHostNames.find(hostId);
+  while (next != stagedRing.nextHostNames.end() && next->second != hostId &&
+         order.size() < stagedRing.nextHostNames.size()) {
+    order.push_back(next->second);
+    next = stagedRing.nextHostNames.find(next->second);
+  }
+  bool orderComplete = next != stagedRing.nextHostNames.end() &&
+                       next->second == hostId &&
+                       order.size() == stagedRing.nextHostNames.size();
+
+  stagedRing = StagedRing();
+
+  if (orderComplete && ringOrderHandler) {
+    ringOrderHandler(order);
+  }
+}
+
+void TokenRingEngine::setRingOrderHandler(const RingOrderHandler& handler) {
+  ringOrderHandler = handler;
+}
+
+TokenRingPacket TokenRingEngine::createGreetingPacket() {
+  std::string packetReceiver = "";
+  if (lanesCount > 1) {
+    std::vector<std::string> laneHosts;
+    for (const std::string& host : hosts) {
+      if (getLaneOf(host, lanesCount) == lane) {
+        laneHosts.push_back(host);
+      }
+    }
+
+    packetReceiver = hostId;
+    if (!laneHosts.empty()) {
+      packetReceiver = laneHosts[random<size_t>(0, laneHosts.size() - 1,
+                                                randomGenerator)];
+    }
+  } else if (hosts.size() != 0) {
+    int idx = static_cast<int>(
+        random(0, static_cast<int>(hosts.size() - 1), randomGenerator));
+
+    packetReceiver = getNthElement(hosts, idx).first;
+  } else {
+    packetReceiver = hostId;
+  }
+
+  TokenRingPacket dataPacket = createDataPacket(packetReceiver);
+
+  std::string message = "Greetings from " + hostId;
+  std::vector<unsigned char> messageBuffer;
+  messageBuffer.resize(message.size());
+
+  std::memcpy(messageBuffer.data(), message.c_str(), message.size());
+
+  if (compressGreetings) {
+    dataPacket.setDataCompressed(messageBuffer);
+  } else {
+    dataPacket.setData(messageBuffer);
+  }
+
+  Logger::getInstance().log("[" + hostId + "] Sending greetings packet to `" +
+                            packetReceiver + "`");
+
+  return dataPacket;
+}
+
+TokenRingPacket TokenRingEngine::createFreeTokenPacket() {
+  TokenRingPacket packet;
+
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::NONE;
+  header.tokenStatus = 1;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  packet.setHeader(header);
+
+  return packet;
+}
+
+std::queue<TokenRingPacket>* TokenRingEngine::selectPacketsToSend() {
+  if (registerPackets.empty() && !pendingMembershipEntries.empty()) {
+    size_t changesCount = pendingMembershipEntries.size();
+    registerPackets.push(createMembershipUpdatePacket());
+    changesCount -= pendingMembershipEntries.size();
+    ++membershipUpdatesInFlight;
+
+    Logger::getInstance().log("[" + hostId + "] REGISTER packet with " +
+                              std::to_string(changesCount) +
+                              " membership changes created.");
+  }
+
+  releaseHeldPackets();
+
+  // Own DATA for busy receivers or beyond send window does not take token
+  while (!retransmittedPackets.empty() &&
+         holdPacketForBlockedReceiver(retransmittedPackets.front())) {
+    retransmittedPackets.pop();
+  }
+  while (!dataPackets.empty() &&
+         holdPacketForBlockedReceiver(dataPackets.front())) {
+    closeBatch(dataPackets.front());
+    dataPackets.pop();
+  }
+
+  if (!registerPackets.empty()) {
+    return &registerPackets;
+  } else if (!transitPackets.empty()) {
+    return &transitPackets;
+  } else if (!retransmittedPackets.empty()) {
+    return &retransmittedPackets;
+  } else if (!dataPackets.empty()) {
+    return &dataPackets;
+  }
+
+  return nullptr;
+}
+
+void TokenRingEngine::bypassNextHost() {
+  std::string deadHostName = nextHostName;
+  bool tokenLost = nextHostHoldsToken || lastTokenPassed > lastHeartbeatAck;
+
+  setNextHost(nextNextHost.first, nextNextHost.second);
+  resetNextHostLiveness(nextNextHostName);
+
+  Logger::getInstance().log("[" + hostId + "] Next host `" + deadHostName +
+                            "` is not responding. Bypassing it to " +
+                            ::to_string(nextHostIp) + ":" +
+                            std::to_string(nextHostPort));
+
+  forgetHost(deadHostName);
+  queueMembershipEntry(MembershipUpdate::createEntry(
+      MembershipUpdate::Action::REMOVE, deadHostName, hostId, nextHostIp,
+      nextHostPort));
+
+  if (tokenLost) {
+    Logger::getInstance().log("[" + hostId + "] Token was lost with `" +
+                              deadHostName + "`. Regenerating token.");
+
+    tokenStatus = true;
+    // It may only have been passed on before next host died
+    tokenEpoch = getNextTokenEpoch();
+  }
+}
+
+bool TokenRingEngine::canPassToken() const {
+  // Hosts from topology start at once, token sent before next host listens
+  // would be lost
+  return tokenStatus && !leaving && !waitingForNextHost &&
+         (releasingToken || now >= senderBlockedUntil);
+}
+
+void TokenRingEngine::passToken() {
+  if (!canPassToken()) {
+    return;
+  }
+
+  // Frames produced so far must not be mistaken for the token frame below
+  flushOutgoingFrames();
+
+  std::queue<TokenRingPacket>* packets = nullptr;
+  TokenRingPacket packet;
+
+  if (releasingToken) {
+    packet = createFreeTokenPacket();
+  } else if ((packets = selectPacketsToSend())) {
+    packet = packets->front();
+
+    Logger::getInstance().log(
+        "[" + hostId + "] Sending " +
+        TokenRingPacket::packetTypeToString(packet.getHeader().type) +
+        " packet.");
+  } else {
+    packet = createGreetingPacket();
+  }
+
+  bool ownSequencedPacket = !releasingToken && isOwnSequencedPacket(packet);
+  if (ownSequencedPacket) {
+    TokenRingPacket::Header header = packet.getHeader();
+    header.windowStart = getWindowStart(maybeNonterminatedCharArrayToString(
+        header.packetReceiverName, TokenRingPacket::NameMaxSize));
+    packet.setHeader(header);
+  }
+
+  // Payload goes first, so it is there before announcement comes around
+  if (ownSequencedPacket &&
+      (packet.getHeader().flags & TokenRingPacket::FLAG_DIRECT)) {
+    sendDirectData(packet);
+  }
+
+  // Token leaves with the packet, it may come back before send returns
+  tokenStatus = false;
+  sendToNextHost(packet);
+
+  try {
+    transport.send(outgoingFrames);
+  } catch (const TransportSendingFailedException& ex) {
+    outgoingFrames.clear();
+
+    Logger::getInstance().log("[" + hostId + "] Sending to next host failed: " +
+                              ex.what() + ". Keeping token.");
+
+    tokenStatus = true;
+    senderBlockedUntil = now + timing.heartbeatInterval;
+    return;
+  }
+  outgoingFrames.clear();
+
+  // Next host got COMMIT over old ring, it is left behind only now
+  if (stagedRing.committed && carriesRingCommit(packet)) {
+    applyStagedRing();
+  }
+
+  if (ownSequencedPacket) {
+    inFlightPackets[packet.getHeader().messageId] = InFlightPacket{packet, now};
+  }
+
+  // Forwarded frames are watched by their senders
+  if (maybeNonterminatedCharArrayToString(packet.getHeader().originalSenderName,
+                                          TokenRingPacket::NameMaxSize) ==
+      hostId) {
+    awaitingToken = true;
+    tokenLeftTime = now;
+    tokenLeftEpoch = tokenEpoch;
+    tokenLossDeadline =
+        now + std::max<Clock::duration>(timing.retransmissionTimeout,
+                                        TokenLossRotations * rotationTime);
+  }
+
+  if (releasingToken) {
+    releasingToken = false;
+  } else if (packets) {
+    if (packets == &dataPackets) {
+      closeBatch(dataPackets.front());
+    }
+    packets->pop();
+  } else {
+    senderBlockedUntil = now + timing.greetingInterval;
+  }
+}
+
+void TokenRingEngine::checkNextHostLiveness() {
+  if (now < nextHeartbeatTime) {
+    return;
+  }
+
+  if (nextNextHostKnown && nextHostName != hostId &&
+      now - lastHeartbeatAck > timing.neighborFailureTimeout) {
+    bypassNextHost();
+  }
+
+  sendHeartbeatToNextHost();
+  if (timing.reorderInterval.count() > 0) {
+    sendProbes();
+  }
+  nextHeartbeatTime = now + timing.heartbeatInterval;
+}
+
+void TokenRingEngine::handleHandedOverPacket(TokenRingPacket& packet) {
+  using trppt = TokenRingPacket::PacketType;
+
+  TokenRingPacket::Header header = packet.getHeader();
+  header.flags &= ~TokenRingPacket::FLAG_HANDED_OVER;
+  header.tokenStatus = 1;
+  packet.setHeader(header);
+
+  Logger::getInstance().log(
+      "[" + hostId + "] Queueing " +
+      TokenRingPacket::packetTypeToString(header.type) +
+      " packet handed over by `" +
+      maybeNonterminatedCharArrayToString(header.packetSenderName,
+                                          TokenRingPacket::NameMaxSize) +
+      "`.");
+
+  if (header.type == trppt::DATA) {
+    dataPackets.push(packet);
+  } else if (header.type == trppt::REGISTER) {
+    // Leaving host will not strip its updates, epochs stop them instead
+    try {
+      MembershipUpdate update(packet.getData());
+      if (!acceptMembershipEpoch(
+              maybeNonterminatedCharArrayToString(
+                  header.originalSenderName, TokenRingPacket::NameMaxSize),
+              update.getEpoch())) {
+        return;
+      }
+      applyMembershipUpdate(update);
+    } catch (const MembershipUpdateException& ex) {
+      Logger::getInstance().log("[" + hostId +
+                                "] Malformed REGISTER packet: " + ex.what());
+      return;
+    }
+
+    registerPackets.push(packet);
+  }
+}
+
+void TokenRingEngine::handleIncomingLeavePacket(TokenRingPacket& packet) {
+  std::string leavingHostName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().originalSenderName, TokenRingPacket::NameMaxSize);
+  std::string leavingNextHostName = maybeNonterminatedCharArrayToString(
+      packet.getHeader().neighborToDisconnectName,
+      TokenRingPacket::NameMaxSize);
+
+  bool leavingHostWasNext = nextHostName == leavingHostName;
+  if (previousHostKnown && previousHostHeartbeatName == leavingHostName) {
+    previousHostKnown = false;
+  }
+
+  if (leavingHostWasNext) {
+    setNextHost(packet.getHeader().registerIp,
+                packet.getHeader().registerPort);
+    resetNextHostLiveness(leavingNextHostName);
+
+    Logger::getInstance().log("[" + hostId + "] Next host `" +
+                              leavingHostName + "` left ring. Connecting to `" +
+                              leavingNextHostName + "`.");
+
+    forgetHost(leavingHostName);
+    queueMembershipEntry(MembershipUpdate::createEntry(
+        MembershipUpdate::Action::REMOVE, leavingHostName, hostId,
+        packet.getHeader().registerIp, packet.getHeader().registerPort));
+  } else {
+    forgetHost(leavingHostName);
+  }
+
+  if (packet.getHeader().tokenStatus) {
+    Logger::getInstance().log("[" + hostId + "] Token handed over by `" +
+                              leavingHostName + "`.");
+
+    tokenStatus = true;
+  }
+}
+
+void TokenRingEngine::handleIncomingPacket(TokenRingPacket& packet) {
+  if (packet.getHeader().flags & TokenRingPacket::FLAG_HANDED_OVER) {
+    handleHandedOverPacket(packet);
+    return;
+  }
+
+  using trppt = TokenRingPacket::PacketType;
+
+  switch (packet.getHeader().type) {
+    case trppt::JOIN:
+      // Handle JOIN PACKET
+      handleIncomingJoinPacket(packet);
+      break;
+    case trppt::REGISTER:
+      // Handle REGISTER PACKET
+      handleIncomingRegisterPacket(packet);
+      break;
+    case trppt::DATA:
+      // Handle DATA PACKET
+      handleIncomingDataPacket(packet);
+      break;
+    case trppt::HEARTBEAT:
+      handleIncomingHeartbeatPacket(packet);
+      break;
+    case trppt::HEARTBEAT_ACK:
+      handleIncomingHeartbeatAckPacket(packet);
+      break;
+    case trppt::LEAVE:
+      handleIncomingLeavePacket(packet);
+      break;
+    case trppt::DIRECT:
+      handleIncomingDirectPacket(packet);
+      break;
+    case trppt::PROBE:
+      handleIncomingProbePacket(packet);
+      break;
+    case trppt::PROBE_ACK:
+      handleIncomingProbeAckPacket(packet);
+      break;
+    case trppt::LATENCY_REPORT:
+      handleIncomingLatencyReportPacket(packet);
+      break;
+    case trppt::NONE:
+      // Free token released by host that stripped its DATA
+      if (packet.getHeader().tokenStatus) {
+        tokenStatus = true;
+      }
+      break;
+    default:
+      Logger::getInstance().log("[" + hostId +
+                                "] Packet with unknown type received.");
+  }
+}
+
+void TokenRingEngine::handleFrameWhileLeaving(TokenRingPacket& packet) {
+  // Previous host may still send frames to us until it gets LEAVE. Pass
+  // them to next host, so token is not lost.
+  if (packet.getHeader().tokenStatus ||
+      (packet.getHeader().flags & TokenRingPacket::FLAG_HANDED_OVER)) {
+    sendPacket(packet, nextHostIp, nextHostPort);
+  }
+}
+
+void TokenRingEngine::sendPacket(const TokenRingPacket& packet, const Ip4& ip,
+                                 unsigned short port) {
+  Transport::Frame frame;
+  frame.address = std::make_pair(ip, port);
+
+  const uint8_t routedBit =
+      packet.getHeader().ring & TokenRingPacket::RingRoutedBit;
+  if ((packet.getHeader().ring & ~routedBit) != ring) {
+    TokenRingPacket ringPacket = packet;
+    TokenRingPacket::Header header = packet.getHeader();
+    header.ring = ring | routedBit;
+    ringPacket.setHeader(header);
+    frame.data = ringPacket.toBinary();
+  } else {
+    frame.data = packet.toBinary();
+  }
+
+  outgoingFrames.push_back(std::move(frame));
+}
+
+bool TokenRingEngine::flushOutgoingFrames() {
+  if (outgoingFrames.empty()) {
+    return true;
+  }
+
+  bool sent = true;
+  try {
+    transport.send(outgoingFrames);
+  } catch (const TransportSendingFailedException& ex) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Packet sending failed: " + ex.what());
+    sent = false;
+  }
+  outgoingFrames.clear();
+
+  return sent;
+}
+
+bool TokenRingEngine::nextHostIsSelf() const {
+  return nextHostIp.s_addr == transport.getLocalIp().s_addr &&
+         nextHostPort == transport.getLocalPort();
+}
+
+void TokenRingEngine::handOverQueuedPackets(
+    std::queue<TokenRingPacket>& packets) {
+  while (!packets.empty()) {
+    TokenRingPacket& packet = packets.front();
+
+    TokenRingPacket::Header header = packet.getHeader();
+    header.tokenStatus = 0;
+    header.flags |= TokenRingPacket::FLAG_HANDED_OVER;
+    packet.setHeader(header);
+
+    sendPacket(packet, nextHostIp, nextHostPort);
+    packets.pop();
+  }
+}
+
+void TokenRingEngine::sendLeavePacket(const std::string& receiverName,
+                                      const Ip4& ip, unsigned short port,
+                                      bool passToken) {
+  TokenRingPacket::Header header{};
+  header.type = TokenRingPacket::PacketType::LEAVE;
+  header.tokenStatus = passToken ? 1 : 0;
+  header.tokenEpoch = tokenEpoch;
+  insertStringToCharArrayWithLength(hostId, header.originalSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(hostId, header.packetSenderName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(receiverName, header.packetReceiverName,
+                                    TokenRingPacket::NameMaxSize);
+  insertStringToCharArrayWithLength(nextHostName,
+                                    header.neighborToDisconnectName,
+                                    TokenRingPacket::NameMaxSize);
+  header.registerIp = nextHostIp;
+  header.registerPort = nextHostPort;
+
+  TokenRingPacket leavePacket;
+  leavePacket.setHeader(header);
+  leavePacket.setData({});
+
+  sendPacket(leavePacket, ip, port);
+}
+
+void TokenRingEngine::start(TimePoint now) {
+  this->now = now;
+
+  transport.setNextHost(nextHostIp, nextHostPort);
+
+  lastHeartbeatAck = now;
+  nextHeartbeatTime = now;
+  nextReorderTime = now + timing.reorderInterval;
+  senderBlockedUntil = now;
+  waitingForNextHost = joinedFromTopology && !nextHostIsSelf();
+
+  if (!joinedFromTopology) {
+    sendJoinRequestToNextHost();
+  }
+
+  flushOutgoingFrames();
+
+  handleTimeout(now);
+}
+
+void TokenRingEngine::handleFrame(const Serializable::container_type& frame,
+                                  TimePoint now, TimePoint receiveTime) {
+  this->now = now;
+  frameReceiveTime =
+      receiveTime != TimePoint() && receiveTime < now ? receiveTime : now;
+
+  TokenRingPacket packet;
+  try {
+    size_t extractedBytes = packet.fromBinary(frame);
+    (void)extractedBytes;
+  } catch (const TokenRingPacketException& ex) {
+    Logger::getInstance().log(
+        "[" + hostId + "] TokenRingPacket creation failed: " + ex.what());
+    return;
+  }
+
+  if (leaving) {
+    handleFrameWhileLeaving(packet);
+  } else {
+    // HEARTBEAT_ACK only tells whether next host holds token, JOIN of new
+    // host knows no token
+    if (packet.getHeader().tokenStatus &&
+        packet.getHeader().type !=
+            TokenRingPacket::PacketType::HEARTBEAT_ACK &&
+        packet.getHeader().type != TokenRingPacket::PacketType::JOIN) {
+      measureTokenRotation(packet);
+      if (!acceptTokenEpoch(packet)) {
+        return;
+      }
+      awaitingToken = false;
+    }
+
+    handleIncomingPacket(packet);
+    passToken();
+  }
+
+  flushOutgoingFrames();
+}
+
+void TokenRingEngine::handleTimeout(TimePoint now) {
+  this->now = now;
+
+  if (leaving) {
+    return;
+  }
+
+  checkNextHostLiveness();
+  flushOutgoingFrames();
+
+  if (timing.reorderInterval.count() > 0 && now >= nextReorderTime) {
+    reorderRing();
+  }
+
+  dropStaleDirectTransfers();
+  checkTokenLoss();
+  checkInFlightPackets();
+
+  passToken();
+  flushOutgoingFrames();
+}
+
+TokenRingEngine::TimePoint TokenRingEngine::getNextTimeout() const {
+  if (leaving) {
+    return leaveDeadline;
+  }
+
+  TimePoint timeout = nextHeartbeatTime;
+  if (tokenStatus && !waitingForNextHost) {
+    timeout = std::min(timeout, senderBlockedUntil);
+  }
+
+  if (awaitingToken) {
+    timeout = std::min(timeout, tokenLossDeadline);
+  }
+
+  if (timing.reorderInterval.count() > 0) {
+    timeout = std::min(timeout, nextReorderTime);
+  }
+
+  for (const auto& inFlight : inFlightPackets) {
+    timeout = std::min(timeout, inFlight.second.sentTime +
+                                    timing.retransmissionTimeout);
+  }
+
+  return timeout;
+}
+
+void TokenRingEngine::leave(TimePoint now) {
+  this->now = now;
+
+  leaving = true;
+  leaveDeadline = now;
+
+  if (nextHostIsSelf()) {
+    return;
+  }
+
+  Logger::getInstance().log("[" + hostId + "] Leaving ring.");
+
+  bool holdsToken = tokenStatus;
+  tokenStatus = false;
+
+  // Queued frames go first so next host has them before token arrives
+  while (!pendingMembershipEntries.empty()) {
+    registerPackets.push(createMembershipUpdatePacket());
+  }
+  handOverQueuedPackets(registerPackets);
+  handOverQueuedPackets(transitPackets);
+  for (auto& receiverPackets : heldPackets) {
+    while (!receiverPackets.second.empty()) {
+      retransmittedPackets.push(receiverPackets.second.front());
+      receiverPackets.second.pop();
+    }
+  }
+  heldPackets.clear();
+  handOverQueuedPackets(retransmittedPackets);
+  openBatches.clear();
+  handOverQueuedPackets(dataPackets);
+
+  sendLeavePacket(nextHostName, nextHostIp, nextHostPort, holdsToken);
+
+  if (previousHostKnown &&
+      (previousHostAddress.first.s_addr != nextHostIp.s_addr ||
+       previousHostAddress.second != nextHostPort)) {
+    sendLeavePacket(previousHostHeartbeatName, previousHostAddress.first,
+                    previousHostAddress.second, false);
+  }
+
+  try {
+    transport.send(outgoingFrames);
+  } catch (const TransportSendingFailedException& ex) {
+    Logger::getInstance().log("[" + hostId +
+                              "] Leaving ring failed: " + ex.what());
+  }
+  outgoingFrames.clear();
+
+  leaveDeadline = now + timing.leaveLingerTime;
+}
+
+bool TokenRingEngine::hasLeft(TimePoint now) const {
+  return leaving && now >= leaveDeadline;
+}
+
+const std::string& TokenRingEngine::getHostId() const { return hostId; }
+
+void TokenRingEngine::joinGroup(const std::string& groupName) noexcept(false) {
+  std::string name = groupName;
+  if (name.empty() || name[0] != TokenRingPacket::GroupReceiverPrefix) {
+    name.insert(name.begin(), TokenRingPacket::GroupReceiverPrefix);
+  }
+
+  if (name.size() >= TokenRingPacket::NameMaxSize) {
+    throw TokenRingEngineInvalidGroupNameException("Group name `" + name +
+                                                   "' is too long");
+  }
+
+  groups.insert(name);
+}
+
+void TokenRingEngine::leaveGroup(const std::string& groupName) {
+  std::string name = groupName;
+  if (name.empty() || name[0] != TokenRingPacket::GroupReceiverPrefix) {
+    name.insert(name.begin(), TokenRingPacket::GroupReceiverPrefix);
+  }
+
+  groups.erase(name);
+}
+
+bool TokenRingEngine::holdsToken() const { return tokenStatus; }
+
+bool TokenRingEngine::knowsHost(const std::string& name) const {
+  return name == hostId || hosts.count(name) != 0;
+}
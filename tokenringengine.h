@@ -0,0 +1,739 @@
+#ifndef TOKENRINGENGINE_H
+#define TOKENRINGENGINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ip4.h"
+#include "membershipupdate.h"
+#include "programarguments.h"
+#include "ringordering.h"
+#include "socket.h"
+#include "tokenringpacket.h"
+#include "topology.h"
+#include "transport.h"
+
+using TokenRingEngineException = std::runtime_error;
+
+using TokenRingEngineInvalidGroupNameException = TokenRingEngineException;
+
+/**
+ * Token ring protocol logic. Engine does not block and does not read clock,
+ * received frames and current time are passed to it and frames it produces
+ * are sent through transport. It is driven by one thread, with real clock
+ * (TokenRingService) or virtual one.
+ */
+class TokenRingEngine {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using TimePoint = Clock::time_point;
+
+  enum class DeliveryStatus {
+    DELIVERED,           /// Receiver got message (some member, for multicast)
+    NOT_COPIED,          /// Receiver exists but could not take message
+    RECEIVER_NOT_FOUND,  /// Message went around ring, nobody recognized it
+    RECEIVER_BUSY,       /// Receiver stayed busy for all retransmissions
+    LOST,                /// Frame did not come back, also when sent again
+  };
+
+  /**
+   * Result of sent message, known when its frame comes back to sender
+   */
+  struct DeliveryReport {
+    TokenRingPacket::MessageId_t messageId;
+    std::string receiverName;
+    DeliveryStatus status;
+  };
+
+  using DeliveryReportHandler = std::function<void(const DeliveryReport&)>;
+
+  /**
+   * Message delivered to this host. Data is not copied out of received
+   * frame, it is valid only during handler call.
+   */
+  struct ReceivedMessage {
+    std::string senderName;
+    std::string receiverName;
+    TokenRingPacket::MessageId_t messageId;
+    // Ring of dual ring message came on, ids are given per ring. Messages
+    // routed over ring of rings have ids of HierarchicalEngine::RoutedRing.
+    uint8_t ring;
+    // Data starts with HierarchicalEngine::Envelope
+    bool routed;
+    const unsigned char* data;
+    size_t size;
+  };
+
+  enum class MessageHandling {
+    TAKEN,
+    BUSY,     /// Could not be taken now, sender sends it again
+    REFUSED,  /// Will never be taken, sender is told it was not copied
+  };
+
+  using MessageHandler =
+      std::function<MessageHandling(const ReceivedMessage&)>;
+
+  /**
+   * Gets ring order that was taken, starting at this host
+   */
+  using RingOrderHandler =
+      std::function<void(const std::vector<std::string>&)>;
+
+  struct Timing {
+    std::chrono::milliseconds heartbeatInterval{500};
+    std::chrono::milliseconds neighborFailureTimeout{1500};
+    std::chrono::milliseconds leaveLingerTime{300};
+    // Pause after sending greeting, when host had nothing else to send
+    std::chrono::milliseconds greetingInterval{5000};
+    // Retransmission delay after busy receiver, doubled while it stays busy
+    std::chrono::milliseconds receiverBusyBackoff{10};
+    std::chrono::milliseconds maxReceiverBusyBackoff{1000};
+    unsigned int maxRetransmissions{8};
+    // Own DATA not back by then is sent again. Token not seen by then after
+    // own frame took it is regenerated, or after twice the measured rotation
+    // when that is longer. Has to be longer than rotation, greetingInterval
+    // included.
+    std::chrono::milliseconds retransmissionTimeout{6000};
+    // Messages to one receiver sent past the oldest unacknowledged one
+    unsigned int sendWindow{256};
+    // Ring coordinator reorders ring by measured latencies this often, 0
+    // turns it off. Hosts probe that many others with every heartbeat.
+    std::chrono::milliseconds reorderInterval{0};
+    unsigned int probesPerHeartbeat{8};
+  };
+
+  // Larger messages are sent straight to receiver, only announced on ring
+  static const size_t DefaultDirectTransferThreshold = 256;
+
+  // Private variables
+ private:
+  Transport& transport;
+
+  Timing timing;
+
+  // Picks greeting receivers
+  std::mt19937 randomGenerator{std::random_device{}()};
+
+  std::string hostId;
+
+  Ip4 nextHostIp;
+  unsigned short nextHostPort;
+
+  std::string previousHostName;
+
+  bool tokenStatus{false};
+
+  // Own frame came back and was stripped, token goes on free
+  bool releasingToken{false};
+
+  bool joinedFromTopology{false};
+
+  // Greetings are sent compressed
+  bool compressGreetings{false};
+
+  size_t directTransferThreshold{DefaultDirectTransferThreshold};
+
+  bool routedMessages{false};
+
+  // Put into every sent frame, see DualRingEngine
+  uint8_t ring{0};
+
+  // Greetings go only to receivers of this lane
+  size_t lane{0};
+  size_t lanesCount{1};
+
+  // Groups whose DATA is delivered here, names include GroupReceiverPrefix
+  std::set<std::string> groups;
+
+  TokenRingPacket::MessageId_t nextMessageId{1};
+  DeliveryReportHandler deliveryReportHandler;
+
+  // Without handler delivered messages are only logged
+  MessageHandler messageHandler;
+  // Reused for decompressed DATA
+  std::vector<unsigned char> uncompressedData;
+
+  std::set<std::string> hosts;
+  std::map<std::string, Socket::IpAndPortPair> hostAddresses;
+  std::map<std::string, MembershipUpdate::Epoch_t> lastMembershipEpochs;
+
+  // Hosts removed from ring, their DATA has nobody to strip it
+  std::set<std::string> departedHosts;
+
+  // Next host liveness
+  std::string nextHostName;
+  bool nextNextHostKnown{false};
+  std::string nextNextHostName;
+  Socket::IpAndPortPair nextNextHost;
+  bool nextHostHoldsToken{false};
+  TimePoint lastHeartbeatAck;
+  TimePoint lastTokenPassed;
+  TimePoint nextHeartbeatTime;
+  bool previousHostKnown{false};
+  std::string previousHostHeartbeatName;
+  Socket::IpAndPortPair previousHostAddress;
+
+  std::queue<TokenRingPacket> registerPackets;
+
+  // Round trip times to other hosts, measured while ring is reordered
+  std::map<std::string, std::chrono::microseconds> roundTripTimes;
+  struct Probe {
+    TokenRingPacket::MessageId_t probeId;
+    TimePoint sentTime;
+  };
+  std::map<std::string, Probe> pendingProbes;
+  TokenRingPacket::MessageId_t nextProbeId{1};
+  std::string lastProbedHostName;
+
+  // Reports of all hosts, used while this host is coordinator
+  RingOrdering ringOrdering;
+  TimePoint nextReorderTime;
+
+  // Neighbors in new ring order given by MOVE entries, taken when update
+  // with COMMIT is passed on
+  struct StagedRing {
+    bool nextHostKnown{false};
+    std::string nextHostName;
+    Socket::IpAndPortPair nextHost;
+    bool previousHostKnown{false};
+    std::string previousHostName;
+    // Every link of new order
+    std::map<std::string, std::string> nextHostNames;
+    bool committed{false};
+  };
+  StagedRing stagedRing;
+  RingOrderHandler ringOrderHandler;
+
+  // Own membership changes waiting for token, sent as one REGISTER batch
+  std::vector<MembershipUpdate::Entry> pendingMembershipEntries;
+  unsigned int membershipUpdatesInFlight{0};
+  MembershipUpdate::Epoch_t membershipEpoch{0};
+
+  std::queue<TokenRingPacket> dataPackets;
+
+  // Last queued uncompressed DATA of receiver, next messages are added to it
+  std::map<std::string, TokenRingPacket*> openBatches;
+
+  // Reused for records of delivered and returned DATA
+  std::vector<TokenRingPacket::Record> records;
+
+  // DATA of other hosts on its way back to sender, goes before own DATA
+  std::queue<TokenRingPacket> transitPackets;
+
+  // Busy receivers, own DATA for them waits in heldPackets until retryTime
+  struct ReceiverBackoff {
+    std::chrono::milliseconds delay{0};
+    TimePoint retryTime;
+  };
+  std::map<std::string, ReceiverBackoff> receiverBackoffs;
+  std::map<std::string, std::queue<TokenRingPacket>> heldPackets;
+  std::map<TokenRingPacket::MessageId_t, unsigned int> retransmissionsCounts;
+  // Held DATA whose receiver may be busy no more, goes before new DATA
+  std::queue<TokenRingPacket> retransmittedPackets;
+
+  // Keeps sequence numbers in order across wraparound
+  struct SequenceBefore {
+    bool operator()(TokenRingPacket::SequenceNumber_t lhs,
+                    TokenRingPacket::SequenceNumber_t rhs) const {
+      return static_cast<int32_t>(lhs - rhs) < 0;
+    }
+  };
+
+  // Own messages to receiver, queued or sent and not acknowledged yet
+  struct SendStream {
+    TokenRingPacket::SequenceNumber_t nextSequence{0};
+    std::set<TokenRingPacket::SequenceNumber_t, SequenceBefore> unacknowledged;
+  };
+  std::map<std::string, SendStream> sendStreams;
+
+  // Sent sequenced DATA by messageId, sent again if it does not come back
+  struct InFlightPacket {
+    TokenRingPacket packet;
+    TimePoint sentTime;
+  };
+  std::map<TokenRingPacket::MessageId_t, InFlightPacket> inFlightPackets;
+
+  // Messages from original sender, delivered in order
+  struct BufferedMessage {
+    TokenRingPacket::MessageId_t messageId;
+    std::vector<unsigned char> data;
+  };
+  struct ReceiveStream {
+    TokenRingPacket::SequenceNumber_t expectedSequence;
+    // Copied messages that came before missing ones
+    std::map<TokenRingPacket::SequenceNumber_t, BufferedMessage,
+             SequenceBefore>
+        reorderBuffer;
+  };
+  std::map<std::string, ReceiveStream> receiveStreams;
+
+  // Payloads of own DATA with FLAG_DIRECT by messageId, kept until reported
+  std::map<TokenRingPacket::MessageId_t, std::vector<unsigned char>>
+      directPayloads;
+
+  // Parts of messages sent here in DIRECT frames, by sender and messageId
+  struct DirectTransfer {
+    std::vector<unsigned char> data;
+    std::set<TokenRingPacket::SequenceNumber_t> offsets;
+    size_t receivedSize{0};
+    TimePoint lastUpdate;
+  };
+  std::map<std::pair<std::string, TokenRingPacket::MessageId_t>,
+           DirectTransfer>
+      directTransfers;
+
+  // Own frame (or free token) left with token, which has to come back
+  bool awaitingToken{false};
+  TimePoint tokenLeftTime;
+  TokenRingPacket::TokenEpoch_t tokenLeftEpoch{0};
+  TimePoint tokenLossDeadline;
+
+  // The newest token seen, see TokenRingPacket::Header::tokenEpoch
+  TokenRingPacket::TokenEpoch_t tokenEpoch{0};
+
+  // When frame being handled came, now if transport does not know
+  TimePoint frameReceiveTime;
+
+  // Time own frame takes around ring, longer rotations are taken at once
+  Clock::duration rotationTime{0};
+  // Token replaced by regenerated one, its late frame still measures rotation
+  TimePoint replacedTokenLeftTime;
+  TokenRingPacket::TokenEpoch_t replacedTokenEpoch{0};
+
+  // Token is not passed before this time (after greeting, after failure)
+  TimePoint senderBlockedUntil;
+
+  // Token from topology is not passed before next host answers heartbeat
+  bool waitingForNextHost{false};
+
+  bool leaving{false};
+  TimePoint leaveDeadline;
+
+  // Time of currently handled event
+  TimePoint now;
+
+  // Frames produced while handling event, sent as one batch
+  std::vector<Transport::Frame> outgoingFrames;
+
+  // Private methods
+ private:
+  void loadTopology(const Topology& topology);
+
+  void setNextHost(const Ip4& ip, unsigned short port);
+
+  void sendJoinRequestToNextHost();
+
+  void handleIncomingJoinPacket(TokenRingPacket incomingPacket);
+
+  void handleIncomingRegisterPacket(TokenRingPacket& packet);
+
+  void handleIncomingDataPacket(TokenRingPacket& packet);
+
+  /**
+   * Sets frame status flags (and copiedCount) of returned header
+   */
+  void deliverDataPacket(const TokenRingPacket& packet,
+                         TokenRingPacket::Header& returnedHeader);
+
+  /**
+   * Returns number of leading records taken, handling tells why the next one
+   * was not. Records come after reordering and duplicates are dropped,
+   * messages go to handler in order.
+   */
+  size_t deliverSequencedRecords(ReceivedMessage& message,
+                                 const TokenRingPacket::Header& header,
+                                 MessageHandling& handling);
+
+  /**
+   * Delivers buffered messages that are next in order
+   */
+  void deliverBufferedMessages(ReceiveStream& stream,
+                               ReceivedMessage& message);
+
+  /**
+   * Passes message to handler, or logs it and takes it
+   */
+  MessageHandling handOverMessage(const ReceivedMessage& message);
+
+  /**
+   * Own DATA came back, possibly sent to ourselves
+   */
+  void handleReturnedDataPacket(const TokenRingPacket& packet);
+
+  /**
+   * Fills records with messages of own DATA, compressed DATA is one record
+   */
+  void readOwnRecords(const TokenRingPacket& packet);
+
+  /**
+   * Reports records [first, last) of packet (read into records) with
+   * status, their sequence numbers are not waited for any more
+   */
+  void reportDelivery(const TokenRingPacket& packet, size_t first,
+                      size_t last, DeliveryStatus status);
+
+  /**
+   * True if own message to receiver before record firstRecord of sequenced
+   * packet is not acknowledged yet
+   */
+  bool isBehindUnacknowledged(const TokenRingPacket& packet,
+                              size_t firstRecord) const;
+
+  /**
+   * Queues records of packet from firstRecord on, after backoff if receiver
+   * is busy. Returns false if packet is not to be sent again.
+   */
+  bool scheduleRetransmission(const TokenRingPacket& packet,
+                              size_t firstRecord, bool receiverBusy);
+
+  TokenRingPacket createRetransmissionPacket(const TokenRingPacket& packet,
+                                             size_t firstRecord);
+
+  /**
+   * Own DATA not back in time is sent again
+   */
+  void checkInFlightPackets();
+
+  /**
+   * Regenerates token lost after it left with own frame
+   */
+  void checkTokenLoss();
+
+  /**
+   * Epoch of regenerated token. It is above every epoch seen, hosts that
+   * regenerate at once are told apart by their rank in the ring.
+   */
+  TokenRingPacket::TokenEpoch_t getNextTokenEpoch() const;
+
+  /**
+   * False for frame of token that was replaced by regenerated one
+   */
+  bool acceptTokenEpoch(const TokenRingPacket& packet);
+
+  /**
+   * Called when token comes back, before awaitingToken is cleared. Token
+   * regenerated by another host meanwhile did not make one rotation.
+   */
+  void measureTokenRotation(const TokenRingPacket& packet);
+
+  bool isOwnSequencedPacket(const TokenRingPacket& packet) const;
+
+  TokenRingPacket::SequenceNumber_t getWindowStart(
+      const std::string& receiverName) const;
+
+  /**
+   * True if DATA cannot be sent now, its receiver is busy or send window is
+   * full
+   */
+  bool isReceiverBlocked(const TokenRingPacket& packet) const;
+
+  /**
+   * Returns true if packet was held, its receiver is blocked
+   */
+  bool holdPacketForBlockedReceiver(const TokenRingPacket& packet);
+
+  void releaseHeldPackets();
+
+  TokenRingPacket createDataPacket(const std::string& receiverName,
+                                   bool routed = false);
+
+  /**
+   * Gives back sequence number of packet from createDataPacket() that was
+   * not queued
+   */
+  void cancelDataPacket(const TokenRingPacket& packet);
+
+  TokenRingPacket::MessageId_t queueDirectMessage(
+      const std::string& receiverName,
+      const std::vector<unsigned char>& data) noexcept(false);
+
+  /**
+   * Sends payload of own DATA with FLAG_DIRECT to its receiver
+   */
+  void sendDirectData(const TokenRingPacket& packet);
+
+  void handleIncomingDirectPacket(const TokenRingPacket& packet);
+
+  /**
+   * Points the only record (announced size) at received payload. Returns
+   * false if some of it is missing.
+   */
+  bool attachDirectData(const TokenRingPacket& packet,
+                        const std::string& senderName);
+
+  /**
+   * Forgets messages whose DIRECT frames stopped coming, sender sends all
+   * of them again
+   */
+  void dropStaleDirectTransfers();
+
+  /**
+   * Has to be called before front of dataPackets is removed
+   */
+  void closeBatch(const TokenRingPacket& packet);
+
+  bool acceptsMulticast(const std::string& receiverName) const;
+
+  void handleIncomingHeartbeatPacket(TokenRingPacket& packet);
+
+  void handleIncomingHeartbeatAckPacket(TokenRingPacket& packet);
+
+  void handleIncomingLeavePacket(TokenRingPacket& packet);
+
+  void handleHandedOverPacket(TokenRingPacket& packet);
+
+  void handleIncomingPacket(TokenRingPacket& packet);
+
+  void handleFrameWhileLeaving(TokenRingPacket& packet);
+
+  void sendPacket(const TokenRingPacket& packet, const Ip4& ip,
+                  unsigned short port);
+
+  /**
+   * Sends frames produced so far. Returns false if sending failed.
+   */
+  bool flushOutgoingFrames();
+
+  void rememberHost(const std::string& name, const Ip4& ip,
+                    unsigned short port);
+
+  void forgetHost(const std::string& name);
+
+  void resetNextHostLiveness(const std::string& name);
+
+  void sendToNextHost(const TokenRingPacket& packet);
+
+  void sendHeartbeatToNextHost();
+
+  void queueMembershipEntry(const MembershipUpdate::Entry& entry);
+
+  bool acceptMembershipEpoch(const std::string& originalSenderName,
+                             MembershipUpdate::Epoch_t epoch);
+
+  /**
+   * Returns true if update changed our next host
+   */
+  bool applyMembershipUpdate(const MembershipUpdate& update);
+
+  TokenRingPacket createMembershipUpdatePacket();
+
+  /**
+   * Probes next hosts in turn, reports round trip times to coordinator
+   * after every host was probed
+   */
+  void sendProbes();
+
+  void handleIncomingProbePacket(TokenRingPacket& packet);
+
+  void handleIncomingProbeAckPacket(TokenRingPacket& packet);
+
+  void sendLatencyReport();
+
+  void handleIncomingLatencyReportPacket(TokenRingPacket& packet);
+
+  /**
+   * Host with the lowest name reorders ring
+   */
+  const std::string& getCoordinatorName() const;
+
+  /**
+   * Coordinator queues MOVE entries of faster ring order, if there is one
+   */
+  void reorderRing();
+
+  /**
+   * Queues MOVE entries of every link of order and COMMIT
+   */
+  void queueRingOrder(const std::vector<std::string>& order);
+
+  bool carriesRingCommit(const TokenRingPacket& packet) const;
+
+  /**
+   * Connects to next host of staged ring order
+   */
+  void applyStagedRing();
+
+  TokenRingPacket createGreetingPacket();
+
+  TokenRingPacket createFreeTokenPacket();
+
+  /**
+   * Picks queue whose front packet is sent with token: queued REGISTER (own
+   * membership changes are queued first), then DATA in transit, then
+   * retransmitted and own DATA. Returns nullptr when greeting is to be sent.
+   */
+  std::queue<TokenRingPacket>* selectPacketsToSend();
+
+  void bypassNextHost();
+
+  bool canPassToken() const;
+
+  void passToken();
+
+  void checkNextHostLiveness();
+
+  bool nextHostIsSelf() const;
+
+  void handOverQueuedPackets(std::queue<TokenRingPacket>& packets);
+
+  void sendLeavePacket(const std::string& receiverName, const Ip4& ip,
+                       unsigned short port, bool passToken);
+
+ public:
+  TokenRingEngine(const ProgramArguments& programArguments,
+                  Transport& transport);
+
+  /**
+   * Host joins ring described by topology, no JOIN is sent
+   */
+  TokenRingEngine(const std::string& hostId, const Topology& topology,
+                  Transport& transport) noexcept(false);
+
+  void setTiming(const Timing& timing);
+
+  void setGreetingCompression(bool enabled);
+
+  /**
+   * Messages larger than threshold bytes go straight to receiver. Threshold
+   * is at most TokenRingPacket::DataMaxSize.
+   */
+  void setDirectTransferThreshold(size_t threshold);
+
+  /**
+   * Messages of sendMessage() are marked as routed, see
+   * TokenRingPacket::RingRoutedBit. Greetings are not.
+   */
+  void setRoutedMessages(bool enabled);
+
+  /**
+   * Frames sent from now on carry ring number in header
+   */
+  void setRing(uint8_t ring);
+
+  /**
+   * Engine is one of lanesCount parallel rings. Its greetings go to
+   * receivers of its lane only, see getLaneOf().
+   */
+  void setLane(size_t lane, size_t lanesCount);
+
+  /**
+   * Lane carrying traffic to receiver. Traffic is split over lanes by hash of
+   * receiver name, so each flow stays on one lane and keeps its order.
+   */
+  static size_t getLaneOf(const std::string& receiverName, size_t lanesCount);
+
+  /**
+   * Queues message for receiver, sent with one of following tokens. With
+   * compress payload is compressed when it gets smaller, then it may be up
+   * to TokenRingPacket::UncompressedDataMaxSize bytes.
+   *
+   * Uncompressed messages for the same receiver share frame while it waits
+   * for token, as long as they fit into TokenRingPacket::DataMaxSize.
+   *
+   * Unicast messages larger than direct transfer threshold, up to
+   * TokenRingPacket::DirectDataMaxSize bytes, are sent straight to receiver
+   * when token comes, only small announcement goes around ring. With
+   * compress threshold applies to compressed size, direct payload is sent
+   * uncompressed.
+   *
+   * Messages to one host are delivered once and in order. Frames that come
+   * back not copied or do not come back are sent again, up to
+   * Timing::maxRetransmissions times.
+   *
+   * TokenRingPacket::BroadcastReceiverName or group name (`@name`) sends one
+   * frame that is delivered to all matching hosts in one rotation.
+   */
+  TokenRingPacket::MessageId_t sendMessage(
+      const std::string& receiverName, const std::vector<unsigned char>& data,
+      bool compress = false) noexcept(false);
+
+  /**
+   * Handler is called with status of every sent message (greetings too),
+   * from within handleFrame()
+   */
+  void setDeliveryReportHandler(const DeliveryReportHandler& handler);
+
+  /**
+   * Handler is called with every message delivered here, from within
+   * handleFrame()
+   */
+  void setMessageHandler(const MessageHandler& handler);
+
+  /**
+   * Makes greeting receivers reproducible
+   */
+  void setRandomSeed(uint32_t seed);
+
+  /**
+   * Joins ring. Transport has to be opened already.
+   */
+  void start(TimePoint now);
+
+  /**
+   * receiveTime is when frame came, if transport knows it. It keeps time
+   * frame waited to be read out of measured round trip times.
+   */
+  void handleFrame(const Serializable::container_type& frame, TimePoint now,
+                   TimePoint receiveTime = TimePoint());
+
+  /**
+   * Runs timers due at now (heartbeats, neighbor failure, delayed token)
+   */
+  void handleTimeout(TimePoint now);
+
+  /**
+   * Time when handleTimeout() has to be called at the latest
+   */
+  TimePoint getNextTimeout() const;
+
+  /**
+   * Hands queued frames and token over to next host. Frames received until
+   * hasLeft() are passed on, so token is not lost.
+   */
+  void leave(TimePoint now);
+
+  bool hasLeft(TimePoint now) const;
+
+  const std::string& getHostId() const;
+
+  bool holdsToken() const;
+
+  /**
+   * True for this host and ring members it knows of
+   */
+  bool knowsHost(const std::string& name) const;
+
+  /**
+   * True for host that reorders ring, the one with the lowest name
+   */
+  bool isRingCoordinator() const;
+
+  /**
+   * Rewires ring into order of all its hosts, see Timing::reorderInterval.
+   * Returns false if this host is not coordinator, other membership changes
+   * go around or order does not list ring hosts.
+   */
+  bool requestRingOrder(const std::vector<std::string>& order);
+
+  /**
+   * Handler is called on every host when ring order changes
+   */
+  void setRingOrderHandler(const RingOrderHandler& handler);
+
+  /**
+   * DATA sent to `@name` is delivered here from now on
+   */
+  void joinGroup(const std::string& groupName) noexcept(false);
+
+  void leaveGroup(const std::string& groupName);
+};
+
+#endif  // TOKENRINGENGINE_H
@@ -5,7 +5,51 @@
 #include <cstring>
 #include <sstream>
 
-TokenRingPacket::TokenRingPacket() {}
+#include "crc32c.h"
+#include "lzcodec.h"
+#include "utility.h"
+
+constexpr const char *TokenRingPacket::BroadcastReceiverName;
+
+namespace {
+void writeRecordHeader(char *destination, TokenRingPacket::MessageId_t id,
+                       size_t size) {
+  uint32_t messageId = htonl(id);
+  uint16_t recordSize = htons(static_cast<uint16_t>(size));
+
+  std::memcpy(destination, &messageId, sizeof(messageId));
+  std::memcpy(destination + sizeof(messageId), &recordSize,
+              sizeof(recordSize));
+}
+
+// Multi-byte header fields go on the wire in network order, checksum covers
+// them in that order too
+TokenRingPacket::Header headerToNetworkOrder(TokenRingPacket::Header header) {
+  header.registerPort = htons(header.registerPort);
+  header.dataSize = htons(header.dataSize);
+  header.messageId = htonl(header.messageId);
+  header.sequenceNumber = htonl(header.sequenceNumber);
+  header.windowStart = htonl(header.windowStart);
+  header.copiedCount = htons(header.copiedCount);
+  header.tokenEpoch = htonl(header.tokenEpoch);
+  header.checksum = htonl(header.checksum);
+  return header;
+}
+
+TokenRingPacket::Header headerToHostOrder(TokenRingPacket::Header header) {
+  header.registerPort = ntohs(header.registerPort);
+  header.dataSize = ntohs(header.dataSize);
+  header.messageId = ntohl(header.messageId);
+  header.sequenceNumber = ntohl(header.sequenceNumber);
+  header.windowStart = ntohl(header.windowStart);
+  header.copiedCount = ntohs(header.copiedCount);
+  header.tokenEpoch = ntohl(header.tokenEpoch);
+  header.checksum = ntohl(header.checksum);
+  return header;
+}
+}  // namespace
+
+TokenRingPacket::TokenRingPacket() : header{}, data{} {}
 
 Serializable::size_type TokenRingPacket::constructHeaderFromBinaryData(
     const std::vector<unsigned char> &sourceBuffer) {
@@ -15,6 +59,12 @@ Serializable::size_type TokenRingPacket::constructHeaderFromBinaryData(
   }
 
   std::memcpy(&header, sourceBuffer.data(), sizeof(header));
+  header = headerToHostOrder(header);
+
+  if (header.dataSize > DataMaxSize) {
+    throw TokenRingPacketTooMuchDataException(
+        "Declared data size exceeds DataMaxSize");
+  }
 
   return sizeof(header);
 }
@@ -26,9 +76,10 @@ Serializable::size_type TokenRingPacket::extractDataFromBinaryAndHeader(
         "Passed input buffer contains less data than declared in header");
   }
 
-  std::memcpy(data.data(), sourceBuffer.data() + sizeof(header), DataMaxSize);
+  std::memcpy(data.data(), sourceBuffer.data() + sizeof(header),
+              header.dataSize);
 
-  return DataMaxSize;
+  return header.dataSize;
 }
 
 TokenRingPacket::TokenRingPacket(
@@ -41,15 +92,57 @@ const TokenRingPacket::Header &TokenRingPacket::getHeader() const {
 }
 
 void TokenRingPacket::setHeader(const Header &value) {
-  uint16_t dataSize = header.dataSize;
+  Header previous = header;
   header = value;
-  header.dataSize = dataSize;
+  header.dataSize = previous.dataSize;
+  header.checksum = previous.checksum;
+
+  if (!checksumValid) {
+    return;
+  }
+
+  // Forwarding hosts rewrite few header bytes, e.g. packetSenderName
+  Header previousSent = headerToNetworkOrder(previous);
+  Header sent = headerToNetworkOrder(header);
+  const unsigned char *oldBytes =
+      reinterpret_cast<const unsigned char *>(&previousSent);
+  const unsigned char *newBytes =
+      reinterpret_cast<const unsigned char *>(&sent);
+
+  size_t first = 0;
+  size_t last = sizeof(Header);
+  while (first < last && oldBytes[first] == newBytes[first]) {
+    ++first;
+  }
+  while (last > first && oldBytes[last - 1] == newBytes[last - 1]) {
+    --last;
+  }
+
+  if (first == last) {
+    return;
+  }
+
+  header.checksum = Crc32c::replace(
+      previous.checksum, oldBytes + first, newBytes + first, last - first,
+      sizeof(Header) - last + header.dataSize);
+}
+
+uint32_t TokenRingPacket::computeChecksum() const {
+  Header checksummedHeader = headerToNetworkOrder(header);
+  checksummedHeader.checksum = 0;
+
+  uint32_t crc = Crc32c::extend(0, &checksummedHeader, sizeof(Header));
+  return Crc32c::extend(crc, data.data(), header.dataSize);
 }
 
 const std::vector<unsigned char> TokenRingPacket::getData() const {
   return {data.begin(), data.begin() + header.dataSize};
 }
 
+const unsigned char *TokenRingPacket::getRawData() const {
+  return reinterpret_cast<const unsigned char *>(data.data());
+}
+
 const std::vector<char> TokenRingPacket::getDataAsCharsVector() const {
   return {data.begin(), data.begin() + header.dataSize};
 }
@@ -62,26 +155,202 @@ void TokenRingPacket::setData(const std::vector<unsigned char> &value) {
   }
   std::memcpy(data.data(), value.data(), value.size());
   header.dataSize = static_cast<uint16_t>(value.size());
+  header.flags &= ~(FLAG_COMPRESSED | FLAG_RECORDS);
+  checksumValid = false;
+}
+
+bool TokenRingPacket::setDataCompressed(
+    const std::vector<unsigned char> &value) noexcept(false) {
+  if (value.size() > UncompressedDataMaxSize) {
+    throw TokenRingPacketTooMuchDataException(
+        "Passed data is too big to be compressed");
+  }
+
+  const size_t sizeFieldSize = sizeof(uint16_t);
+  std::vector<unsigned char> block;
+
+  if (!LZCodec::compress(value, block, DataMaxSize - sizeFieldSize) ||
+      block.size() + sizeFieldSize >= value.size()) {
+    setData(value);
+    return false;
+  }
+
+  uint16_t uncompressedSize = htons(static_cast<uint16_t>(value.size()));
+  std::memcpy(data.data(), &uncompressedSize, sizeFieldSize);
+  std::memcpy(data.data() + sizeFieldSize, block.data(), block.size());
+  header.dataSize = static_cast<uint16_t>(sizeFieldSize + block.size());
+  header.flags |= FLAG_COMPRESSED;
+  header.flags &= ~FLAG_RECORDS;
+  checksumValid = false;
+
+  return true;
+}
+
+bool TokenRingPacket::isCompressed() const {
+  return (header.flags & FLAG_COMPRESSED) != 0;
+}
+
+bool TokenRingPacket::hasRecords() const {
+  return (header.flags & FLAG_RECORDS) != 0;
+}
+
+bool TokenRingPacket::appendRecord(MessageId_t messageId,
+                                   const std::vector<unsigned char> &value) {
+  if (isCompressed()) {
+    return false;
+  }
+
+  size_t size = header.dataSize;
+  size_t firstRecordHeaderSize = hasRecords() ? 0 : RecordHeaderSize;
+
+  if (size + firstRecordHeaderSize + RecordHeaderSize + value.size() >
+      DataMaxSize) {
+    return false;
+  }
+
+  if (!hasRecords()) {
+    std::memmove(data.data() + RecordHeaderSize, data.data(), size);
+    writeRecordHeader(data.data(), header.messageId, size);
+    size += RecordHeaderSize;
+    header.flags |= FLAG_RECORDS;
+  }
+
+  writeRecordHeader(data.data() + size, messageId, value.size());
+  std::memcpy(data.data() + size + RecordHeaderSize, value.data(),
+              value.size());
+  size += RecordHeaderSize + value.size();
+
+  header.dataSize = static_cast<uint16_t>(size);
+  checksumValid = false;
+
+  return true;
+}
+
+void TokenRingPacket::getRecords(std::vector<Record> &output) const
+    noexcept(false) {
+  output.clear();
+
+  if (!hasRecords()) {
+    output.push_back(Record{header.messageId, getRawData(), header.dataSize});
+    return;
+  }
+
+  size_t position = 0;
+  while (position < header.dataSize) {
+    if (header.dataSize - position < RecordHeaderSize) {
+      throw TokenRingPacketException("Truncated record header");
+    }
+
+    uint32_t messageId;
+    uint16_t recordSize;
+    std::memcpy(&messageId, data.data() + position, sizeof(messageId));
+    std::memcpy(&recordSize, data.data() + position + sizeof(messageId),
+                sizeof(recordSize));
+    messageId = ntohl(messageId);
+    recordSize = ntohs(recordSize);
+    position += RecordHeaderSize;
+
+    if (header.dataSize - position < recordSize) {
+      throw TokenRingPacketException("Truncated record");
+    }
+
+    output.push_back(Record{messageId, getRawData() + position, recordSize});
+    position += recordSize;
+  }
+}
+
+std::vector<unsigned char> TokenRingPacket::getUncompressedData() const
+    noexcept(false) {
+  if (!isCompressed()) {
+    return getData();
+  }
+
+  std::vector<unsigned char> result;
+  decompressData(result);
+
+  return result;
+}
+
+void TokenRingPacket::decompressData(std::vector<unsigned char> &output) const
+    noexcept(false) {
+  uint16_t uncompressedSize;
+  if (header.dataSize < sizeof(uncompressedSize)) {
+    throw TokenRingPacketException("Compressed data has no size");
+  }
+  std::memcpy(&uncompressedSize, data.data(), sizeof(uncompressedSize));
+  uncompressedSize = ntohs(uncompressedSize);
+
+  try {
+    LZCodec::decompress(getRawData() + sizeof(uncompressedSize),
+                        header.dataSize - sizeof(uncompressedSize), output,
+                        uncompressedSize);
+  } catch (const LZCodecException &ex) {
+    throw TokenRingPacketException(std::string("Corrupted compressed data: ") +
+                                   ex.what());
+  }
+
+  if (output.size() != uncompressedSize) {
+    throw TokenRingPacketException("Compressed data has invalid size");
+  }
+}
+
+std::string TokenRingPacket::packetTypeToString(PacketType type) {
+  switch (type) {
+    case PacketType::REGISTER:
+      return "REGISTER";
+    case PacketType::JOIN:
+      return "JOIN";
+    case PacketType::DATA:
+      return "DATA";
+    case PacketType::HEARTBEAT:
+      return "HEARTBEAT";
+    case PacketType::HEARTBEAT_ACK:
+      return "HEARTBEAT_ACK";
+    case PacketType::LEAVE:
+      return "LEAVE";
+    case PacketType::DIRECT:
+      return "DIRECT";
+    case PacketType::PROBE:
+      return "PROBE";
+    case PacketType::PROBE_ACK:
+      return "PROBE_ACK";
+    case PacketType::LATENCY_REPORT:
+      return "LATENCY_REPORT";
+    default:
+      return "OTHER";
+  }
+}
+
+bool TokenRingPacket::isMulticastReceiver(const std::string &receiverName) {
+  return receiverName == BroadcastReceiverName ||
+         (!receiverName.empty() && receiverName[0] == GroupReceiverPrefix);
 }
 
 std::string TokenRingPacket::to_string() const {
   std::stringstream out;
   out << "TokenRingPacket::Header:" << std::endl
-      << "Type: "
-      << (header.type == PacketType::DATA
-              ? "DATA"
-              : (header.type == PacketType::REGISTER
-                     ? "REGISTER"
-                     : (header.type == PacketType::JOIN ? "JOIN" : "OTHER")))
-      << std::endl
+      << "Type: " << packetTypeToString(header.type) << std::endl
       << "TokenStatus: Available" << std::endl
-      << "PacketSender: " << header.packetSenderName << std::endl
-      << "OriginalSender: " << header.originalSenderName << std::endl
-      << "PacketReceiver: " << header.packetReceiverName << std::endl
+      << "PacketSender: "
+      << maybeNonterminatedCharArrayToString(header.packetSenderName,
+                                             NameMaxSize)
+      << std::endl
+      << "OriginalSender: "
+      << maybeNonterminatedCharArrayToString(header.originalSenderName,
+                                             NameMaxSize)
+      << std::endl
+      << "PacketReceiver: "
+      << maybeNonterminatedCharArrayToString(header.packetReceiverName,
+                                             NameMaxSize)
+      << std::endl
       << "DataSize: " << header.dataSize << std::endl
+      << "MessageId: " << header.messageId << std::endl
+      << "SequenceNumber: " << header.sequenceNumber << std::endl
       << "RegisterIP: " << ::to_string(header.registerIp) << std::endl
       << "RegisterPort: " << header.registerPort << std::endl
-      << "NeighborToDisconnect: " << header.neighborToDisconnectName;
+      << "NeighborToDisconnect: "
+      << maybeNonterminatedCharArrayToString(header.neighborToDisconnectName,
+                                             NameMaxSize);
 
   return out.str();
 }
@@ -89,10 +358,16 @@ std::string TokenRingPacket::to_string() const {
 Serializable::container_type TokenRingPacket::toBinary() const {
   std::vector<unsigned char> buffer;
 
-  buffer.resize(sizeof(header));
-  std::memcpy(buffer.data(), &header, sizeof(header));
+  Header sentHeader = header;
+  if (!checksumValid) {
+    sentHeader.checksum = computeChecksum();
+  }
+  sentHeader = headerToNetworkOrder(sentHeader);
+
+  buffer.resize(sizeof(sentHeader));
+  std::memcpy(buffer.data(), &sentHeader, sizeof(sentHeader));
 
-  buffer.insert(buffer.end(), data.begin(), data.end());
+  buffer.insert(buffer.end(), data.begin(), data.begin() + header.dataSize);
 
   return buffer;
 }
@@ -104,5 +379,12 @@ Serializable::size_type TokenRingPacket::fromBinary(
 
   res += extractDataFromBinaryAndHeader(sourceBuffer);
 
+  if (computeChecksum() != header.checksum) {
+    checksumValid = false;
+    throw TokenRingPacketChecksumMismatchException(
+        "Packet checksum does not match");
+  }
+  checksumValid = true;
+
   return res;
 }
@@ -5,6 +5,7 @@
 
 #include <array>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "ip4.h"
@@ -16,29 +17,111 @@ using TokenRingPacketInputBufferTooSmallException = TokenRingPacketException;
 
 using TokenRingPacketTooMuchDataException = TokenRingPacketException;
 
+using TokenRingPacketChecksumMismatchException = TokenRingPacketException;
+
 class TokenRingPacket : public Serializable {
  public:
   enum class PacketType : uint8_t {
-    NONE = 0u,  /// none type representing dummy packet
-    REGISTER,   /// Client registration packet. (Register me with this name)
+    NONE = 0u,  /// none type representing dummy packet. With token it is
+                /// free token released by host that stripped its DATA
+    REGISTER,   /// Membership update. Data is MembershipUpdate batch
     JOIN,  /// Join is type that is used only when telling host that we want to
            /// join ring. Other ring hosts will be informed using REGISTER type
            /// packet
     DATA,
+    HEARTBEAT,      /// Liveness probe sent directly to the next host.
+                    /// registerIp/registerPort carry the prober's address
+    HEARTBEAT_ACK,  /// Answer to HEARTBEAT. registerIp/registerPort carry the
+                    /// responder's next host, neighborToDisconnectName its
+                    /// name, tokenStatus tells if responder holds the token
+    LEAVE,  /// Sent directly by leaving host (originalSenderName) to its
+            /// neighbors. registerIp/registerPort and neighborToDisconnectName
+            /// describe leaving host's next host. tokenStatus hands over token
+    DIRECT,  /// Part of large message sent by original sender straight to
+             /// packetReceiverName, without token. messageId names message,
+             /// sequenceNumber is offset of data in it. Message is delivered
+             /// when its DATA with FLAG_DIRECT comes around
+    PROBE,      /// Round trip time probe sent directly to any ring member.
+                /// messageId names probe, registerIp/registerPort carry the
+                /// prober's address
+    PROBE_ACK,  /// Answer to PROBE with its messageId
+    LATENCY_REPORT,  /// Round trip times measured by originalSenderName (data
+                     /// is LatencyReport), sent directly to ring coordinator.
+                     /// neighborToDisconnectName is sender's next host
 
     PACKET_TYPE_NUM  /// Number of packet types. DO NOT USE AS TYPE!!!
   };
 
   using TokenStatus_t = uint8_t;
 
+  enum Flag : uint8_t {
+    FLAG_HANDED_OVER = 1u << 0,  /// Frame queued on leaving host. Has to be
+                                 /// queued by receiver, carries no token
+    FLAG_COMPRESSED = 1u << 1,   /// Data is LZCodec block preceded by
+                                 /// uncompressed size (uint16_t, network
+                                 /// order). Only receiver decompresses it
+    FLAG_ADDRESS_RECOGNIZED = 1u << 2,  /// Set by DATA receiver, frame goes
+                                        /// on back to original sender
+    FLAG_FRAME_COPIED = 1u << 3,        /// Set by DATA receiver that
+                                        /// delivered data
+    FLAG_RECEIVER_BUSY = 1u << 4,       /// Set by DATA receiver that could
+                                        /// not take data now, sender
+                                        /// retransmits it later
+    FLAG_RECORDS = 1u << 5,  /// Data is list of messages, each preceded by
+                             /// its id and size (RecordHeaderSize bytes,
+                             /// network order). header.messageId is id of
+                             /// the first one
+    FLAG_SEQUENCED = 1u << 6,  /// Unicast DATA numbered per original sender
+                               /// and receiver, see header.sequenceNumber
+    FLAG_DIRECT = 1u << 7,  /// DATA announces message sent in DIRECT frames,
+                            /// its data is message size (uint32_t, network
+                            /// order)
+  };
+
+  using MessageId_t = uint32_t;
+
+  using SequenceNumber_t = uint32_t;
+
+  using TokenEpoch_t = uint32_t;
+
+  /**
+   * Message carried in data, points into packet
+   */
+  struct Record {
+    MessageId_t messageId;
+    const unsigned char* data;
+    size_t size;
+  };
+
+  static const size_t RecordHeaderSize =
+      sizeof(MessageId_t) + sizeof(uint16_t);
+
   static const size_t NameMaxSize = 16;
 
+  /// DATA packetReceiverName delivered to every ring member
+  static constexpr const char* BroadcastReceiverName = "*";
+
+  /// DATA packetReceiverName starting with it names group of ring members
+  static const char GroupReceiverPrefix = '@';
+
   static const size_t DataMaxSize = 512;
 
+  /// header.ring bit of DATA whose messages start with routing envelope of
+  /// HierarchicalEngine, the other bits are ring number
+  static const uint8_t RingRoutedBit = 1u << 7;
+
+  /// Largest message that may be sent compressed
+  static const size_t UncompressedDataMaxSize = 65535;
+
+  /// Largest message that may be sent in DIRECT frames
+  static const size_t DirectDataMaxSize = 65536;
+
 #pragma pack(push, 1)
+  // Kept in host order, multi-byte fields are sent in network order
   struct Header {
     PacketType type;
     TokenStatus_t tokenStatus;
+    uint8_t flags;
 
     char originalSenderName[NameMaxSize];  // padded with zeros,
                                                       // maximum chars = 15
@@ -55,6 +138,30 @@ class TokenRingPacket : public Serializable {
     unsigned short registerPort;
 
     uint16_t dataSize;
+
+    // Assigned to DATA by original sender, reported back with delivery status
+    MessageId_t messageId;
+
+    // Sequenced DATA: number of the first message, following messages in
+    // frame have following numbers. Messages before windowStart are not sent
+    // again, receiver does not wait for them.
+    SequenceNumber_t sequenceNumber;
+    SequenceNumber_t windowStart;
+
+    // Set by receiver of sequenced DATA, leading messages it took. Without
+    // FLAG_FRAME_COPIED and FLAG_RECEIVER_BUSY the next one was refused.
+    uint16_t copiedCount;
+
+    // Ring of dual ring the frame travels on, 0 is primary. See
+    // RingRoutedBit.
+    uint8_t ring;
+
+    // Frames carrying token: raised by host that regenerates token, frames
+    // of older token are dropped
+    TokenEpoch_t tokenEpoch;
+
+    // CRC32C of sent header (with zero checksum) and dataSize bytes of data
+    uint32_t checksum;
   };
 #pragma pack(pop)
 
@@ -62,6 +169,11 @@ class TokenRingPacket : public Serializable {
   Header header;
   std::array< char, DataMaxSize> data;
 
+  // header.checksum matches header and data, kept up to date by setHeader()
+  bool checksumValid{false};
+
+  uint32_t computeChecksum() const;
+
   Serializable::size_type constructHeaderFromBinaryData(
       const std::vector<unsigned char>& sourceBuffer);
 
@@ -78,14 +190,67 @@ class TokenRingPacket : public Serializable {
 
   const Header& getHeader() const;
 
+  /**
+   * Data size and checksum are kept. Checksum of received packet is updated
+   * for changed header bytes only.
+   */
   void setHeader(const Header& value);
 
   const std::vector<unsigned char> getData() const;
 
+  /**
+   * Data without copying, header.dataSize bytes. Valid while packet exists
+   * and is not changed.
+   */
+  const unsigned char* getRawData() const;
+
   const std::vector<char> getDataAsCharsVector() const;
 
   void setData(const std::vector<unsigned char>& value);
 
+  /**
+   * Stores data compressed when it makes it smaller, otherwise like
+   * setData(). Returns true if data got compressed.
+   */
+  bool setDataCompressed(const std::vector<unsigned char>& value) noexcept(
+      false);
+
+  bool isCompressed() const;
+
+  bool hasRecords() const;
+
+  /**
+   * Adds message to uncompressed data, data that was there becomes the first
+   * record. Returns false if message does not fit.
+   */
+  bool appendRecord(MessageId_t messageId,
+                    const std::vector<unsigned char>& value);
+
+  /**
+   * Replaces output with messages carried in uncompressed data, data without
+   * records is one message
+   */
+  void getRecords(std::vector<Record>& output) const noexcept(false);
+
+  /**
+   * Data as it was before compression
+   */
+  std::vector<unsigned char> getUncompressedData() const noexcept(false);
+
+  /**
+   * Decompresses compressed data into output, its capacity is reused
+   */
+  void decompressData(std::vector<unsigned char>& output) const
+      noexcept(false);
+
+  static std::string packetTypeToString(PacketType type);
+
+  /**
+   * True for broadcast and group receiver names. Such DATA is delivered by
+   * every matching host on its way and removed by its original sender.
+   */
+  static bool isMulticastReceiver(const std::string& receiverName);
+
   std::string to_string() const;
 
   Serializable::size_type fromBinary(
@@ -0,0 +1,223 @@
+#include "tokenringservice.h"
+#include "logger.h"
+#include "quitstatusobserver.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+constexpr std::chrono::milliseconds TokenRingService::MessageRingWaitTime;
+
+TokenRingService::TokenRingService(const ProgramArguments& programArguments,
+                                   std::unique_ptr<Transport> transport)
+    : transport(std::move(transport)),
+      engine(programArguments, *this->transport),
+      messageRingName(programArguments.getMessageRingName()) {
+  if (messageRingName.empty()) {
+    return;
+  }
+
+  if (programArguments.getDeliveryWorkersCount() == 0) {
+    engine.setMessageHandler(
+        [this](const TokenRingEngine::ReceivedMessage& message) {
+          return deliverToMessageRing(message)
+                     ? TokenRingEngine::MessageHandling::TAKEN
+                     : TokenRingEngine::MessageHandling::BUSY;
+        });
+    return;
+  }
+
+  DeliveryDispatcher::ConsumerOptions options;
+  options.queueCapacity = programArguments.getDeliveryQueueCapacity();
+  options.overflowPolicy = programArguments.getDeliveryOverflowPolicy();
+
+  deliveryDispatcher.reset(
+      new DeliveryDispatcher(programArguments.getDeliveryWorkersCount()));
+  deliveryDispatcher->addConsumer(
+      messageRingName,
+      [this](const DeliveryDispatcher::Message& message) {
+        return deliverQueuedToMessageRing(message);
+      },
+      options);
+
+  engine.setMessageHandler(
+      [this](const TokenRingEngine::ReceivedMessage& message) {
+        return deliveryDispatcher->dispatch(message);
+      });
+}
+
+void TokenRingService::waitForFrames(TokenRingEngine::TimePoint deadline,
+                                     bool interruptible) {
+  auto now = TokenRingEngine::Clock::now();
+  if (deadline <= now || !transport->prepareToWait()) {
+    return;
+  }
+
+  // Rounded up, so engine is not woken up just before its timeout
+  auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - now + std::chrono::microseconds{999});
+
+  struct pollfd descriptors[2];
+  nfds_t descriptorsCount = 0;
+
+  if (transport->getReadinessDescriptor() != -1) {
+    descriptors[descriptorsCount].fd = transport->getReadinessDescriptor();
+    descriptors[descriptorsCount].events = POLLIN;
+    descriptors[descriptorsCount].revents = 0;
+    ++descriptorsCount;
+  }
+
+  if (interruptible) {
+    descriptors[descriptorsCount].fd =
+        QuitStatusObserver::getInstance().getWakeupDescriptor();
+    descriptors[descriptorsCount].events = POLLIN;
+    descriptors[descriptorsCount].revents = 0;
+    ++descriptorsCount;
+  }
+
+  ::poll(descriptors, descriptorsCount,
+         static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+             timeout.count(), std::numeric_limits<int>::max())));
+
+  transport->finishWait();
+}
+
+void TokenRingService::receiveFrames() noexcept(false) {
+  do {
+    receivedFrames.clear();
+    transport->receive(receivedFrames, ReceiveBatchSize);
+
+    auto now = TokenRingEngine::Clock::now();
+    for (const Transport::Frame& frame : receivedFrames) {
+      engine.handleFrame(
+          frame.data, now,
+          TokenRingEngine::TimePoint(
+              std::chrono::duration_cast<TokenRingEngine::Clock::duration>(
+                  frame.receiveTimestamp)));
+    }
+  } while (receivedFrames.size() == ReceiveBatchSize);
+}
+
+bool TokenRingService::deliverToMessageRing(
+    const TokenRingEngine::ReceivedMessage& message) {
+  if (messageRing && messageRing->push(message)) {
+    return true;
+  }
+
+  // Full ring of live application is not replaced, only one of gone one
+  if (messageRing && !messageRing->isClosed()) {
+    return false;
+  }
+  messageRing.reset();
+
+  auto now = TokenRingEngine::Clock::now();
+  if (now < nextMessageRingAttach) {
+    return false;
+  }
+  nextMessageRingAttach = now + std::chrono::seconds{1};
+
+  messageRing = MessageRing::attach(messageRingName);
+  if (!messageRing) {
+    return false;
+  }
+
+  Logger::getInstance().log("[" + engine.getHostId() +
+                            "] Delivering messages to `" + messageRingName +
+                            "`.");
+
+  return messageRing->push(message);
+}
+
+bool TokenRingService::deliverQueuedToMessageRing(
+    const DeliveryDispatcher::Message& message) {
+  TokenRingEngine::ReceivedMessage receivedMessage;
+  receivedMessage.senderName = message.senderName;
+  receivedMessage.receiverName = message.receiverName;
+  receivedMessage.messageId = message.messageId;
+  receivedMessage.ring = message.ring;
+  receivedMessage.routed = false;
+  receivedMessage.data = message.data.data();
+  receivedMessage.size = message.data.size();
+
+  auto deadline = TokenRingEngine::Clock::now() + MessageRingWaitTime;
+
+  while (!deliverToMessageRing(receivedMessage)) {
+    // Only full ring of attached application is worth waiting for
+    auto now = TokenRingEngine::Clock::now();
+    if (!messageRing || now >= deadline) {
+      // Stays queued, dispatcher offers it again
+      return false;
+    }
+
+    // Application wakes us up when it takes messages out
+    if (messageRing->prepareToWaitForSpace(receivedMessage)) {
+      struct pollfd descriptor;
+      descriptor.fd = messageRing->getSpaceWakeupDescriptor();
+      descriptor.events = POLLIN;
+      descriptor.revents = 0;
+
+      auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - now + std::chrono::microseconds{999});
+      ::poll(&descriptor, 1, static_cast<int>(timeout.count()));
+
+      messageRing->finishWaitForSpace();
+    }
+  }
+
+  return true;
+}
+
+void TokenRingService::logDeliveryStatistics() {
+  for (const std::string& name : deliveryDispatcher->getConsumerNames()) {
+    DeliveryDispatcher::Statistics statistics =
+        deliveryDispatcher->getStatistics(name);
+
+    Logger::getInstance().log(
+        "[" + engine.getHostId() + "] Delivery to `" + name +
+        "`: handled " + std::to_string(statistics.handled) + ", failed " +
+        std::to_string(statistics.failed) + ", retried " +
+        std::to_string(statistics.retried) + ", dropped " +
+        std::to_string(statistics.dropped) + ", rejected " +
+        std::to_string(statistics.rejected) + ", max queued " +
+        std::to_string(statistics.maxQueued));
+  }
+}
+
+void TokenRingService::run() {
+  transport->open();
+
+  engine.start(TokenRingEngine::Clock::now());
+
+  while (!QuitStatusObserver::getInstance().shouldQuit()) {
+    waitForFrames(engine.getNextTimeout(), true);
+
+    try {
+      receiveFrames();
+    } catch (const TransportReceivingFailedException& ex) {
+      Logger::getInstance().log("[" + engine.getHostId() +
+                                "] Packet receiving failed: " + ex.what());
+    }
+
+    engine.handleTimeout(TokenRingEngine::Clock::now());
+  }
+
+  engine.leave(TokenRingEngine::Clock::now());
+
+  while (!engine.hasLeft(TokenRingEngine::Clock::now())) {
+    waitForFrames(engine.getNextTimeout(), false);
+
+    try {
+      receiveFrames();
+    } catch (const TransportReceivingFailedException& ex) {
+      Logger::getInstance().log("[" + engine.getHostId() +
+                                "] Packet receiving failed: " + ex.what());
+    }
+  }
+
+  if (deliveryDispatcher) {
+    deliveryDispatcher->stop();
+    logDeliveryStatistics();
+  }
+}
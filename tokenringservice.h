@@ -0,0 +1,73 @@
+#ifndef TOKENRINGSERVICE_H
+#define TOKENRINGSERVICE_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "deliverydispatcher.h"
+#include "hierarchicalengine.h"
+#include "messagering.h"
+#include "programarguments.h"
+#include "tokenringengine.h"
+#include "transport.h"
+
+/**
+ * Runs token ring engine (its rings with --dual-ring or --hierarchy) of one
+ * lane on real clock. Sleeps on transport readiness descriptor until frame
+ * arrives, engine timeout expires or quit is requested.
+ */
+class TokenRingService {
+ public:
+  // Frames taken from transport at once
+  static const size_t ReceiveBatchSize = 64;
+
+  // Delivery worker waits so long for application whose ring is full
+  static constexpr std::chrono::milliseconds MessageRingWaitTime{100};
+
+  // Private variables
+ private:
+  std::unique_ptr<Transport> transport;
+  HierarchicalEngine engine;
+
+  std::vector<Transport::Frame> receivedFrames;
+
+  // Application taking delivered messages, attached when it shows up
+  std::string messageRingName;
+  std::unique_ptr<MessageRing> messageRing;
+  TokenRingEngine::TimePoint nextMessageRingAttach;
+
+  // Hands messages to application off ring thread, stopped first
+  std::unique_ptr<DeliveryDispatcher> deliveryDispatcher;
+
+  // Private methods
+ private:
+  /**
+   * Waits for frames until deadline. Interruptible wait returns early when
+   * quit is requested.
+   */
+  void waitForFrames(TokenRingEngine::TimePoint deadline, bool interruptible);
+
+  void receiveFrames() noexcept(false);
+
+  /**
+   * Returns false when application is not there or does not keep up
+   */
+  bool deliverToMessageRing(const TokenRingEngine::ReceivedMessage& message);
+
+  /**
+   * Runs on delivery worker. Waits a while for application whose ring is
+   * full.
+   */
+  bool deliverQueuedToMessageRing(const DeliveryDispatcher::Message& message);
+
+  void logDeliveryStatistics();
+
+ public:
+  TokenRingService(const ProgramArguments& programArguments,
+                   std::unique_ptr<Transport> transport);
+
+  void run() noexcept(false);
+};
+
+#endif  // TOKENRINGSERVICE_H
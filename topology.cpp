@@ -0,0 +1,157 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "tokenringpacket.h"
+
+Topology Topology::fromFile(const std::string &path) noexcept(false) {
+  std::ifstream input(path);
+
+  if (!input) {
+    throw TopologyFileOpenFailedException("Failed to open topology file `" +
+                                          path + "\'");
+  }
+
+  return fromStream(input);
+}
+
+Topology Topology::fromStream(std::istream &input) noexcept(false) {
+  Topology topology;
+  std::string line;
+  size_t lineNumber = 0;
+
+  while (std::getline(input, line)) {
+    ++lineNumber;
+
+    line = line.substr(0, line.find('#'));
+
+    std::istringstream lineStream(line);
+    std::string name;
+    std::string ip;
+    std::string port;
+    std::string excess;
+
+    if (!(lineStream >> name)) {
+      continue;
+    }
+
+    if (!(lineStream >> ip >> port) || (lineStream >> excess)) {
+      throw TopologyInvalidEntryException(
+          "Topology line " + std::to_string(lineNumber) +
+          ": expected `<host id> <ip> <port>\'");
+    }
+
+    Host host;
+    host.name = name;
+
+    try {
+      host.ip = Ip4_from_string(ip);
+    } catch (const Ip4InvalidInputException &ex) {
+      throw TopologyInvalidEntryException("Topology line " +
+                                          std::to_string(lineNumber) + ": " +
+                                          ex.what());
+    }
+
+    int portNumber = 0;
+    try {
+      portNumber = std::stoi(port);
+    } catch (const std::logic_error &) {
+      portNumber = -1;
+    }
+
+    if (portNumber < 0 ||
+        portNumber > std::numeric_limits<unsigned short>::max()) {
+      throw TopologyInvalidEntryException(
+          "Topology line " + std::to_string(lineNumber) +
+          ": invalid port number `" + port + "\'");
+    }
+    host.port = static_cast<unsigned short>(portNumber);
+
+    topology.addHost(host);
+  }
+
+  return topology;
+}
+
+void Topology::addHost(const Host &host) noexcept(false) {
+  if (host.name.empty() || host.name.size() >= TokenRingPacket::NameMaxSize) {
+    throw TopologyInvalidEntryException("Invalid host id `" + host.name +
+                                        "\'");
+  }
+
+  if (contains(host.name)) {
+    throw TopologyInvalidEntryException("Duplicated host id `" + host.name +
+                                        "\'");
+  }
+
+  hosts.push_back(host);
+}
+
+const std::vector<Topology::Host> &Topology::getHosts() const { return hosts; }
+
+bool Topology::empty() const { return hosts.empty(); }
+
+bool Topology::contains(const std::string &name) const {
+  return std::find_if(hosts.begin(), hosts.end(), [&name](const Host &host) {
+           return host.name == name;
+         }) != hosts.end();
+}
+
+size_t Topology::indexOf(const std::string &name) const noexcept(false) {
+  auto it = std::find_if(hosts.begin(), hosts.end(),
+                         [&name](const Host &host) { return host.name == name; });
+
+  if (it == hosts.end()) {
+    throw TopologyUnknownHostException("Host `" + name +
+                                       "\' is not part of topology");
+  }
+
+  return static_cast<size_t>(std::distance(hosts.begin(), it));
+}
+
+const Topology::Host &Topology::getHost(const std::string &name) const
+    noexcept(false) {
+  return hosts[indexOf(name)];
+}
+
+const Topology::Host &Topology::nextHostOf(const std::string &name) const
+    noexcept(false) {
+  return hosts[(indexOf(name) + 1) % hosts.size()];
+}
+
+const Topology::Host &Topology::previousHostOf(const std::string &name) const
+    noexcept(false) {
+  return hosts[(indexOf(name) + hosts.size() - 1) % hosts.size()];
+}
+
+Topology Topology::reversed() const {
+  Topology topology;
+  if (hosts.empty()) {
+    return topology;
+  }
+
+  topology.hosts.push_back(hosts.front());
+  topology.hosts.insert(topology.hosts.end(), hosts.rbegin(),
+                        hosts.rend() - 1);
+
+  return topology;
+}
+
+Topology Topology::withPortOffset(unsigned short offset) const
+    noexcept(false) {
+  Topology topology;
+
+  for (Host host : hosts) {
+    if (host.port > 65535u - offset) {
+      throw TopologyInvalidEntryException("Port of host `" + host.name +
+                                          "' moved out of range");
+    }
+    host.port = static_cast<unsigned short>(host.port + offset);
+    topology.hosts.push_back(host);
+  }
+
+  return topology;
+}
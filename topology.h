@@ -0,0 +1,71 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ip4.h"
+
+using TopologyException = std::runtime_error;
+
+using TopologyFileOpenFailedException = TopologyException;
+
+using TopologyInvalidEntryException = TopologyException;
+
+using TopologyUnknownHostException = TopologyException;
+
+/**
+ * Static ring description. Ring order is the order of entries, first host
+ * holds the token at startup.
+ *
+ * File format, one host per line (blank lines and `#` comments ignored):
+ *   <host id> <ip> <port>
+ */
+class Topology {
+ public:
+  struct Host {
+    std::string name;
+    Ip4 ip;
+    unsigned short port;
+  };
+
+ private:
+  std::vector<Host> hosts;
+
+  size_t indexOf(const std::string& name) const noexcept(false);
+
+ public:
+  Topology() = default;
+
+  static Topology fromFile(const std::string& path) noexcept(false);
+
+  static Topology fromStream(std::istream& input) noexcept(false);
+
+  void addHost(const Host& host) noexcept(false);
+
+  const std::vector<Host>& getHosts() const;
+
+  bool empty() const;
+
+  bool contains(const std::string& name) const;
+
+  const Host& getHost(const std::string& name) const noexcept(false);
+
+  const Host& nextHostOf(const std::string& name) const noexcept(false);
+
+  const Host& previousHostOf(const std::string& name) const noexcept(false);
+
+  /**
+   * The same ring going the other way, first host stays first
+   */
+  Topology reversed() const;
+
+  /**
+   * The same ring on ports moved by offset, used by parallel lanes
+   */
+  Topology withPortOffset(unsigned short offset) const noexcept(false);
+};
+
+#endif  // TOPOLOGY_H
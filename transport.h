@@ -0,0 +1,107 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdexcept>
+#include <vector>
+
+#include "ip4.h"
+#include "programarguments.h"
+#include "socket.h"
+
+using TransportException = std::runtime_error;
+
+using TransportOpenFailedException = TransportException;
+
+using TransportSendingFailedException = TransportException;
+
+using TransportReceivingFailedException = TransportException;
+
+/**
+ * Moves token ring frames between hosts. Token ring protocol does not know
+ * what is below it, it only hands batches of frames to transport and takes
+ * batches of received frames from it.
+ */
+class Transport {
+ public:
+  /**
+   * Address is destination of sent frame and source of received one.
+   * receiveTimestamp of received frame is kernel receive time on
+   * std::chrono::steady_clock, zero when transport does not know it.
+   */
+  using Frame = Socket::Datagram;
+
+  virtual ~Transport() = default;
+
+  /**
+   * Starts listening on local address, has to be called before anything else
+   */
+  virtual void open() noexcept(false) = 0;
+
+  virtual Ip4 getLocalIp() const = 0;
+
+  virtual unsigned short getLocalPort() const = 0;
+
+  /**
+   * Tells transport where most of frames go, so it can prepare faster path to
+   * that host
+   */
+  virtual void setNextHost(const Ip4& ip, unsigned short port) {
+    (void)ip;
+    (void)port;
+  }
+
+  /**
+   * Sends frames in order. Consecutive frames for the same host may be
+   * coalesced. Frames before the failed one are sent.
+   */
+  virtual void send(const std::vector<Frame>& frames) noexcept(false) = 0;
+
+  /**
+   * Appends up to maxFrames already received frames to output without
+   * blocking. Returns number of appended frames.
+   */
+  virtual size_t receive(std::vector<Frame>& output,
+                         size_t maxFrames) noexcept(false) = 0;
+
+  /**
+   * Descriptor that becomes readable when receive() may return frames, or -1
+   * when transport is not backed by descriptors (it is driven by its owner).
+   */
+  virtual int getReadinessDescriptor() const = 0;
+
+  /**
+   * Called before sleeping on readiness descriptor. Returns false if frames
+   * are already waiting and sleep has to be skipped.
+   */
+  virtual bool prepareToWait() { return true; }
+
+  /**
+   * Called after sleeping on readiness descriptor
+   */
+  virtual void finishWait() {}
+
+ protected:
+  /**
+   * Address put into frames as ours: --advertise, bind address, or source
+   * address of route to neighbor when bound to all interfaces
+   */
+  static Ip4 resolveAdvertisedIp(const ProgramArguments& programArguments,
+                                 const Ip4& boundIp) noexcept(false) {
+    if (programArguments.hasAdvertisedIp()) {
+      return programArguments.getAdvertisedIp();
+    }
+
+    if (boundIp.s_addr != htonl(INADDR_ANY)) {
+      return boundIp;
+    }
+
+    try {
+      return Socket::routeSourceFor(programArguments.getNeighborIp());
+    } catch (const SocketException& ex) {
+      throw TransportOpenFailedException(
+          std::string("Failed to find address to advertise: ") + ex.what());
+    }
+  }
+};
+
+#endif  // TRANSPORT_H
@@ -0,0 +1,254 @@
+#include "udptransport.h"
+#include "logger.h"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+// Spinning before sleep saves wakeup latency when frames arrive in bursts
+const std::chrono::microseconds inboxSpinTime{20};
+// Failed attach or closed ring is checked again after this time
+const std::chrono::milliseconds outboxCheckInterval{100};
+
+// Kernel stamps datagrams with CLOCK_REALTIME, engine runs on steady_clock
+void moveReceiveTimestampsToSteadyClock(std::vector<Transport::Frame>& frames,
+                                        size_t first) {
+  if (first == frames.size()) {
+    return;
+  }
+
+  auto realNow = std::chrono::system_clock::now().time_since_epoch();
+  auto steadyNow = std::chrono::steady_clock::now().time_since_epoch();
+  for (size_t i = first; i < frames.size(); ++i) {
+    std::chrono::nanoseconds& timestamp = frames[i].receiveTimestamp;
+    if (timestamp.count() != 0) {
+      timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          steadyNow - (realNow - timestamp));
+    }
+  }
+}
+}  // namespace
+
+UDPTransport::UDPTransport(const ProgramArguments& programArguments)
+    : programArguments(programArguments),
+      inputSocketPort(programArguments.getPort()),
+      inputSocket(Protocol::UDP),
+      sharedMemoryEnabled(programArguments.useSharedMemory()) {}
+
+UDPTransport::~UDPTransport() {
+  if (epollDescriptor != -1) {
+    ::close(epollDescriptor);
+  }
+}
+
+void UDPTransport::open() {
+  if (programArguments.useReusePort()) {
+    inputSocket.setReusePort(true);
+  }
+  try {
+    inputSocket.setOptions(
+        programArguments.getSocketOptions().receivingOptions());
+  } catch (const SocketOptionFailedException& ex) {
+    Logger::getInstance().log(std::string("Socket options ignored: ") +
+                              ex.what());
+  }
+  inputSocket.bind(programArguments.getBindIp(), inputSocketPort);
+  inputSocket.listen(2);
+
+  advertisedIp = resolveAdvertisedIp(programArguments, inputSocket.getIp());
+
+  if (sharedMemoryEnabled) {
+    try {
+      openInbox();
+    } catch (const SharedMemoryRingException& ex) {
+      Logger::getInstance().log(std::string("Shared memory disabled: ") +
+                                ex.what());
+      inbox.reset();
+    }
+  }
+}
+
+void UDPTransport::openInbox() {
+  inbox = SharedMemoryRing::create(getLocalIp(), getLocalPort());
+
+  epollDescriptor = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epollDescriptor == -1) {
+    throw SharedMemoryRingException("Failed to create epoll instance");
+  }
+
+  for (int descriptor :
+       {inputSocket.getDescriptor(), inbox->getWakeupDescriptor()}) {
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = descriptor;
+
+    if (::epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, descriptor, &event) ==
+        -1) {
+      throw SharedMemoryRingException("Failed to watch descriptor");
+    }
+  }
+}
+
+Ip4 UDPTransport::getLocalIp() const { return advertisedIp; }
+
+unsigned short UDPTransport::getLocalPort() const {
+  return inputSocket.getPort();
+}
+
+void UDPTransport::setNextHost(const Ip4& ip, unsigned short port) {
+  nextHostIp = ip;
+  nextHostPort = port;
+}
+
+SharedMemoryRing* UDPTransport::getOutbox(const Ip4& ip,
+                                          unsigned short port) {
+  // Only successor gets frames often enough to be worth a ring
+  if (ip.s_addr != nextHostIp.s_addr || port != nextHostPort ||
+      !SharedMemoryRing::isLocalAddress(ip)) {
+    return nullptr;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  bool targetChanged = ip.s_addr != outboxIp.s_addr || port != outboxPort;
+
+  if (!targetChanged && now < outboxCheckTime) {
+    return outbox.get();
+  }
+
+  if (targetChanged || !outbox || outbox->isClosed()) {
+    outbox.reset();
+    outbox = SharedMemoryRing::attach(ip, port);
+    outboxIp = ip;
+    outboxPort = port;
+  }
+  outboxCheckTime = now + outboxCheckInterval;
+
+  return outbox.get();
+}
+
+Socket& UDPTransport::getOutputSocket(const Ip4& destination) noexcept(
+    false) {
+  auto route = routes.find(destination.s_addr);
+  if (route != routes.end()) {
+    return *route->second;
+  }
+
+  Ip4 source{};
+  try {
+    source = Socket::routeSourceFor(destination);
+  } catch (const SocketException&) {
+    // No route now, unbound socket lets kernel decide on every send
+  }
+
+  Socket& outputSocket = outputSockets[source.s_addr];
+  if (outputSocket.empty()) {
+    outputSocket = Socket(Protocol::UDP);
+    try {
+      outputSocket.setOptions(
+          programArguments.getSocketOptions().sendingOptions());
+    } catch (const SocketOptionFailedException& ex) {
+      Logger::getInstance().log(std::string("Socket options ignored: ") +
+                                ex.what());
+    }
+    if (source.s_addr != htonl(INADDR_ANY)) {
+      try {
+        outputSocket.bind(source, 0);
+      } catch (const SocketBindFailedException& ex) {
+        outputSockets.erase(source.s_addr);
+        throw TransportSendingFailedException(ex.what());
+      }
+    }
+  }
+
+  routes[destination.s_addr] = &outputSocket;
+
+  return outputSocket;
+}
+
+void UDPTransport::sendDatagrams(Socket& socket) noexcept(false) {
+  try {
+    socket.sendToMany(datagrams);
+  } catch (const SocketSendingFailedException&) {
+    // Route may have changed (interface down, address moved)
+    routes.clear();
+    datagrams.clear();
+    throw;
+  }
+
+  datagrams.clear();
+}
+
+void UDPTransport::send(const std::vector<Frame>& frames) noexcept(false) {
+  datagrams.clear();
+  Socket* datagramsSocket = nullptr;
+
+  for (const Frame& frame : frames) {
+    if (sharedMemoryEnabled) {
+      SharedMemoryRing* ring =
+          getOutbox(frame.address.first, frame.address.second);
+
+      if (ring && ring->push(frame.data)) {
+        continue;
+      }
+    }
+
+    // Consecutive datagrams through the same interface go in one batch
+    Socket* socket = &getOutputSocket(frame.address.first);
+    if (socket != datagramsSocket && !datagrams.empty()) {
+      sendDatagrams(*datagramsSocket);
+    }
+    datagramsSocket = socket;
+
+    datagrams.push_back(frame);
+  }
+
+  if (!datagrams.empty()) {
+    sendDatagrams(*datagramsSocket);
+  }
+}
+
+size_t UDPTransport::receive(std::vector<Frame>& output,
+                             size_t maxFrames) noexcept(false) {
+  size_t receivedCount = 0;
+
+  if (inbox) {
+    Frame frame;
+    while (receivedCount < maxFrames && inbox->pop(frame.data)) {
+      output.push_back(std::move(frame));
+      ++receivedCount;
+    }
+  }
+
+  size_t first = output.size();
+  receivedCount += inputSocket.receiveFromMany(
+      output, maxFrames - receivedCount, MaxFrameSize);
+  moveReceiveTimestampsToSteadyClock(output, first);
+
+  return receivedCount;
+}
+
+int UDPTransport::getReadinessDescriptor() const {
+  return inbox ? epollDescriptor : inputSocket.getDescriptor();
+}
+
+bool UDPTransport::prepareToWait() {
+  if (!inbox) {
+    return true;
+  }
+
+  if (!inbox->empty() || inbox->spinUntilNotEmpty(inboxSpinTime)) {
+    return false;
+  }
+
+  return inbox->prepareToSleep();
+}
+
+void UDPTransport::finishWait() {
+  if (inbox) {
+    inbox->finishSleep();
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef UDPTRANSPORT_H
+#define UDPTRANSPORT_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+
+#include "programarguments.h"
+#include "sharedmemoryring.h"
+#include "socket.h"
+#include "tokenringpacket.h"
+#include "transport.h"
+
+/**
+ * Frames are sent as single datagrams. Frames for next host running on the
+ * same machine go through shared memory ring instead.
+ *
+ * Datagrams leave through socket bound to source address of route to their
+ * destination, so each interface has its own send socket.
+ */
+class UDPTransport : public Transport {
+ public:
+  static const size_t MaxFrameSize =
+      sizeof(TokenRingPacket::Header) + TokenRingPacket::DataMaxSize;
+
+  // Private variables
+ private:
+  const ProgramArguments& programArguments;
+
+  unsigned short inputSocketPort;
+  Ip4 advertisedIp{};
+
+  Socket inputSocket;
+
+  // Send sockets by source address, and source address by destination
+  std::map<in_addr_t, Socket> outputSockets;
+  std::map<in_addr_t, Socket*> routes;
+
+  // Shared memory path, used when next host runs on the same machine
+  bool sharedMemoryEnabled;
+
+  std::unique_ptr<SharedMemoryRing> inbox;
+  // Waits for input socket and inbox at once
+  int epollDescriptor{-1};
+
+  Ip4 nextHostIp{};
+  unsigned short nextHostPort{0};
+
+  std::unique_ptr<SharedMemoryRing> outbox;
+  Ip4 outboxIp{};
+  unsigned short outboxPort{0};
+  std::chrono::steady_clock::time_point outboxCheckTime;
+
+  std::vector<Frame> datagrams;
+
+  // Private methods
+ private:
+  Socket& getOutputSocket(const Ip4& destination) noexcept(false);
+
+  void sendDatagrams(Socket& socket) noexcept(false);
+
+  SharedMemoryRing* getOutbox(const Ip4& ip, unsigned short port);
+
+  void openInbox();
+
+ public:
+  explicit UDPTransport(const ProgramArguments& programArguments);
+
+  ~UDPTransport() override;
+
+  void open() noexcept(false) override;
+
+  Ip4 getLocalIp() const override;
+
+  unsigned short getLocalPort() const override;
+
+  void setNextHost(const Ip4& ip, unsigned short port) override;
+
+  void send(const std::vector<Frame>& frames) noexcept(false) override;
+
+  size_t receive(std::vector<Frame>& output,
+                 size_t maxFrames) noexcept(false) override;
+
+  int getReadinessDescriptor() const override;
+
+  bool prepareToWait() override;
+
+  void finishWait() override;
+};
+
+#endif  // UDPTRANSPORT_H
@@ -13,15 +13,20 @@ void insertStringToCharArrayWithLength(const std::string& str, char* array,
 std::string maybeNonterminatedCharArrayToString(const char* array,
                                                 size_t maxLen);
 
-template <typename T>
-T random(T min, T max) {
-  static std::mt19937 gen{std::random_device{}()};
+template <typename T, typename Generator>
+T random(T min, T max, Generator& gen) {
   using dist = std::conditional_t<std::is_integral<T>::value,
                                   std::uniform_int_distribution<T>,
                                   std::uniform_real_distribution<T> >;
   return dist{min, max}(gen);
 }
 
+template <typename T>
+T random(T min, T max) {
+  static std::mt19937 gen{std::random_device{}()};
+  return random(min, max, gen);
+}
+
 template <typename T>
 std::pair<T, bool> getNthElement(std::set<T>& searchSet, int n) {
   std::pair<T, bool> result;